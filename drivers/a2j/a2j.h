@@ -30,6 +30,13 @@
 #define MAX_PORTS  2048
 #define MAX_EVENT_SIZE 1024
 
+/* events passed from an input port's ring to its JACK buffer at once */
+#define A2J_BATCH_EVENTS 64
+
+/* index of a stream in struct a2j */
+#define A2J_PORT_CAPTURE 0   /* ALSA to JACK */
+#define A2J_PORT_PLAYBACK 1  /* JACK to ALSA */
+
 #define PORT_HASH_BITS 4
 #define PORT_HASH_SIZE (1 << PORT_HASH_BITS)
 
@@ -40,15 +47,19 @@ struct a2j;
 struct a2j_port
 {
     struct a2j_port * next;       /* hash - jack */
+    struct a2j_port * active_next; /* list - jack, ports visited each cycle */
     struct list_head siblings;    /* list - main loop */
     struct a2j * a2j_ptr;
     bool is_dead;
+    bool in_hash;                 /* jack */
+    bool active;                  /* jack */
+    int queued;                   /* on the ready list, or on the active list and not idle */
     char name[64];
     snd_seq_addr_t remote;
     jack_port_t * jack_port;
     
-    jack_ringbuffer_t * inbound_events; // alsa_midi_event_t + data
-    int64_t last_out_time;
+    jack_ringbuffer_t * inbound_events; // alsa_midi_event_t + data, capture only
+    int64_t last_out_time;        /* playback only */
     
     void * jack_buf;
 };
@@ -60,6 +71,7 @@ struct a2j_stream
     jack_ringbuffer_t *new_ports;
     
     a2j_port_hash_t port_hash;
+    struct a2j_port * active;
     struct list_head list;
 };
 
@@ -72,18 +84,21 @@ struct a2j
     int client_id;
     int port_id;
     int queue;
+    jack_time_t queue_start;      /* JACK time at which the queue's real time was 0 */
     int input;
+    int output;
     int finishing;
     int ignore_hardware_ports;
 
     jack_ringbuffer_t* port_add; // snd_seq_addr_t
     jack_ringbuffer_t* port_del; // struct a2j_port*
+    jack_ringbuffer_t* ready_ports; // struct a2j_port*, with events queued or dead
     jack_ringbuffer_t* outbound_events; // struct a2j_delivery_event
     jack_nframes_t cycle_start;
     
     sem_t io_semaphore;
 
-    struct a2j_stream stream;
+    struct a2j_stream stream[2]; /* A2J_PORT_CAPTURE, A2J_PORT_PLAYBACK */
 };
 
 #define NSEC_PER_SEC ((int64_t)1000*1000*1000)
@@ -79,9 +79,9 @@ a2j_warning (const char* fmt, ...)
 }
 
 static bool
-a2j_stream_init(struct a2j * self)
+a2j_stream_init(struct a2j * self, int dir)
 {
-	struct a2j_stream *str = &self->stream;
+	struct a2j_stream *str = &self->stream[dir];
 
 	str->new_ports = jack_ringbuffer_create (MAX_PORTS * sizeof(struct a2j_port *));
 	if (str->new_ports == NULL) {
@@ -116,9 +116,9 @@ a2j_stream_detach (struct a2j_stream * stream_ptr)
 
 static
 void
-a2j_stream_close (struct a2j * self)
+a2j_stream_close (struct a2j * self, int dir)
 {
-	struct a2j_stream *str = &self->stream;
+	struct a2j_stream *str = &self->stream[dir];
 
 	if (str->codec)
 		snd_midi_event_free (str->codec);
@@ -132,12 +132,22 @@ a2j_stream_close (struct a2j * self)
  * =================== Input/output port handling =========================
  */
 
+/* A new capture port goes on the active list straight away: its JACK
+   buffer may be a recycled one, which must be cleared once before the
+   port can be left alone while idle.
+*/
 void a2j_add_ports (struct a2j_stream * str)
 {
 	struct a2j_port * port_ptr;
 	while (jack_ringbuffer_read (str->new_ports, (char *)&port_ptr, sizeof(port_ptr))) {
 		a2j_debug("jack: inserted port %s", port_ptr->name);
 		a2j_port_insert (str->port_hash, port_ptr);
+		port_ptr->in_hash = true;
+		if (port_ptr->inbound_events && !port_ptr->active) {
+			port_ptr->active = true;
+			port_ptr->active_next = str->active;
+			str->active = port_ptr;
+		}
 	}
 }
 
@@ -159,7 +169,7 @@ a2j_port_event (struct a2j * self, snd_seq_event_t * ev)
 		}
 	} else if (ev->type == SND_SEQ_EVENT_PORT_EXIT) {
 		a2j_debug("port_event: del %d:%d", addr.client, addr.port);
-		a2j_port_setdead(self->stream.port_hash, addr);
+		a2j_port_setdead(self, addr);
 	}
 }
 
@@ -167,7 +177,7 @@ static void
 a2j_input_event (struct a2j * self, snd_seq_event_t * alsa_event)
 {
 	jack_midi_data_t data[MAX_EVENT_SIZE];
-	struct a2j_stream *str = &self->stream;
+	struct a2j_stream *str = &self->stream[A2J_PORT_CAPTURE];
 	long size;
 	struct a2j_port *port;
 	jack_nframes_t now;
@@ -232,6 +242,7 @@ a2j_input_event (struct a2j * self, snd_seq_event_t * alsa_event)
 			memcpy( vec[1].buf, ev_charp, to_write );
 
 		jack_ringbuffer_write_advance( port->inbound_events, sizeof(ev) + size );
+		a2j_port_queue (self, port);
 	} else {
 		a2j_error ("MIDI data lost (incoming event buffer full): %ld bytes lost", size);
 	}
@@ -299,116 +310,285 @@ void* alsa_input_thread(void * arg)
 
 /* JACK */
 
-static int
-a2j_process (jack_nframes_t nframes, void * arg)
+/* Copy len bytes from offset into the data readable in vec. */
+static void
+a2j_read_vector_copy (jack_ringbuffer_data_t * vec, size_t offset, void * dst, size_t len)
 {
-	struct a2j* self = (struct a2j *) arg;
-	struct a2j_stream * stream_ptr;
-	int i;
-	struct a2j_port ** port_ptr;
-	struct a2j_port * port;
+	size_t first = 0;
 
-	if (g_freewheeling) {
-		return 0;
+	if (offset < vec[0].len) {
+		first = vec[0].len - offset < len ? vec[0].len - offset : len;
+		memcpy (dst, vec[0].buf + offset, first);
+	}
+	if (len > first) {
+		memcpy ((char*)dst + first, vec[1].buf + (offset + first - vec[0].len), len - first);
 	}
+}
+
+/* Write the events queued by the ALSA input thread before this cycle into
+   the JACK port buffer. They are delivered during the JACK period that this
+   is called from. The events are passed to the buffer a batch at a time,
+   straight from the ring: only one that wraps around its end is copied.
+   Returns true if the port needs a visit next cycle too, to take the events
+   left or to clear the ones written now.
+*/
+static bool
+a2j_process_port (struct a2j * self, struct a2j_port * port, jack_nframes_t nframes, jack_nframes_t one_period)
+{
+	jack_ringbuffer_data_t vec[2];
+	struct a2j_alsa_midi_event ev;
+	jack_midi_event_t batch[A2J_BATCH_EVENTS];
+	jack_midi_data_t wrapped[MAX_EVENT_SIZE];
+	size_t avail;
+	size_t used = 0;
+	size_t data;
+	uint32_t nbatch = 0;
+	uint32_t written;
+	jack_nframes_t offset;
+
+	port->jack_buf = jack_port_get_buffer(port->jack_port, nframes);
+	jack_midi_clear_buffer (port->jack_buf);
+
+	jack_ringbuffer_get_read_vector (port->inbound_events, vec);
+	avail = vec[0].len + vec[1].len;
+
+	while (avail - used >= sizeof(ev)) {
+
+		a2j_read_vector_copy (vec, used, &ev, sizeof(ev));
+
+		if (ev.time >= self->cycle_start || avail - used < sizeof(ev) + ev.size) {
+			break;
+		}
+
+		offset = self->cycle_start - ev.time;
+		if (offset > one_period) {
+			/* from a previous cycle, somehow. cram it in at the front */
+			offset = 0;
+		} else {
+			/* offset from start of the current cycle */
+			offset = one_period - offset;
+		}
+
+		a2j_debug ("event at %d offset %d", ev.time, offset);
+
+		data = used + sizeof(ev);
+		batch[nbatch].time = offset;
+		batch[nbatch].size = ev.size;
+		if (data + ev.size <= vec[0].len) {
+			batch[nbatch].buffer = (jack_midi_data_t*) vec[0].buf + data;
+		} else if (data >= vec[0].len) {
+			batch[nbatch].buffer = (jack_midi_data_t*) vec[1].buf + (data - vec[0].len);
+		} else {
+			a2j_read_vector_copy (vec, data, wrapped, ev.size);
+			batch[nbatch].buffer = wrapped;
+		}
+		used = data + ev.size;
+
+		if (++nbatch == A2J_BATCH_EVENTS) {
+			written = jack_midi_event_write_batch (port->jack_buf, batch, nbatch);
+			if (written < nbatch) {
+				a2j_error ("threw away %u MIDI events - not enough space", nbatch - written);
+			}
+			nbatch = 0;
+		}
+	}
+
+	if (nbatch) {
+		written = jack_midi_event_write_batch (port->jack_buf, batch, nbatch);
+		if (written < nbatch) {
+			a2j_error ("threw away %u MIDI events - not enough space", nbatch - written);
+		}
+	}
+
+	jack_ringbuffer_read_advance (port->inbound_events, used);
+
+	return used < avail || jack_midi_get_event_count (port->jack_buf) > 0;
+}
+
+/* The real time on the ALSA queue, in nanoseconds, that the JACK frame
+   time frame maps to.
+*/
+static int64_t
+a2j_queue_time (struct a2j * self, jack_nframes_t frame)
+{
+	return ((int64_t) jack_frames_to_time (self->jack_client, frame) - (int64_t) self->queue_start) * 1000;
+}
+
+/* Schedule the events written to the playback ports this cycle on the
+   ALSA queue, a period after the frames they were written for, as the
+   audio written this cycle is heard. They go into the output buffer of
+   the sequencer handle and are sent to the kernel with one drain at the
+   end, unless the buffer fills up first.
+*/
+static void
+a2j_process_outgoing (struct a2j * self, jack_nframes_t nframes)
+{
+	struct a2j_stream * stream_ptr = &self->stream[A2J_PORT_PLAYBACK];
+	struct a2j_port ** port_ptr;
+	struct a2j_port * port;
+	jack_midi_iterator_t iter;
+	jack_midi_event_t jack_event;
+	snd_seq_event_t alsa_event;
+	snd_seq_real_time_t out_rt;
+	int64_t out_time;
+	int queued = 0;
+	int err;
+	int i;
 
-	self->cycle_start = jack_last_frame_time (self->jack_client);
-	
-	stream_ptr = &self->stream;
 	a2j_add_ports (stream_ptr);
-	
-	// process ports
-	
+
 	for (i = 0 ; i < PORT_HASH_SIZE ; i++) {
 
 		port_ptr = &stream_ptr->port_hash[i];
 
-		while (*port_ptr != NULL) {
+		while ((port = *port_ptr) != NULL) {
 
-			struct a2j_alsa_midi_event ev;
-			jack_nframes_t now;
-			jack_nframes_t one_period;
-			char *ev_buf;
-				
-			port = *port_ptr;
-			
 			if (port->is_dead) {
-				if (jack_ringbuffer_write_space (self->port_del) >= sizeof(port_ptr)) {
-				
+				if (jack_ringbuffer_write_space (self->port_del) >= sizeof(port)) {
 					a2j_debug("jack: removed port %s", port->name);
 					*port_ptr = port->next;
+					port->in_hash = false;
 					jack_ringbuffer_write (self->port_del, (char*)&port, sizeof(port));
 				} else {
 					a2j_error ("port deletion lost - no space in event buffer!");
+					port_ptr = &port->next;
 				}
-
-				port_ptr = &port->next;
 				continue;
 			}
 
-			port->jack_buf = jack_port_get_buffer(port->jack_port, nframes);
-				
-			/* grab data queued by the ALSA input thread and write it into the JACK
-			   port buffer. it will delivered during the JACK period that this
-			   function is called from.
-			*/
-				
-			/* first clear the JACK port buffer in preparation for new data 
-			 */
-				
-			// a2j_debug ("PORT: %s process input", jack_port_name (port->jack_port));
-				
-			jack_midi_clear_buffer (port->jack_buf);
-				
-			now = jack_frame_time (self->jack_client);
-			one_period = jack_get_buffer_size (self->jack_client);
-				
-			while (jack_ringbuffer_peek (port->inbound_events, (char*)&ev, sizeof(ev) ) == sizeof(ev) ) {
-					
-				jack_midi_data_t* buf;
-				jack_nframes_t offset;
-					
-				if (ev.time >= self->cycle_start) {
-					break;
+			port->jack_buf = jack_port_get_buffer (port->jack_port, nframes);
+
+			jack_midi_iterator_init (&iter, port->jack_buf);
+			while (jack_midi_iterator_next (&iter, &jack_event) == 0) {
+
+				snd_seq_ev_clear (&alsa_event);
+				snd_midi_event_reset_encode (stream_ptr->codec);
+				if (!snd_midi_event_encode (stream_ptr->codec, jack_event.buffer, jack_event.size, &alsa_event)) {
+					continue; // invalid event
 				}
-					
-				//jack_ringbuffer_read_advance (port->inbound_events, sizeof (ev));
-				ev_buf = (char *) alloca( sizeof(ev) + ev.size );
-					
-				if (jack_ringbuffer_peek (port->inbound_events, ev_buf, sizeof(ev) + ev.size ) != sizeof(ev) + ev.size)
-					break;
-					
-				offset = self->cycle_start - ev.time;
-				if (offset > one_period) {
-					/* from a previous cycle, somehow. cram it in at the front */
-					offset = 0;
+
+				snd_seq_ev_set_source (&alsa_event, self->port_id);
+				snd_seq_ev_set_dest (&alsa_event, port->remote.client, port->remote.port);
+
+				/* keep the events of a port in order whatever the rounding */
+				out_time = a2j_queue_time (self, self->cycle_start + jack_event.time + nframes);
+				if (out_time < port->last_out_time) {
+					out_time = port->last_out_time;
 				} else {
-					/* offset from start of the current cycle */
-					offset = one_period - offset;
+					port->last_out_time = out_time;
 				}
-					
-				a2j_debug ("event at %d offset %d", ev.time, offset);
-					
-				/* make sure there is space for it */
-					
-				buf = jack_midi_event_reserve (port->jack_buf, offset, ev.size);
-					
-				if (buf) {
-					/* grab the event */
-					memcpy( buf, ev_buf + sizeof(ev), ev.size );
+
+				out_rt.tv_sec = out_time / NSEC_PER_SEC;
+				out_rt.tv_nsec = out_time % NSEC_PER_SEC;
+				snd_seq_ev_schedule_real (&alsa_event, self->queue, 0, &out_rt);
+
+				err = snd_seq_event_output_buffer (self->seq, &alsa_event);
+				if (err == -EAGAIN) {
+					snd_seq_drain_output (self->seq);
+					err = snd_seq_event_output_buffer (self->seq, &alsa_event);
+				}
+
+				if (err < 0) {
+					a2j_error ("MIDI data lost (outgoing event buffer full) on %s", port->name);
 				} else {
-					/* throw it away (no space) */
-					a2j_error ("threw away MIDI event - not reserved at time %d", ev.time);
+					queued++;
 				}
-				jack_ringbuffer_read_advance (port->inbound_events, sizeof(ev) + ev.size);
-					
-				a2j_debug("input on %s: sucked %d bytes from inbound at %d", jack_port_name (port->jack_port), ev.size, ev.time);
 			}
-			
+
 			port_ptr = &port->next;
 		}
 	}
 
+	if (queued) {
+		err = snd_seq_drain_output (self->seq);
+		if (err < 0 && err != -EAGAIN) {
+			a2j_error ("cannot send MIDI events to ALSA: %s", snd_strerror (err));
+		}
+	}
+}
+
+/* Only the ports on the active list are visited: those the ALSA input
+   thread has put on the ready list since they were last idle, and those
+   that are not idle yet. A port is idle when nothing is left in its ring
+   and its buffer has been cleared.
+*/
+static int
+a2j_process (jack_nframes_t nframes, void * arg)
+{
+	struct a2j* self = (struct a2j *) arg;
+	struct a2j_stream * stream_ptr;
+	struct a2j_port ** port_ptr;
+	struct a2j_port * port;
+	jack_nframes_t one_period;
+
+	if (g_freewheeling) {
+		return 0;
+	}
+
+	self->cycle_start = jack_last_frame_time (self->jack_client);
+	one_period = jack_get_buffer_size (self->jack_client);
+
+	if (self->output) {
+		a2j_process_outgoing (self, nframes);
+	}
+	
+	stream_ptr = &self->stream[A2J_PORT_CAPTURE];
+	a2j_add_ports (stream_ptr);
+
+	while (jack_ringbuffer_read (self->ready_ports, (char*)&port, sizeof(port)) == sizeof(port)) {
+		if (!port->active) {
+			port->active = true;
+			port->active_next = stream_ptr->active;
+			stream_ptr->active = port;
+		}
+	}
+	
+	// process ports
+
+	port_ptr = &stream_ptr->active;
+
+	while ((port = *port_ptr) != NULL) {
+
+		if (port->is_dead) {
+			/* a port can die before a2j_add_ports has seen it */
+			if (!port->in_hash) {
+				port_ptr = &port->active_next;
+				continue;
+			}
+
+			if (jack_ringbuffer_write_space (self->port_del) >= sizeof(port)) {
+				a2j_debug("jack: removed port %s", port->name);
+				a2j_port_remove (stream_ptr->port_hash, port);
+				port->in_hash = false;
+				port->active = false;
+				*port_ptr = port->active_next;
+				jack_ringbuffer_write (self->port_del, (char*)&port, sizeof(port));
+			} else {
+				a2j_error ("port deletion lost - no space in event buffer!");
+				port_ptr = &port->active_next;
+			}
+			continue;
+		}
+
+		// a2j_debug ("PORT: %s process input", jack_port_name (port->jack_port));
+
+		if (!a2j_process_port (self, port, nframes, one_period)) {
+
+			/* idle: let the ALSA input thread queue it again, unless
+			   it wrote an event before it could see that */
+			port->queued = 0;
+			__sync_synchronize ();
+
+			if (jack_ringbuffer_read_space (port->inbound_events) == 0) {
+				port->active = false;
+				*port_ptr = port->active_next;
+				continue;
+			}
+		}
+
+		port_ptr = &port->active_next;
+	}
+
 	return 0;
 }
 
@@ -435,6 +615,8 @@ connect_to_alsa (struct a2j* self)
 {
 	int error;
 	void * thread_status;
+	snd_seq_queue_status_t * queue_status;
+	const snd_seq_real_time_t * queue_rt;
 
 	self->port_add = jack_ringbuffer_create(2 * MAX_PORTS * sizeof(snd_seq_addr_t));
 	if (self->port_add == NULL) {
@@ -446,8 +628,13 @@ connect_to_alsa (struct a2j* self)
 		goto free_ringbuffer_add;
 	}
 
-	if (!a2j_stream_init(self)) {
-		goto free_ringbuffer_outbound;
+	self->ready_ports = jack_ringbuffer_create(2 * MAX_PORTS * sizeof(struct a2j_port *));
+	if (self->ready_ports == NULL) {
+		goto free_ringbuffer_del;
+	}
+
+	if (!a2j_stream_init(self, A2J_PORT_CAPTURE) || !a2j_stream_init(self, A2J_PORT_PLAYBACK)) {
+		goto close_stream;
 	}
 
 	if ((error = snd_seq_open(&self->seq, "hw", SND_SEQ_OPEN_DUPLEX, 0)) < 0) {
@@ -484,8 +671,19 @@ connect_to_alsa (struct a2j* self)
 	}
 
 	snd_seq_start_queue (self->seq, self->queue, 0); 
+	snd_seq_drain_output (self->seq);
+
+	/* map JACK time onto the queue's real time, for the playback ports */
+	snd_seq_queue_status_alloca (&queue_status);
+	if ((error = snd_seq_get_queue_status (self->seq, self->queue, queue_status)) < 0) {
+		a2j_error("snd_seq_get_queue_status() failed");
+		goto close_seq_client;
+	}
+	queue_rt = snd_seq_queue_status_get_real_time (queue_status);
+	self->queue_start = jack_get_time () - ((jack_time_t) queue_rt->tv_sec * 1000000 + queue_rt->tv_nsec / 1000);
 
-	a2j_stream_attach (&self->stream);
+	a2j_stream_attach (&self->stream[A2J_PORT_CAPTURE]);
+	a2j_stream_attach (&self->stream[A2J_PORT_PLAYBACK]);
 
 	if ((error = snd_seq_nonblock(self->seq, 1)) < 0) {
 		a2j_error("snd_seq_nonblock() failed");
@@ -494,7 +692,8 @@ connect_to_alsa (struct a2j* self)
 
 	snd_seq_drop_input (self->seq);
 
-	a2j_add_ports(&self->stream);
+	a2j_add_ports(&self->stream[A2J_PORT_CAPTURE]);
+	a2j_add_ports(&self->stream[A2J_PORT_PLAYBACK]);
 
 	if (sem_init(&self->io_semaphore, 0, 0) < 0) {
 		a2j_error("can't create IO semaphore");
@@ -530,9 +729,10 @@ connect_to_alsa (struct a2j* self)
   close_seq_client:
 	snd_seq_close(self->seq);
   close_stream:
-	a2j_stream_close(self);
-  free_ringbuffer_outbound:
-	jack_ringbuffer_free(self->outbound_events);
+	a2j_stream_close(self, A2J_PORT_CAPTURE);
+	a2j_stream_close(self, A2J_PORT_PLAYBACK);
+	jack_ringbuffer_free(self->ready_ports);
+  free_ringbuffer_del:
 	jack_ringbuffer_free(self->port_del);
   free_ringbuffer_add:
 	jack_ringbuffer_free(self->port_add);
@@ -556,6 +756,7 @@ jack_initialize (jack_client_t *client, const char* load_init)
 	self->jack_client = client;
 
 	self->input = 1;
+	self->output = 0;
 	self->ignore_hardware_ports = 0;
         self->finishing = 0;
 
@@ -572,10 +773,17 @@ jack_initialize (jack_client_t *client, const char* load_init)
 
 			if (strncasecmp (token, "in", 2) == 0) {
 				self->input = 1;
+				self->output = 0;
 			}
 
 			if (strncasecmp (token, "out", 2) == 0) {
 				self->input = 0;
+				self->output = 1;
+			}
+
+			if (strcasecmp (token, "duplex") == 0) {
+				self->input = 1;
+				self->output = 1;
 			}
 
 			if (strncasecmp (token, "hw", 2) == 0) {
@@ -621,15 +829,18 @@ jack_finish (void *arg)
 	
 	jack_ringbuffer_reset (self->port_add);
 	
-	a2j_stream_detach (&self->stream);
+	a2j_stream_detach (&self->stream[A2J_PORT_CAPTURE]);
+	a2j_stream_detach (&self->stream[A2J_PORT_PLAYBACK]);
 	
 	snd_seq_close(self->seq);
 	self->seq = NULL;
 	
-	a2j_stream_close (self);
+	a2j_stream_close (self, A2J_PORT_CAPTURE);
+	a2j_stream_close (self, A2J_PORT_PLAYBACK);
 	
 	jack_ringbuffer_free(self->port_add);
 	jack_ringbuffer_free(self->port_del);
+	jack_ringbuffer_free(self->ready_ports);
 	
 	free (self);
 }
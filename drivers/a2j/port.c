@@ -70,17 +70,51 @@ a2j_alsa_connect_from (struct a2j * self, int client, int port)
 }
 
 void
-a2j_port_setdead (a2j_port_hash_t hash, snd_seq_addr_t addr)
+a2j_port_setdead (struct a2j * self, snd_seq_addr_t addr)
 {
-	struct a2j_port *port = a2j_port_get(hash, addr);
+	struct a2j_port *port = a2j_port_get(self->stream[A2J_PORT_CAPTURE].port_hash, addr);
+	bool found = false;
 
 	if (port) {
-		port->is_dead = true; // see jack_process_internal
-	} else {
+		port->is_dead = true; // see a2j_process
+		a2j_port_queue (self, port);
+		found = true;
+	}
+
+	port = a2j_port_get(self->stream[A2J_PORT_PLAYBACK].port_hash, addr);
+
+	if (port) {
+		port->is_dead = true; // see a2j_process_outgoing
+		found = true;
+	}
+
+	if (!found) {
 		a2j_debug("port_setdead: not found (%d:%d)", addr.client, addr.port);
 	}
 }
 
+/* Called from the ALSA input thread when a port has events for the JACK
+ * process thread, or has gone away, so that a2j_process visits it. A
+ * port is put on the ready list once; a2j_process lets it be put there
+ * again when it has nothing left to do for it.
+ */
+void
+a2j_port_queue (struct a2j * self, struct a2j_port * port)
+{
+	/* full barrier: the events written before this are seen by the
+	   process thread before it can see queued clear again */
+	if (__sync_val_compare_and_swap (&port->queued, 0, 1) != 0) {
+		return;
+	}
+
+	if (jack_ringbuffer_write_space (self->ready_ports) >= sizeof(port)) {
+		jack_ringbuffer_write (self->ready_ports, (char*)&port, sizeof(port));
+	} else {
+		port->queued = 0;
+		a2j_error ("ready port list full - %s not queued", port->name);
+	}
+}
+
 void
 a2j_port_free (struct a2j_port * port)
 {
@@ -103,19 +137,24 @@ a2j_port_fill_name (struct a2j_port * port_ptr, int input, snd_seq_client_info_t
 		    const snd_seq_port_info_t * port_info_ptr, bool make_unique)
 {
 	char *c;
+	/* the capture ports keep the names they had before there were
+	   playback ports; an ALSA port can have one of each */
+	const char *dir = input ? "" : " (playback)";
 
 	if (make_unique) {
 		snprintf (port_ptr->name,
 			  sizeof(port_ptr->name),
-			  "%s [%d]: %s",
+			  "%s [%d]%s: %s",
 			  snd_seq_client_info_get_name(client_info_ptr),
 			  snd_seq_client_info_get_client(client_info_ptr),
+			  dir,
 			  snd_seq_port_info_get_name(port_info_ptr));
 	} else {
 		snprintf (port_ptr->name,
 			  sizeof(port_ptr->name),
-			  "%s: %s",
+			  "%s%s: %s",
 			  snd_seq_client_info_get_name(client_info_ptr),
+			  dir,
 			  snd_seq_port_info_get_name(port_info_ptr));
 	}
 	
@@ -128,7 +167,7 @@ a2j_port_fill_name (struct a2j_port * port_ptr, int input, snd_seq_client_info_t
 }
 
 struct a2j_port *
-a2j_port_create (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info_t * info)
+a2j_port_create (struct a2j * self, int dir, snd_seq_addr_t addr, const snd_seq_port_info_t * info)
 {
 	struct a2j_port *port;
 	int err;
@@ -137,7 +176,7 @@ a2j_port_create (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info
 	int jack_caps;
 	struct a2j_stream * stream_ptr;
 
-	stream_ptr = &self->stream;
+	stream_ptr = &self->stream[dir];
 
 	if ((err = snd_seq_client_info_malloc (&client_info_ptr)) != 0) {
 		a2j_error("Failed to allocate client info");
@@ -164,12 +203,12 @@ a2j_port_create (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info
 	port->jack_port = JACK_INVALID_PORT;
 	port->remote = addr;
 
-	a2j_port_fill_name (port, self->input, client_info_ptr, info, true);
+	a2j_port_fill_name (port, dir == A2J_PORT_CAPTURE, client_info_ptr, info, true);
 
 	/* Add port to list early, before registering to JACK, so map functionality is guaranteed to work during port registration */
 	list_add_tail (&port->siblings, &stream_ptr->list);
 	
-	if (self->input) {
+	if (dir == A2J_PORT_CAPTURE) {
 		jack_caps = JackPortIsOutput;
 	} else {
 		jack_caps = JackPortIsInput;
@@ -186,7 +225,7 @@ a2j_port_create (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info
 		goto fail_free_port;
 	}
 
-	if (self->input) {
+	if (dir == A2J_PORT_CAPTURE) {
 		err = a2j_alsa_connect_from(self, port->remote.client, port->remote.port);
 	} else {
 		err = snd_seq_connect_to(self->seq, self->port_id, port->remote.client, port->remote.port);
@@ -197,7 +236,9 @@ a2j_port_create (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info
 		goto fail_free_port;
 	}
 
-	port->inbound_events = jack_ringbuffer_create(MAX_EVENT_SIZE*16);
+	if (dir == A2J_PORT_CAPTURE) {
+		port->inbound_events = jack_ringbuffer_create(MAX_EVENT_SIZE*16);
+	}
 
 	a2j_info("port created: %s", port->name);
 	return port;
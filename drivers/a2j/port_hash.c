@@ -61,3 +61,18 @@ a2j_port_insert(
   port->next = *pport;
   *pport = port;
 }
+
+void
+a2j_port_remove(
+  a2j_port_hash_t hash,
+  struct a2j_port * port)
+{
+  struct a2j_port **pport = &hash[a2j_port_hash(port->remote)];
+  while (*pport) {
+    if (*pport == port) {
+      *pport = port->next;
+      return;
+    }
+    pport = &(*pport)->next;
+  }
+}
@@ -27,6 +27,11 @@ a2j_port_insert(
   a2j_port_hash_t hash,
   struct a2j_port * port);
 
+void
+a2j_port_remove(
+  a2j_port_hash_t hash,
+  struct a2j_port * port);
+
 struct a2j_port *
 a2j_port_get(
   a2j_port_hash_t hash,
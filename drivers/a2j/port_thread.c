@@ -77,7 +77,7 @@ a2j_find_port_by_jack_port_name(
 
 static
 void
-a2j_update_port_type (struct a2j * self, snd_seq_addr_t addr, int caps, const snd_seq_port_info_t * info)
+a2j_update_port_type (struct a2j * self, int dir, snd_seq_addr_t addr, int caps, const snd_seq_port_info_t * info)
 {
 	struct a2j_stream * stream_ptr;
 	int alsa_mask;
@@ -85,10 +85,10 @@ a2j_update_port_type (struct a2j * self, snd_seq_addr_t addr, int caps, const sn
 
 	a2j_debug("update_port_type(%d:%d)", addr.client, addr.port);
 
-	stream_ptr = &self->stream;
+	stream_ptr = &self->stream[dir];
 	port_ptr = a2j_find_port_by_addr(stream_ptr, addr);
 
-	if (self->input) {
+	if (dir == A2J_PORT_CAPTURE) {
 		alsa_mask = SND_SEQ_PORT_CAP_SUBS_READ;
 	} else {
 		alsa_mask = SND_SEQ_PORT_CAP_SUBS_WRITE;
@@ -97,11 +97,14 @@ a2j_update_port_type (struct a2j * self, snd_seq_addr_t addr, int caps, const sn
 	if (port_ptr != NULL && (caps & alsa_mask) != alsa_mask) {
 		a2j_debug("setdead: %s", port_ptr->name);
 		port_ptr->is_dead = true;
+		if (dir == A2J_PORT_CAPTURE) {
+			a2j_port_queue (self, port_ptr);
+		}
 	}
 
 	if (port_ptr == NULL && (caps & alsa_mask) == alsa_mask) {
 		if(jack_ringbuffer_write_space(stream_ptr->new_ports) >= sizeof(port_ptr)) {
-			port_ptr = a2j_port_create (self, addr, info);
+			port_ptr = a2j_port_create (self, dir, addr, info);
 			if (port_ptr != NULL) {
 				jack_ringbuffer_write(stream_ptr->new_ports, (char *)&port_ptr, sizeof(port_ptr));
 			}
@@ -196,7 +199,13 @@ a2j_update_port (struct a2j * self, snd_seq_addr_t addr, const snd_seq_port_info
 		return;
 	}
 
-	a2j_update_port_type (self, addr, port_caps, info);
+	if (self->input) {
+		a2j_update_port_type (self, A2J_PORT_CAPTURE, addr, port_caps, info);
+	}
+
+	if (self->output) {
+		a2j_update_port_type (self, A2J_PORT_PLAYBACK, addr, port_caps, info);
+	}
 }
 
 void
@@ -1116,15 +1116,14 @@ void do_jack_output(process_jack_t *proc)
 {
 	output_port_t *port = (output_port_t*) proc->port;
 	int nevents = jack_midi_get_event_count(proc->buffer);
-	int i;
+	jack_midi_iterator_t iter;
+	jack_midi_event_t event;
 	if (nevents)
 		debug_log("jack_out: %d events in %s", nevents, port->base.name);
-	for (i=0; i<nevents; ++i) {
-		jack_midi_event_t event;
+	jack_midi_iterator_init(&iter, proc->buffer);
+	while (jack_midi_iterator_next(&iter, &event) == 0) {
 		event_head_t hdr;
 
-		jack_midi_event_get(&event, proc->buffer, i);
-
 		if (jack_ringbuffer_write_space(port->base.data_ring) < event.size || jack_ringbuffer_write_space(port->base.event_ring) < sizeof(hdr)) {
 			debug_log("jack_out: output buffer overflow on %s", port->base.name);
 			break;
@@ -858,18 +858,17 @@ static
 void do_jack_output(alsa_seqmidi_t *self, port_t *port, struct process_info* info)
 {
 	stream_t *str = &self->stream[info->dir];
-	int nevents = jack_midi_get_event_count(port->jack_buf);
-	int i;
-	for (i=0; i<nevents; ++i) {
-		jack_midi_event_t jack_event;
+	jack_midi_iterator_t iter;
+	jack_midi_event_t jack_event;
+
+	jack_midi_iterator_init(&iter, port->jack_buf);
+	while (jack_midi_iterator_next(&iter, &jack_event) == 0) {
 		snd_seq_event_t alsa_event;
 		int64_t frame_offset;
 		int64_t out_time;
 		snd_seq_real_time_t out_rt;
 		int err;
 
-		jack_midi_event_get(&jack_event, port->jack_buf, i);
-
 		snd_seq_ev_clear(&alsa_event);
 		snd_midi_event_reset_encode(str->codec);
 		if (!snd_midi_event_encode(str->codec, jack_event.buffer, jack_event.size, &alsa_event))
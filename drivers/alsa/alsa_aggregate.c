@@ -0,0 +1,1085 @@
+/*
+    Additional ALSA devices resampled to the clock of the main device.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <jack/internal.h>
+#include <jack/jslist.h>
+
+#include "alsa_driver.h"
+#include "alsa_aggregate.h"
+
+/* The resampler is a Kaiser windowed sinc interpolator. The filter is
+   tabulated at AGG_PHASES offsets between two input frames, and the
+   coefficients for an offset in between are interpolated from the two
+   nearest rows.
+*/
+#define AGG_HALF_TAPS   24
+#define AGG_TAPS        (2 * AGG_HALF_TAPS)
+#define AGG_PHASES      64
+#define AGG_CUTOFF      0.45	/* of the sample rate */
+#define AGG_KAISER_BETA 8.0
+
+/* The ratio is set by a PI loop on the level of the device, and the
+   level is smoothed over a quarter of the loop's time constant first so
+   that the steps of the hardware pointer do not show up as pitch
+   modulation. The time constant starts at AGG_LOCK_SECONDS, to lock on
+   quickly, and grows to AGG_LOOP_SECONDS. The ratio never moves further
+   than AGG_MAX_DRIFT from 1.
+*/
+#define AGG_LOCK_SECONDS 1.0
+#define AGG_LOOP_SECONDS 8.0
+#define AGG_MAX_DRIFT    0.005
+
+static float agg_filter[AGG_PHASES + 1][AGG_TAPS];
+static int agg_filter_ready = 0;
+
+typedef struct {
+	snd_pcm_format_t  format;
+	unsigned long     sample_bytes;
+	ReadCopyFunction  read_via_copy;
+	WriteCopyFunction write_via_copy;
+} agg_format_t;
+
+/* in order of preference; plughw: will convert anything else */
+static const agg_format_t agg_formats[] = {
+	{ SND_PCM_FORMAT_S32, 4, sample_move_dS_s32u24, sample_move_d32u24_sS },
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	{ SND_PCM_FORMAT_S24_3LE, 3, sample_move_dS_s24, sample_move_d24_sS },
+	{ SND_PCM_FORMAT_FLOAT_LE, 4, sample_move_floatLE_sSs, sample_move_dS_floatLE },
+#endif
+	{ SND_PCM_FORMAT_S16, 2, sample_move_dS_s16, sample_move_d16_sS },
+};
+
+#define AGG_NFORMATS (sizeof (agg_formats) / sizeof (agg_formats[0]))
+
+typedef struct {
+	snd_pcm_t                    *handle;
+	const char                   *name;
+	snd_pcm_stream_t              stream;
+	const agg_format_t           *format;
+	unsigned int                  nchannels;
+	snd_pcm_uframes_t             period_frames;
+	snd_pcm_uframes_t             buffer_frames;
+	char                         *raw;	/* buffer_frames interleaved device frames */
+	jack_default_audio_sample_t **bufs;	/* per channel, NULL if not connected */
+	jack_default_audio_sample_t **tmp;	/* playback only, buffer_frames per channel */
+	dither_state_t               *dither_state;
+	JSList                       *ports;
+
+	/* resampler input, not yet consumed, and the position in it of
+	   the next output frame */
+	jack_default_audio_sample_t **in;
+	unsigned long                 in_size;
+	unsigned long                 fill;
+	double                        pos;
+	double                        ratio;	/* input frames per output frame */
+
+	/* drift loop: level and error in frames, integral as a ratio */
+	double                        target;
+	double                        error;
+	double                        integral;
+	unsigned long                 cycles;
+	int                           running;
+} agg_stream_t;
+
+/* lock is held by alsa_aggregate_configure() while it replaces the
+   streams' buffers; the process thread only ever tries it, and sits
+   out the cycle if that fails. */
+struct _alsa_aggregate {
+	char           *device;
+	jack_client_t  *client;
+	jack_nframes_t  frame_rate;
+	jack_nframes_t  frames_per_cycle;
+	agg_stream_t    capture;
+	agg_stream_t    playback;
+	int             started;
+	pthread_mutex_t lock;
+};
+
+static double
+agg_bessel_i0 (double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	int k;
+
+	for (k = 1; k < 32; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static void
+agg_filter_init (void)
+{
+	double h[AGG_TAPS];
+	double t, x, w, sum;
+	int p, m;
+
+	if (agg_filter_ready) {
+		return;
+	}
+
+	for (p = 0; p <= AGG_PHASES; p++) {
+		sum = 0.0;
+		for (m = 0; m < AGG_TAPS; m++) {
+			t = m - (AGG_HALF_TAPS - 1) - (double) p / AGG_PHASES;
+			x = t / AGG_HALF_TAPS;
+			w = fabs (x) < 1.0 ?
+				agg_bessel_i0 (AGG_KAISER_BETA * sqrt (1.0 - x * x))
+				/ agg_bessel_i0 (AGG_KAISER_BETA) : 0.0;
+			h[m] = w * (t == 0.0 ? 2.0 * AGG_CUTOFF :
+				    sin (2.0 * M_PI * AGG_CUTOFF * t) / (M_PI * t));
+			sum += h[m];
+		}
+		/* unity gain at DC for every offset */
+		for (m = 0; m < AGG_TAPS; m++) {
+			agg_filter[p][m] = h[m] / sum;
+		}
+	}
+
+	agg_filter_ready = 1;
+}
+
+/* Produces up to nframes output frames, fewer if the input runs out,
+   and drops the input that no later output frame needs. Channels
+   whose output is NULL are skipped but consumed all the same.
+*/
+static unsigned long
+agg_resample (agg_stream_t *s, jack_default_audio_sample_t **out,
+	      unsigned long nframes)
+{
+	float coef[AGG_TAPS];
+	const float *a, *b;
+	jack_default_audio_sample_t *x;
+	unsigned long done, i, first;
+	unsigned int chn, m, p;
+	double phase;
+	float frac, acc;
+
+	for (done = 0; done < nframes; done++) {
+
+		i = (unsigned long) s->pos;
+		if (i + AGG_HALF_TAPS >= s->fill) {
+			break;
+		}
+
+		phase = (s->pos - i) * AGG_PHASES;
+		p = (unsigned int) phase;
+		frac = phase - p;
+		a = agg_filter[p];
+		b = agg_filter[p + 1];
+		for (m = 0; m < AGG_TAPS; m++) {
+			coef[m] = a[m] + (b[m] - a[m]) * frac;
+		}
+
+		first = i - (AGG_HALF_TAPS - 1);
+		for (chn = 0; chn < s->nchannels; chn++) {
+			if (out[chn] == NULL) {
+				continue;
+			}
+			x = s->in[chn] + first;
+			acc = 0.0f;
+			for (m = 0; m < AGG_TAPS; m++) {
+				acc += coef[m] * x[m];
+			}
+			out[chn][done] = acc;
+		}
+
+		s->pos += s->ratio;
+	}
+
+	first = (unsigned long) s->pos - (AGG_HALF_TAPS - 1);
+	if (first > s->fill) {
+		first = s->fill;
+	}
+	if (first) {
+		for (chn = 0; chn < s->nchannels; chn++) {
+			memmove (s->in[chn], s->in[chn] + first,
+				 (s->fill - first) * sizeof (jack_default_audio_sample_t));
+		}
+		s->fill -= first;
+		s->pos -= first;
+	}
+
+	return done;
+}
+
+/* Empties the resampler and has the loop lock on again, but keeps the
+   ratio and its integral, which carry what has been learnt about the
+   drift.
+*/
+static void
+agg_stream_reset (agg_stream_t *s)
+{
+	unsigned int chn;
+
+	for (chn = 0; chn < s->nchannels; chn++) {
+		memset (s->in[chn], 0, (AGG_HALF_TAPS - 1)
+			* sizeof (jack_default_audio_sample_t));
+	}
+	s->fill = AGG_HALF_TAPS - 1;
+	s->pos = AGG_HALF_TAPS - 1;
+	s->error = 0.0;
+	s->cycles = 0;
+	s->running = 0;
+}
+
+static void
+agg_stream_follow (alsa_aggregate_t *agg, agg_stream_t *s, double level)
+{
+	double seconds, cycles, kp, ki, alpha, ratio;
+
+	seconds = AGG_LOCK_SECONDS + (double) s->cycles++
+		* agg->frames_per_cycle / (2.0 * agg->frame_rate);
+	if (seconds > AGG_LOOP_SECONDS) {
+		seconds = AGG_LOOP_SECONDS;
+	}
+
+	/* critically damped, with that time constant */
+	cycles = seconds * agg->frame_rate / agg->frames_per_cycle;
+	kp = 2.0 / (agg->frames_per_cycle * cycles);
+	ki = 1.0 / (agg->frames_per_cycle * cycles * cycles);
+	alpha = cycles > 4.0 ? 4.0 / cycles : 1.0;
+
+	s->error += alpha * ((level - s->target) - s->error);
+	s->integral += ki * s->error;
+
+	ratio = 1.0 + kp * s->error + s->integral;
+
+	if (ratio > 1.0 + AGG_MAX_DRIFT || ratio < 1.0 - AGG_MAX_DRIFT) {
+		/* hold the integral rather than wind it up */
+		s->integral -= ki * s->error;
+		ratio = ratio > 1.0 ? 1.0 + AGG_MAX_DRIFT : 1.0 - AGG_MAX_DRIFT;
+	}
+
+	s->ratio = ratio;
+}
+
+/* The frames the device has ready to capture, or still has queued for
+   playback, as of now: the hardware pointer reported with the status
+   timestamp, moved on by the time since.
+*/
+static int
+agg_stream_level (alsa_aggregate_t *agg, agg_stream_t *s, double *level)
+{
+	snd_pcm_status_t *status;
+	snd_pcm_state_t state;
+	snd_htimestamp_t ts;
+	struct timespec now;
+	int64_t age;
+	double elapsed = 0.0;
+	int err;
+
+	snd_pcm_status_alloca (&status);
+
+	if ((err = snd_pcm_status (s->handle, status)) < 0) {
+		return err;
+	}
+
+	state = snd_pcm_status_get_state (status);
+	if (state == SND_PCM_STATE_XRUN || state == SND_PCM_STATE_SUSPENDED) {
+		return -EPIPE;
+	}
+
+	/* the timestamp is only of use if it is a recent one in
+	   CLOCK_MONOTONIC, which depends on the kernel */
+	if (state == SND_PCM_STATE_RUNNING) {
+		clock_gettime (CLOCK_MONOTONIC, &now);
+		snd_pcm_status_get_htstamp (status, &ts);
+		age = (int64_t) (now.tv_sec - ts.tv_sec) * 1000000000LL
+			+ (now.tv_nsec - ts.tv_nsec);
+		if (age >= 0 && age < (int64_t) s->period_frames
+		    * 1000000000LL / agg->frame_rate) {
+			elapsed = age * 1e-9 * agg->frame_rate;
+		}
+	}
+
+	if (s->stream == SND_PCM_STREAM_CAPTURE) {
+		*level = snd_pcm_status_get_avail (status) + elapsed;
+	} else {
+		*level = snd_pcm_status_get_delay (status) - elapsed;
+	}
+
+	return 0;
+}
+
+static int
+agg_stream_start (alsa_aggregate_t *agg, agg_stream_t *s)
+{
+	snd_pcm_sframes_t n;
+	snd_pcm_uframes_t silence;
+	int err;
+
+	if ((err = snd_pcm_prepare (s->handle)) < 0) {
+		jack_error ("ALSA: prepare error for aggregate %s on \"%s\" (%s)",
+			    s->name, agg->device, snd_strerror (err));
+		return -1;
+	}
+
+	agg_stream_reset (s);
+
+	if (s->stream == SND_PCM_STREAM_PLAYBACK) {
+		/* start with silence, to be at the target level when the
+		   first cycle is written */
+		memset (s->raw, 0, s->buffer_frames * s->nchannels
+			* s->format->sample_bytes);
+		for (silence = s->target + agg->frames_per_cycle; silence;
+		     silence -= n) {
+			n = snd_pcm_writei (s->handle, s->raw,
+					    silence < s->buffer_frames ?
+					    silence : s->buffer_frames);
+			if (n <= 0) {
+				break;
+			}
+		}
+		s->running = 1;
+	}
+
+	if ((err = snd_pcm_start (s->handle)) < 0) {
+		jack_error ("ALSA: could not start aggregate %s on \"%s\" (%s)",
+			    s->name, agg->device, snd_strerror (err));
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+agg_stream_recover (alsa_aggregate_t *agg, agg_stream_t *s)
+{
+	jack_error ("ALSA: xrun on aggregate %s on \"%s\", restarting it",
+		    s->name, agg->device);
+	snd_pcm_drop (s->handle);
+	agg_stream_start (agg, s);
+}
+
+static void
+agg_stream_release (agg_stream_t *s)
+{
+	unsigned int chn;
+
+	for (chn = 0; chn < s->nchannels; chn++) {
+		if (s->in) {
+			free (s->in[chn]);
+		}
+		if (s->tmp) {
+			free (s->tmp[chn]);
+		}
+	}
+	free (s->in);
+	free (s->tmp);
+	free (s->bufs);
+	free (s->dither_state);
+	free (s->raw);
+
+	s->in = 0;
+	s->tmp = 0;
+	s->bufs = 0;
+	s->dither_state = 0;
+	s->raw = 0;
+	s->nchannels = 0;
+}
+
+static int
+agg_stream_alloc (agg_stream_t *s)
+{
+	unsigned int chn;
+
+	s->raw = malloc (s->buffer_frames * s->nchannels
+			 * s->format->sample_bytes);
+	s->in = calloc (s->nchannels, sizeof (jack_default_audio_sample_t *));
+	s->bufs = calloc (s->nchannels,
+			  sizeof (jack_default_audio_sample_t *));
+	s->dither_state = calloc (s->nchannels, sizeof (dither_state_t));
+	if (s->stream == SND_PCM_STREAM_PLAYBACK) {
+		s->tmp = calloc (s->nchannels,
+				 sizeof (jack_default_audio_sample_t *));
+		if (s->tmp == NULL) {
+			return -1;
+		}
+	}
+	if (!s->raw || !s->in || !s->bufs || !s->dither_state) {
+		return -1;
+	}
+	for (chn = 0; chn < s->nchannels; chn++) {
+		s->in[chn] = malloc (s->in_size
+				     * sizeof (jack_default_audio_sample_t));
+		if (s->in[chn] == NULL) {
+			return -1;
+		}
+		if (s->tmp) {
+			s->tmp[chn] = malloc (
+				s->buffer_frames
+				* sizeof (jack_default_audio_sample_t));
+			if (s->tmp[chn] == NULL) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Sets the device up for agg's rate and cycle, and fills in next, with
+   buffers of its own, as the stream s is to become. s itself is left
+   alone, so that the caller can still go back to it.
+*/
+static int
+agg_stream_configure (alsa_aggregate_t *agg, agg_stream_t *s,
+		      agg_stream_t *next)
+{
+	snd_pcm_hw_params_t *hw_params;
+	snd_pcm_sw_params_t *sw_params;
+	snd_pcm_uframes_t period = agg->frames_per_cycle / 2;
+	snd_pcm_uframes_t buffer = (agg->frames_per_cycle
+				    + agg->frame_rate / 1000) * 4;
+	unsigned int rate = agg->frame_rate;
+	unsigned int nchannels;
+	unsigned int i;
+	int err;
+
+	snd_pcm_hw_params_alloca (&hw_params);
+	snd_pcm_sw_params_alloca (&sw_params);
+
+	*next = *s;
+	next->in = 0;
+	next->tmp = 0;
+	next->bufs = 0;
+	next->dither_state = 0;
+	next->raw = 0;
+	next->nchannels = 0;
+
+	if ((err = snd_pcm_hw_params_any (s->handle, hw_params)) < 0) {
+		jack_error ("ALSA: no configurations available for aggregate"
+			    " %s on \"%s\"", s->name, agg->device);
+		return -1;
+	}
+
+	if ((err = snd_pcm_hw_params_set_access (
+		     s->handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+		jack_error ("ALSA: aggregate %s on \"%s\" cannot do interleaved"
+			    " read/write access", s->name, agg->device);
+		return -1;
+	}
+
+	for (i = 0; i < AGG_NFORMATS; i++) {
+		if (snd_pcm_hw_params_set_format (s->handle, hw_params,
+						  agg_formats[i].format) == 0) {
+			break;
+		}
+	}
+	if (i == AGG_NFORMATS) {
+		jack_error ("ALSA: no usable sample format for aggregate %s"
+			    " on \"%s\" (try plughw:)", s->name, agg->device);
+		return -1;
+	}
+	next->format = &agg_formats[i];
+
+	if ((err = snd_pcm_hw_params_get_channels_max (hw_params,
+						       &nchannels)) < 0) {
+		jack_error ("ALSA: cannot get channel count for aggregate %s"
+			    " on \"%s\"", s->name, agg->device);
+		return -1;
+	}
+	if (nchannels > 1024) {
+		/* the plug layer says "anything", take stereo */
+		nchannels = 2;
+	}
+	if (s->ports && nchannels != s->nchannels) {
+		/* there is a port for each channel */
+		jack_error ("ALSA: aggregate %s on \"%s\" would change from"
+			    " %u to %u channels", s->name, agg->device,
+			    s->nchannels, nchannels);
+		return -1;
+	}
+	if ((err = snd_pcm_hw_params_set_channels (s->handle, hw_params,
+						   nchannels)) < 0) {
+		jack_error ("ALSA: cannot set channel count to %u for"
+			    " aggregate %s on \"%s\"", nchannels, s->name,
+			    agg->device);
+		return -1;
+	}
+
+	/* drift is ours to take up, not alsa-lib's resampler's */
+	snd_pcm_hw_params_set_rate_resample (s->handle, hw_params, 0);
+
+	if ((err = snd_pcm_hw_params_set_rate (s->handle, hw_params,
+					       rate, 0)) < 0) {
+		jack_error ("ALSA: aggregate %s on \"%s\" cannot run at %u Hz",
+			    s->name, agg->device, rate);
+		return -1;
+	}
+
+	snd_pcm_hw_params_set_period_size_near (s->handle, hw_params,
+						&period, 0);
+	snd_pcm_hw_params_set_buffer_size_near (s->handle, hw_params,
+						&buffer);
+
+	if ((err = snd_pcm_hw_params (s->handle, hw_params)) < 0) {
+		jack_error ("ALSA: cannot set hardware parameters for"
+			    " aggregate %s on \"%s\" (%s)", s->name,
+			    agg->device, snd_strerror (err));
+		return -1;
+	}
+
+	snd_pcm_hw_params_get_period_size (hw_params, &next->period_frames, 0);
+	snd_pcm_hw_params_get_buffer_size (hw_params, &next->buffer_frames);
+
+	/* started by hand, and the timestamps feed the level */
+	snd_pcm_sw_params_current (s->handle, sw_params);
+	snd_pcm_sw_params_set_start_threshold (s->handle, sw_params,
+					       next->buffer_frames);
+	snd_pcm_sw_params_set_tstamp_mode (s->handle, sw_params,
+					   SND_PCM_TSTAMP_ENABLE);
+#if SND_LIB_VERSION >= 0x01001d
+	snd_pcm_sw_params_set_tstamp_type (s->handle, sw_params,
+					   SND_PCM_TSTAMP_TYPE_MONOTONIC);
+#endif
+	if ((err = snd_pcm_sw_params (s->handle, sw_params)) < 0) {
+		jack_error ("ALSA: cannot set software parameters for"
+			    " aggregate %s on \"%s\" (%s)", s->name,
+			    agg->device, snd_strerror (err));
+		return -1;
+	}
+
+	/* The level to hold: one cycle for the next read, or nothing
+	   left at the end of the last write, with a device period and a
+	   filter's width over, and a margin for late wakeups of half a
+	   cycle and a millisecond. */
+	next->target = next->period_frames + AGG_HALF_TAPS
+		+ agg->frames_per_cycle / 2 + agg->frame_rate / 1000;
+	if (s->stream == SND_PCM_STREAM_CAPTURE) {
+		next->target += agg->frames_per_cycle;
+	}
+
+	next->nchannels = nchannels;
+	next->in_size = next->buffer_frames * 4 + AGG_TAPS;
+	if (agg_stream_alloc (next)) {
+		jack_error ("ALSA: cannot allocate buffers for aggregate %s"
+			    " on \"%s\"", s->name, agg->device);
+		agg_stream_release (next);
+		return -1;
+	}
+
+	next->ratio = 1.0;
+	next->integral = 0.0;
+	agg_stream_reset (next);
+
+	return 0;
+}
+
+/* What the device was set up as before agg_stream_configure(), so that
+   a failed reconfiguration can be undone. */
+typedef struct {
+	snd_pcm_hw_params_t *hw_params;
+	snd_pcm_sw_params_t *sw_params;
+	int                  valid;
+} agg_stream_setup_t;
+
+static void
+agg_stream_save (agg_stream_t *s, agg_stream_setup_t *setup)
+{
+	setup->valid = s->handle && s->nchannels
+		&& snd_pcm_hw_params_current (s->handle, setup->hw_params) == 0
+		&& snd_pcm_sw_params_current (s->handle, setup->sw_params) == 0;
+}
+
+static void
+agg_stream_restore (alsa_aggregate_t *agg, agg_stream_t *s,
+		    agg_stream_setup_t *setup)
+{
+	if (setup->valid
+	    && (snd_pcm_hw_params (s->handle, setup->hw_params) < 0
+		|| snd_pcm_sw_params (s->handle, setup->sw_params) < 0)) {
+		jack_error ("ALSA: cannot restore the setup of aggregate %s"
+			    " on \"%s\"", s->name, agg->device);
+	}
+}
+
+alsa_aggregate_t *
+alsa_aggregate_new (const char *device, jack_client_t *client,
+		    int capture, int playback)
+{
+	alsa_aggregate_t *agg;
+	int err;
+
+	agg_filter_init ();
+
+	agg = (alsa_aggregate_t *) calloc (1, sizeof (alsa_aggregate_t));
+	pthread_mutex_init (&agg->lock, NULL);
+	agg->device = strdup (device);
+	agg->client = client;
+	agg->capture.name = "capture";
+	agg->capture.stream = SND_PCM_STREAM_CAPTURE;
+	agg->playback.name = "playback";
+	agg->playback.stream = SND_PCM_STREAM_PLAYBACK;
+
+	if (capture
+	    && (err = snd_pcm_open (&agg->capture.handle, device,
+				    SND_PCM_STREAM_CAPTURE,
+				    SND_PCM_NONBLOCK)) < 0) {
+		jack_info ("ALSA: cannot open \"%s\" for aggregate capture"
+			   " (%s)", device, snd_strerror (err));
+		agg->capture.handle = 0;
+	}
+
+	if (playback
+	    && (err = snd_pcm_open (&agg->playback.handle, device,
+				    SND_PCM_STREAM_PLAYBACK,
+				    SND_PCM_NONBLOCK)) < 0) {
+		jack_info ("ALSA: cannot open \"%s\" for aggregate playback"
+			   " (%s)", device, snd_strerror (err));
+		agg->playback.handle = 0;
+	}
+
+	if (!agg->capture.handle && !agg->playback.handle) {
+		jack_error ("ALSA: cannot open aggregate device \"%s\"",
+			    device);
+		alsa_aggregate_delete (agg);
+		return NULL;
+	}
+
+	return agg;
+}
+
+void
+alsa_aggregate_delete (alsa_aggregate_t *agg)
+{
+	if (agg->capture.handle) {
+		snd_pcm_close (agg->capture.handle);
+	}
+	if (agg->playback.handle) {
+		snd_pcm_close (agg->playback.handle);
+	}
+	agg_stream_release (&agg->capture);
+	agg_stream_release (&agg->playback);
+	pthread_mutex_destroy (&agg->lock);
+	free (agg->device);
+	free (agg);
+}
+
+static void
+agg_stream_commit (alsa_aggregate_t *agg, agg_stream_t *s, agg_stream_t *next)
+{
+	agg_stream_release (s);
+	*s = *next;
+
+	jack_info ("ALSA: aggregate %s on \"%s\": %u channels, period %lu,"
+		   " buffer %lu frames", s->name, agg->device, s->nchannels,
+		   (unsigned long) s->period_frames,
+		   (unsigned long) s->buffer_frames);
+}
+
+static void
+agg_streams_drop (alsa_aggregate_t *agg)
+{
+	if (agg->capture.handle) {
+		snd_pcm_drop (agg->capture.handle);
+	}
+	if (agg->playback.handle) {
+		snd_pcm_drop (agg->playback.handle);
+	}
+}
+
+static int
+agg_streams_start (alsa_aggregate_t *agg)
+{
+	if (agg->capture.handle && agg_stream_start (agg, &agg->capture)) {
+		return -1;
+	}
+	if (agg->playback.handle && agg_stream_start (agg, &agg->playback)) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Either both streams take on the new rate and cycle or, if one of
+   them cannot, both stay as they were. Running streams are stopped
+   for this, since a running device cannot be set up, and started
+   again afterwards either way.
+*/
+int
+alsa_aggregate_configure (alsa_aggregate_t *agg, jack_nframes_t frame_rate,
+			  jack_nframes_t frames_per_cycle)
+{
+	agg_stream_t capture, playback;
+	agg_stream_setup_t capture_setup, playback_setup;
+	jack_nframes_t old_frame_rate = agg->frame_rate;
+	jack_nframes_t old_frames_per_cycle = agg->frames_per_cycle;
+	int ret = 0;
+
+	snd_pcm_hw_params_alloca (&capture_setup.hw_params);
+	snd_pcm_sw_params_alloca (&capture_setup.sw_params);
+	snd_pcm_hw_params_alloca (&playback_setup.hw_params);
+	snd_pcm_sw_params_alloca (&playback_setup.sw_params);
+
+	pthread_mutex_lock (&agg->lock);
+
+	if (agg->started) {
+		agg_streams_drop (agg);
+	}
+
+	agg_stream_save (&agg->capture, &capture_setup);
+	agg_stream_save (&agg->playback, &playback_setup);
+
+	agg->frame_rate = frame_rate;
+	agg->frames_per_cycle = frames_per_cycle;
+
+	if (agg->capture.handle
+	    && agg_stream_configure (agg, &agg->capture, &capture)) {
+		ret = -1;
+	} else if (agg->playback.handle
+		   && agg_stream_configure (agg, &agg->playback, &playback)) {
+		if (agg->capture.handle) {
+			agg_stream_release (&capture);
+		}
+		ret = -1;
+	}
+
+	if (ret) {
+		agg->frame_rate = old_frame_rate;
+		agg->frames_per_cycle = old_frames_per_cycle;
+		if (agg->capture.handle) {
+			agg_stream_restore (agg, &agg->capture,
+					    &capture_setup);
+		}
+		if (agg->playback.handle) {
+			agg_stream_restore (agg, &agg->playback,
+					    &playback_setup);
+		}
+	} else {
+		if (agg->capture.handle) {
+			agg_stream_commit (agg, &agg->capture, &capture);
+		}
+		if (agg->playback.handle) {
+			agg_stream_commit (agg, &agg->playback, &playback);
+		}
+	}
+
+	if (agg->started && agg_streams_start (agg)) {
+		ret = -1;
+	}
+
+	pthread_mutex_unlock (&agg->lock);
+
+	return ret;
+}
+
+int
+alsa_aggregate_attach (alsa_aggregate_t *agg, unsigned long *capture_index,
+		       unsigned long *playback_index)
+{
+	char buf[32];
+	jack_port_t *port;
+	jack_latency_range_t range;
+	unsigned int chn;
+
+	for (chn = 0; chn < agg->capture.nchannels; chn++) {
+
+		snprintf (buf, sizeof(buf), "capture_%lu", ++*capture_index);
+
+		if ((port = jack_port_register (
+			     agg->client, buf, JACK_DEFAULT_AUDIO_TYPE,
+			     JackPortIsOutput|JackPortIsPhysical
+			     |JackPortIsTerminal, 0)) == NULL) {
+			jack_error ("ALSA: cannot register port for %s", buf);
+			break;
+		}
+
+		range.min = range.max = agg->frames_per_cycle
+			+ agg->capture.target;
+		jack_port_set_latency_range (port, JackCaptureLatency, &range);
+
+		agg->capture.ports = jack_slist_append (agg->capture.ports,
+							port);
+	}
+
+	for (chn = 0; chn < agg->playback.nchannels; chn++) {
+
+		snprintf (buf, sizeof(buf), "playback_%lu", ++*playback_index);
+
+		if ((port = jack_port_register (
+			     agg->client, buf, JACK_DEFAULT_AUDIO_TYPE,
+			     JackPortIsInput|JackPortIsPhysical
+			     |JackPortIsTerminal, 0)) == NULL) {
+			jack_error ("ALSA: cannot register port for %s", buf);
+			break;
+		}
+
+		range.min = range.max = agg->frames_per_cycle
+			+ agg->playback.target;
+		jack_port_set_latency_range (port, JackPlaybackLatency, &range);
+
+		agg->playback.ports = jack_slist_append (agg->playback.ports,
+							 port);
+	}
+
+	return 0;
+}
+
+int
+alsa_aggregate_detach (alsa_aggregate_t *agg)
+{
+	JSList *node;
+
+	for (node = agg->capture.ports; node; node = jack_slist_next (node)) {
+		jack_port_unregister (agg->client, (jack_port_t *) node->data);
+	}
+	jack_slist_free (agg->capture.ports);
+	agg->capture.ports = 0;
+
+	for (node = agg->playback.ports; node; node = jack_slist_next (node)) {
+		jack_port_unregister (agg->client, (jack_port_t *) node->data);
+	}
+	jack_slist_free (agg->playback.ports);
+	agg->playback.ports = 0;
+
+	return 0;
+}
+
+int
+alsa_aggregate_start (alsa_aggregate_t *agg)
+{
+	int ret;
+
+	pthread_mutex_lock (&agg->lock);
+	agg->started = 1;
+	ret = agg_streams_start (agg);
+	pthread_mutex_unlock (&agg->lock);
+
+	return ret;
+}
+
+int
+alsa_aggregate_stop (alsa_aggregate_t *agg)
+{
+	JSList *node;
+
+	/* silence the capture ports, we might be going offline */
+	for (node = agg->capture.ports; node; node = jack_slist_next (node)) {
+		memset (jack_port_get_buffer ((jack_port_t *) node->data,
+					      agg->frames_per_cycle),
+			0, agg->frames_per_cycle
+			* sizeof (jack_default_audio_sample_t));
+	}
+
+	pthread_mutex_lock (&agg->lock);
+	agg->started = 0;
+	agg_streams_drop (agg);
+	pthread_mutex_unlock (&agg->lock);
+
+	return 0;
+}
+
+/* Reads whatever the device has, as far as there is room for it. */
+static int
+agg_capture_fetch (agg_stream_t *s)
+{
+	snd_pcm_sframes_t n;
+	unsigned long frame_bytes = s->nchannels * s->format->sample_bytes;
+	unsigned int chn;
+
+	while (s->fill < s->in_size) {
+
+		n = s->in_size - s->fill;
+		if (n > (snd_pcm_sframes_t) s->buffer_frames) {
+			n = s->buffer_frames;
+		}
+
+		n = snd_pcm_readi (s->handle, s->raw, n);
+		if (n == -EAGAIN || n == 0) {
+			break;
+		}
+		if (n < 0) {
+			return n;
+		}
+
+		for (chn = 0; chn < s->nchannels; chn++) {
+			s->format->read_via_copy (
+				s->in[chn] + s->fill,
+				s->raw + chn * s->format->sample_bytes,
+				n, frame_bytes);
+		}
+		s->fill += n;
+	}
+
+	return 0;
+}
+
+static void
+agg_capture_read (alsa_aggregate_t *agg, jack_nframes_t nframes)
+{
+	agg_stream_t *s = &agg->capture;
+	jack_port_t *port;
+	JSList *node;
+	unsigned long done;
+	unsigned int chn;
+	double level;
+
+	for (chn = 0, node = s->ports; node;
+	     node = jack_slist_next (node), chn++) {
+		port = (jack_port_t *) node->data;
+		s->bufs[chn] = jack_port_connected (port) ?
+			jack_port_get_buffer (port, nframes) : NULL;
+	}
+
+	/* what the device has and what is still to be resampled, before
+	   the one is moved into the other */
+	if (agg_stream_level (agg, s, &level) < 0
+	    || (level += s->fill - s->pos, agg_capture_fetch (s)) < 0) {
+		agg_stream_recover (agg, s);
+	}
+
+	if (s->running) {
+		agg_stream_follow (agg, s, level);
+		done = agg_resample (s, s->bufs, nframes);
+		if (done < nframes) {
+			jack_error ("ALSA: aggregate capture on \"%s\" ran"
+				    " dry, resyncing", agg->device);
+			agg_stream_reset (s);
+		}
+	} else {
+		done = 0;
+		if (s->fill - s->pos >= s->target) {
+			/* start at the target level, dropping the rest */
+			s->pos += floor (s->fill - s->pos - s->target);
+			s->running = 1;
+			done = agg_resample (s, s->bufs, nframes);
+		}
+	}
+
+	for (chn = 0; chn < s->nchannels; chn++) {
+		if (s->bufs[chn] && done < nframes) {
+			memset (s->bufs[chn] + done, 0, (nframes - done)
+				* sizeof (jack_default_audio_sample_t));
+		}
+	}
+}
+
+static void
+agg_playback_write (alsa_aggregate_t *agg, jack_nframes_t nframes)
+{
+	agg_stream_t *s = &agg->playback;
+	jack_port_t *port;
+	JSList *node;
+	snd_pcm_sframes_t n;
+	unsigned long frame_bytes;
+	unsigned long done;
+	unsigned int chn;
+	double level;
+
+	if (agg_stream_level (agg, s, &level) < 0) {
+		agg_stream_recover (agg, s);
+	} else {
+		agg_stream_follow (agg, s, level + s->fill - s->pos);
+	}
+
+	if (s->fill + nframes > s->in_size) {
+		return;
+	}
+
+	for (chn = 0, node = s->ports; chn < s->nchannels; chn++) {
+		port = node ? (jack_port_t *) node->data : NULL;
+		node = node ? jack_slist_next (node) : NULL;
+		if (port && jack_port_connected (port)) {
+			memcpy (s->in[chn] + s->fill,
+				jack_port_get_buffer (port, nframes),
+				nframes * sizeof (jack_default_audio_sample_t));
+		} else {
+			memset (s->in[chn] + s->fill, 0,
+				nframes * sizeof (jack_default_audio_sample_t));
+		}
+	}
+	s->fill += nframes;
+
+	frame_bytes = s->nchannels * s->format->sample_bytes;
+
+	while ((done = agg_resample (s, s->tmp, s->buffer_frames)) > 0) {
+
+		for (chn = 0; chn < s->nchannels; chn++) {
+			s->format->write_via_copy (
+				s->raw + chn * s->format->sample_bytes,
+				s->tmp[chn], done, frame_bytes,
+				&s->dither_state[chn]);
+		}
+
+		n = snd_pcm_writei (s->handle, s->raw, done);
+		if (n == -EPIPE || n == -ESTRPIPE) {
+			agg_stream_recover (agg, s);
+			break;
+		}
+		if (n < (snd_pcm_sframes_t) done) {
+			jack_error ("ALSA: aggregate playback on \"%s\" is"
+				    " full, %lu frames dropped", agg->device,
+				    done - (n > 0 ? n : 0));
+			break;
+		}
+	}
+}
+
+void
+alsa_aggregate_read (alsa_aggregate_t *agg, jack_nframes_t nframes)
+{
+	JSList *node;
+
+	if (!agg->capture.handle) {
+		return;
+	}
+
+	if (pthread_mutex_trylock (&agg->lock)) {
+		/* being reconfigured, there is nothing to read */
+		for (node = agg->capture.ports; node;
+		     node = jack_slist_next (node)) {
+			if (jack_port_connected ((jack_port_t *) node->data)) {
+				memset (jack_port_get_buffer (
+						(jack_port_t *) node->data,
+						nframes),
+					0, nframes
+					* sizeof (jack_default_audio_sample_t));
+			}
+		}
+		return;
+	}
+
+	agg_capture_read (agg, nframes);
+	pthread_mutex_unlock (&agg->lock);
+}
+
+void
+alsa_aggregate_write (alsa_aggregate_t *agg, jack_nframes_t nframes)
+{
+	if (!agg->playback.handle) {
+		return;
+	}
+
+	if (pthread_mutex_trylock (&agg->lock)) {
+		/* being reconfigured, drop this cycle */
+		return;
+	}
+
+	agg_playback_write (agg, nframes);
+	pthread_mutex_unlock (&agg->lock);
+}
@@ -0,0 +1,51 @@
+/*
+    Additional ALSA devices resampled to the clock of the main device.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#ifndef __jack_alsa_aggregate_h__
+#define __jack_alsa_aggregate_h__
+
+#include <jack/jack.h>
+
+/* An aggregate device runs on its own clock. Every cycle of the main
+   device its capture is resampled into, and its playback out of, the
+   JACK ports it adds, at a ratio that follows how full the device is
+   as its hardware pointer reports. Clock drift is taken up by the
+   ratio rather than by xruns.
+*/
+
+typedef struct _alsa_aggregate alsa_aggregate_t;
+
+alsa_aggregate_t *alsa_aggregate_new (const char *device,
+				      jack_client_t *client,
+				      int capture, int playback);
+void alsa_aggregate_delete (alsa_aggregate_t *agg);
+
+int  alsa_aggregate_configure (alsa_aggregate_t *agg,
+			       jack_nframes_t frame_rate,
+			       jack_nframes_t frames_per_cycle);
+int  alsa_aggregate_attach (alsa_aggregate_t *agg,
+			    unsigned long *capture_index,
+			    unsigned long *playback_index);
+int  alsa_aggregate_detach (alsa_aggregate_t *agg);
+int  alsa_aggregate_start (alsa_aggregate_t *agg);
+int  alsa_aggregate_stop (alsa_aggregate_t *agg);
+void alsa_aggregate_read (alsa_aggregate_t *agg, jack_nframes_t nframes);
+void alsa_aggregate_write (alsa_aggregate_t *agg, jack_nframes_t nframes);
+
+#endif /* __jack_alsa_aggregate_h__ */
@@ -29,6 +29,7 @@
 #include <sys/types.h>
 #include <regex.h>
 #include <string.h>
+#include <time.h>
  
 #include <jack/internal.h>
 #include <jack/engine.h>
@@ -42,6 +43,7 @@
 #include "ice1712.h"
 #include "usx2y.h"
 #include "generic.h"
+#include "alsa_aggregate.h"
 
 extern void store_work_time (int);
 extern void store_wait_time (int);
@@ -79,6 +81,16 @@ alsa_driver_release_channel_dependent_memory (alsa_driver_t *driver)
 		driver->capture_interleave_skip = NULL;
 	}
 
+	if (driver->playback_bufs) {
+		free (driver->playback_bufs);
+		driver->playback_bufs = NULL;
+	}
+
+	if (driver->capture_bufs) {
+		free (driver->capture_bufs);
+		driver->capture_bufs = NULL;
+	}
+
 	if (driver->silent) {
 		free (driver->silent);
 		driver->silent = 0;
@@ -491,6 +503,30 @@ alsa_driver_configure_stream (alsa_driver_t *driver, char *device_name,
 		return -1;
 	}
 
+#if SND_LIB_VERSION >= 0x010017
+	/* woken by a timer, the period interrupts are not needed.  The
+	   PCM was opened with SND_PCM_NO_PERIOD_WAKEUP for this.
+
+	   XXX the hardware period is still frames_per_cycle; letting
+	   the card run a larger period than the JACK cycle in this
+	   mode is left for later.
+	*/
+	if (driver->timer_wakeup) {
+		if (!snd_pcm_hw_params_can_disable_period_wakeup (hw_params)) {
+			jack_info ("ALSA: %s cannot disable period interrupts",
+				   stream_name);
+		} else if ((err = snd_pcm_hw_params_set_period_wakeup (
+				    handle, hw_params, 0)) < 0) {
+			jack_error ("ALSA: cannot disable period interrupts "
+				    "for %s (%s)", stream_name,
+				    snd_strerror (err));
+		} else {
+			jack_info ("ALSA: period interrupts disabled for %s",
+				   stream_name);
+		}
+	}
+#endif
+
 	if ((err = snd_pcm_hw_params (handle, hw_params)) < 0) {
 		jack_error ("ALSA: cannot set hardware parameters for %s",
 			    stream_name);
@@ -524,6 +560,14 @@ alsa_driver_configure_stream (alsa_driver_t *driver, char *device_name,
 		return -1;
 	}
 
+	if (driver->timer_wakeup
+	    && (err = snd_pcm_sw_params_set_tstamp_mode (
+		     handle, sw_params, SND_PCM_TSTAMP_ENABLE)) < 0) {
+		jack_error ("ALSA: cannot enable timestamps for %s",
+			    stream_name);
+		return -1;
+	}
+
 #if 0
 	jack_info ("set silence size to %lu * %lu = %lu",
 		 driver->frames_per_cycle, *nperiodsp,
@@ -824,6 +868,9 @@ alsa_driver_set_parameters (alsa_driver_t *driver,
 		driver->dither_state = (dither_state_t *)
 			calloc ( driver->playback_nchannels,
 				 sizeof (dither_state_t));
+		driver->playback_bufs = (jack_default_audio_sample_t **)
+			calloc (driver->playback_nchannels,
+				sizeof (jack_default_audio_sample_t *));
 	}
 
 	if (driver->capture_handle) {
@@ -835,6 +882,9 @@ alsa_driver_set_parameters (alsa_driver_t *driver,
 			malloc (sizeof (unsigned long *) * driver->capture_nchannels);
 		memset (driver->capture_interleave_skip, 0,
 			sizeof (unsigned long *) * driver->capture_nchannels);
+		driver->capture_bufs = (jack_default_audio_sample_t **)
+			calloc (driver->capture_nchannels,
+				sizeof (jack_default_audio_sample_t *));
 	}
 
 	driver->clock_sync_data = (ClockSyncStatus *)
@@ -926,6 +976,7 @@ alsa_driver_start (alsa_driver_t *driver)
 	int err;
 	snd_pcm_uframes_t poffset, pavail;
 	channel_t chn;
+	JSList *node;
 
 	driver->poll_last = 0;
 	driver->poll_next = 0;
@@ -1041,6 +1092,18 @@ alsa_driver_start (alsa_driver_t *driver)
 			return -1;
 		}
 	}
+
+	/* aggregates run on their own clocks, an xrun here is no reason
+	   to restart them */
+	if (!driver->xrun_recovery) {
+		for (node = driver->aggregates; node;
+		     node = jack_slist_next (node)) {
+			if (alsa_aggregate_start (
+				    (alsa_aggregate_t *) node->data)) {
+				return -1;
+			}
+		}
+	}
 			
 	return 0;
 }
@@ -1095,6 +1158,13 @@ alsa_driver_stop (alsa_driver_t *driver)
 	if (driver->midi && !driver->xrun_recovery)
 		(driver->midi->stop)(driver->midi);
 
+	if (!driver->xrun_recovery) {
+		for (node = driver->aggregates; node;
+		     node = jack_slist_next (node)) {
+			alsa_aggregate_stop ((alsa_aggregate_t *) node->data);
+		}
+	}
+
 	return 0;
 }
 
@@ -1198,6 +1268,118 @@ alsa_driver_set_clock_sync_status (alsa_driver_t *driver, channel_t chn,
 
 static int under_gdb = FALSE;
 
+/* Timer driven wakeup: instead of sleeping in poll() until the period
+   interrupt, ask each stream where the hardware is and sleep until the
+   time that position says a period will be ready. The sleep is
+   measured from the stream's timestamp of that position, so it stays
+   aligned with the hardware however late we asked. Returns the wait
+   status, as alsa_driver_wait() reports it.
+*/
+static int
+alsa_driver_timer_wait (alsa_driver_t *driver, int *xrun_detected)
+{
+	snd_pcm_status_t *status;
+	snd_pcm_t *handle[2];
+	snd_pcm_uframes_t needed[2];
+	snd_pcm_uframes_t avail;
+	snd_pcm_uframes_t missing;
+	snd_pcm_state_t state;
+	snd_htimestamp_t ts;
+	struct timespec now;
+	struct timespec wake;
+	jack_time_t start;
+	int64_t age;
+	int nstreams = 0;
+	int i;
+	int err;
+
+	snd_pcm_status_alloca (&status);
+
+	/* the same thresholds that avail_min sets for poll() */
+	if (driver->playback_handle) {
+		handle[nstreams] = driver->playback_handle;
+		needed[nstreams++] = driver->frames_per_cycle
+			* (driver->playback_nperiods - driver->user_nperiods + 1);
+	}
+	if (driver->capture_handle) {
+		handle[nstreams] = driver->capture_handle;
+		needed[nstreams++] = driver->frames_per_cycle;
+	}
+
+	start = driver->engine->get_microseconds ();
+
+	while (1) {
+
+		missing = 0;
+		clock_gettime (CLOCK_MONOTONIC, &now);
+		wake = now;
+
+		for (i = 0; i < nstreams; i++) {
+
+			if ((err = snd_pcm_status (handle[i], status)) < 0) {
+				jack_error ("ALSA: cannot get stream status (%s)",
+					    snd_strerror (err));
+				return -3;
+			}
+
+			state = snd_pcm_status_get_state (status);
+			if (state == SND_PCM_STATE_XRUN
+			    || state == SND_PCM_STATE_SUSPENDED) {
+				*xrun_detected = TRUE;
+				return 0;
+			}
+
+			avail = snd_pcm_status_get_avail (status);
+			if (avail >= needed[i] || needed[i] - avail <= missing) {
+				continue;
+			}
+			missing = needed[i] - avail;
+
+			/* use the timestamp only if it is a recent one in
+			   CLOCK_MONOTONIC, which depends on the kernel */
+			snd_pcm_status_get_htstamp (status, &ts);
+			age = (int64_t) (now.tv_sec - ts.tv_sec) * 1000000000LL
+				+ (now.tv_nsec - ts.tv_nsec);
+			if (age >= 0 && age < (int64_t) driver->period_usecs * 1000) {
+				wake = ts;
+			} else {
+				wake = now;
+			}
+		}
+
+		if (missing == 0) {
+			return 0;
+		}
+
+		if (driver->engine->get_microseconds () - start
+		    > (jack_time_t) driver->poll_timeout * 1000) {
+			jack_error ("ALSA: timer wakeup timed out, %lu frames"
+				    " still missing", (unsigned long) missing);
+			return -5;
+		}
+
+		wake.tv_nsec += (long) ((missing * 1000000000ULL)
+					/ driver->frame_rate);
+		while (wake.tv_nsec >= 1000000000L) {
+			wake.tv_nsec -= 1000000000L;
+			wake.tv_sec++;
+		}
+
+		err = clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &wake, NULL);
+		if (err == EINTR) {
+			jack_info ("timer wait interrupt");
+			if (!under_gdb) {
+				return -2;
+			}
+		} else if (err) {
+			jack_error ("ALSA: timer wait failed (%s)",
+				    strerror (err));
+			return -3;
+		}
+	}
+}
+
 static jack_nframes_t 
 alsa_driver_wait (alsa_driver_t *driver, int extra_fd, int *status, float
 		  *delayed_usecs)
@@ -1223,6 +1405,35 @@ alsa_driver_wait (alsa_driver_t *driver, int extra_fd, int *status, float
 		need_playback = driver->playback_handle ? 1 : 0;
 	}
 
+	if (driver->timer_wakeup && extra_fd < 0) {
+
+		need_playback = 0;
+		need_capture = 0;
+
+		poll_enter = driver->engine->get_microseconds ();
+
+		if (poll_enter > driver->poll_next) {
+			/* late already, see below */
+			driver->poll_next = 0;
+			driver->poll_late++;
+		}
+
+		if ((*status = alsa_driver_timer_wait (driver,
+						       &xrun_detected)) < 0) {
+			return 0;
+		}
+
+		poll_ret = driver->engine->get_microseconds ();
+
+		if (driver->poll_next && poll_ret > driver->poll_next) {
+			*delayed_usecs = poll_ret - driver->poll_next;
+		}
+		driver->poll_last = poll_ret;
+		driver->poll_next = poll_ret + driver->period_usecs;
+		driver->engine->transport_cycle_start (driver->engine,
+						       poll_ret);
+	}
+
   again:
 	
 	while (need_playback || need_capture) {
@@ -1507,9 +1718,100 @@ alsa_driver_null_cycle (alsa_driver_t* driver, jack_nframes_t nframes)
 static int
 alsa_driver_bufsize (alsa_driver_t* driver, jack_nframes_t nframes)
 {
-	return alsa_driver_reset_parameters (driver, nframes,
-					     driver->user_nperiods,
-					     driver->frame_rate);
+	JSList *node;
+
+	if (alsa_driver_reset_parameters (driver, nframes,
+					  driver->user_nperiods,
+					  driver->frame_rate)) {
+		return -1;
+	}
+
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		if (alsa_aggregate_configure ((alsa_aggregate_t *) node->data,
+					      driver->frame_rate, nframes)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Interleaved devices are converted a block of frames at a time, all
+   channels of one block before the next, so that each part of the mmap
+   area is brought into the cache once rather than once per channel.
+   The block is sized to stay in the L1 cache.
+*/
+
+#define ALSA_INTERLEAVE_BLOCK_BYTES 16384
+#define ALSA_INTERLEAVE_MIN_FRAMES  16
+
+static inline jack_nframes_t
+alsa_driver_interleave_block (unsigned long frame_bytes)
+{
+	jack_nframes_t frames = ALSA_INTERLEAVE_BLOCK_BYTES / frame_bytes;
+
+	return frames < ALSA_INTERLEAVE_MIN_FRAMES ?
+		ALSA_INTERLEAVE_MIN_FRAMES : frames;
+}
+
+static void
+alsa_driver_read_interleaved (alsa_driver_t *driver, jack_nframes_t nframes)
+{
+	jack_nframes_t block, done, n;
+	unsigned long skip;
+	channel_t chn;
+
+	if (driver->capture_nchannels == 0) {
+		return;
+	}
+
+	skip = driver->capture_interleave_skip[0];
+	block = alsa_driver_interleave_block (skip);
+
+	for (done = 0; done < nframes; done += n) {
+		n = (nframes - done < block) ? nframes - done : block;
+		for (chn = 0; chn < driver->capture_nchannels; chn++) {
+			if (driver->capture_bufs[chn] == NULL) {
+				continue;
+			}
+			driver->read_via_copy (driver->capture_bufs[chn] + done,
+					       driver->capture_addr[chn] + done * skip,
+					       n, skip);
+		}
+	}
+}
+
+static void
+alsa_driver_write_interleaved (alsa_driver_t *driver, jack_nframes_t nframes)
+{
+	jack_nframes_t block, done, n;
+	unsigned long skip;
+	channel_t chn;
+
+	if (driver->playback_nchannels == 0) {
+		return;
+	}
+
+	skip = driver->playback_interleave_skip[0];
+	block = alsa_driver_interleave_block (skip);
+
+	for (done = 0; done < nframes; done += n) {
+		n = (nframes - done < block) ? nframes - done : block;
+		for (chn = 0; chn < driver->playback_nchannels; chn++) {
+			if (driver->playback_bufs[chn] == NULL) {
+				continue;
+			}
+			driver->write_via_copy (driver->playback_addr[chn] + done * skip,
+						driver->playback_bufs[chn] + done,
+						n, skip, driver->dither_state + chn);
+		}
+	}
+
+	for (chn = 0; chn < driver->playback_nchannels; chn++) {
+		if (driver->playback_bufs[chn]) {
+			alsa_driver_mark_channel_done (driver, chn);
+		}
+	}
 }
 
 static int
@@ -1535,6 +1837,10 @@ alsa_driver_read (alsa_driver_t *driver, jack_nframes_t nframes)
 
 	if (driver->midi)
 		(driver->midi->read)(driver->midi, nframes);
+
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		alsa_aggregate_read ((alsa_aggregate_t *) node->data, nframes);
+	}
 	
 	if (!driver->capture_handle) {
 		return 0;
@@ -1556,6 +1862,12 @@ alsa_driver_read (alsa_driver_t *driver, jack_nframes_t nframes)
 			return -1;
 		}
 			
+		if (driver->capture_interleaved) {
+			memset (driver->capture_bufs, 0,
+				sizeof (jack_default_audio_sample_t *)
+				* driver->capture_nchannels);
+		}
+
 		for (chn = 0, node = driver->capture_ports; node;
 		     node = jack_slist_next (node), chn++) {
 			
@@ -1566,8 +1878,16 @@ alsa_driver_read (alsa_driver_t *driver, jack_nframes_t nframes)
 				continue;
 			}
 			buf = jack_port_get_buffer (port, orig_nframes);
-			alsa_driver_read_from_channel (driver, chn,
-				buf + nread, contiguous);
+			if (driver->capture_interleaved) {
+				driver->capture_bufs[chn] = buf + nread;
+			} else {
+				alsa_driver_read_from_channel (driver, chn,
+					buf + nread, contiguous);
+			}
+		}
+
+		if (driver->capture_interleaved) {
+			alsa_driver_read_interleaved (driver, contiguous);
 		}
 		
 		if ((err = snd_pcm_mmap_commit (driver->capture_handle,
@@ -1610,6 +1930,10 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 
 	if (driver->midi)
 		(driver->midi->write)(driver->midi, nframes);
+
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		alsa_aggregate_write ((alsa_aggregate_t *) node->data, nframes);
+	}
 	
 	nwritten = 0;
 	contiguous = 0;
@@ -1647,6 +1971,12 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 			return -1;
 		}
 		
+		if (driver->playback_interleaved) {
+			memset (driver->playback_bufs, 0,
+				sizeof (jack_default_audio_sample_t *)
+				* driver->playback_nchannels);
+		}
+
 		for (chn = 0, node = driver->playback_ports, mon_node=driver->monitor_ports;
 		     node;
 		     node = jack_slist_next (node), chn++) {
@@ -1657,8 +1987,12 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 				continue;
 			}
 			buf = jack_port_get_buffer (port, orig_nframes);
-			alsa_driver_write_to_channel (driver, chn,
-				buf + nwritten, contiguous);
+			if (driver->playback_interleaved) {
+				driver->playback_bufs[chn] = buf + nwritten;
+			} else {
+				alsa_driver_write_to_channel (driver, chn,
+					buf + nwritten, contiguous);
+			}
 
 			if (mon_node) {
 				port = (jack_port_t *) mon_node->data;
@@ -1671,6 +2005,9 @@ alsa_driver_write (alsa_driver_t* driver, jack_nframes_t nframes)
 			}
 		}
 
+		if (driver->playback_interleaved) {
+			alsa_driver_write_interleaved (driver, contiguous);
+		}
 		
 		if (!bitset_empty (driver->channels_not_done)) {
 			alsa_driver_silence_untouched_channels (driver,
@@ -1729,6 +2066,8 @@ alsa_driver_attach (alsa_driver_t *driver)
 	jack_port_t *port;
 	int port_flags;
 	jack_latency_range_t range;
+	unsigned long capture_index, playback_index;
+	JSList *node;
 
 	if (driver->engine->set_buffer_size (driver->engine, driver->frames_per_cycle)) {
 		jack_error ("ALSA: cannot set engine buffer size for %d (check MIDI)", driver->frames_per_cycle);
@@ -1801,6 +2140,15 @@ alsa_driver_attach (alsa_driver_t *driver)
 		}
 	}
 
+	/* the ports of aggregates are numbered on from the device's */
+	capture_index = driver->capture_nchannels;
+	playback_index = driver->playback_nchannels;
+
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		alsa_aggregate_attach ((alsa_aggregate_t *) node->data,
+				       &capture_index, &playback_index);
+	}
+
 	if (driver->midi) {
 		int err = (driver->midi->attach)(driver->midi);
 		if (err)
@@ -1822,6 +2170,10 @@ alsa_driver_detach (alsa_driver_t *driver)
 
 	if (driver->midi)
 		(driver->midi->detach)(driver->midi);
+
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		alsa_aggregate_detach ((alsa_aggregate_t *) node->data);
+	}
 	
 	for (node = driver->capture_ports; node;
 	     node = jack_slist_next (node)) {
@@ -1912,6 +2264,11 @@ alsa_driver_delete (alsa_driver_t *driver)
 	if (driver->midi)
 		(driver->midi->destroy)(driver->midi);
 
+	for (node = driver->aggregates; node; node = jack_slist_next (node)) {
+		alsa_aggregate_delete ((alsa_aggregate_t *) node->data);
+	}
+	jack_slist_free (driver->aggregates);
+
 	for (node = driver->clock_sync_listeners; node;
 	     node = jack_slist_next (node)) {
 		free (node->data);
@@ -2072,6 +2429,41 @@ discover_alsa_using_apps ()
 }
         
 
+/* Opens each of a whitespace separated list of ALSA devices as an
+   aggregate of this one, in whichever directions this one runs.
+*/
+static int
+alsa_driver_add_aggregates (alsa_driver_t *driver, const char *devices)
+{
+	alsa_aggregate_t *agg;
+	char *list, *name, *state;
+
+	list = strdup (devices);
+
+	for (name = strtok_r (list, " \t", &state); name;
+	     name = strtok_r (NULL, " \t", &state)) {
+
+		if ((agg = alsa_aggregate_new (name, driver->client,
+					       driver->capture_handle != 0,
+					       driver->playback_handle != 0))
+		    == NULL) {
+			free (list);
+			return -1;
+		}
+
+		driver->aggregates = jack_slist_append (driver->aggregates, agg);
+
+		if (alsa_aggregate_configure (agg, driver->frame_rate,
+					      driver->frames_per_cycle)) {
+			free (list);
+			return -1;
+		}
+	}
+
+	free (list);
+	return 0;
+}
+
 static jack_driver_t *
 alsa_driver_new (char *name, char *playback_alsa_device,
 		 char *capture_alsa_device,
@@ -2091,10 +2483,13 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 		 int shorts_first,
 		 jack_nframes_t capture_latency,
 		 jack_nframes_t playback_latency,
-		 alsa_midi_t *midi_driver
+		 alsa_midi_t *midi_driver,
+		 int timer_wakeup,
+		 char *aggregate_devices
 		 )
 {
 	int err;
+	int open_mode = SND_PCM_NONBLOCK;
         char* current_apps;
 	alsa_driver_t *driver;
 
@@ -2142,6 +2537,8 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 	driver->capture_addr = 0;
 	driver->playback_interleave_skip = NULL;
 	driver->capture_interleave_skip = NULL;
+	driver->playback_bufs = NULL;
+	driver->capture_bufs = NULL;
 
 
 	driver->silent = 0;
@@ -2163,6 +2560,14 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 	driver->soft_mode = soft_mode;
 
 	driver->quirk_bswap = 0;
+	driver->timer_wakeup = timer_wakeup;
+
+#if SND_LIB_VERSION >= 0x010017
+	/* required for disabling period interrupts in hw_params */
+	if (timer_wakeup) {
+		open_mode |= SND_PCM_NO_PERIOD_WAKEUP;
+	}
+#endif
 
 	pthread_mutex_init (&driver->clock_sync_lock, 0);
 	driver->clock_sync_listeners = 0;
@@ -2176,6 +2581,7 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 
 	driver->midi = midi_driver;
 	driver->xrun_recovery = 0;
+	driver->aggregates = 0;
 
 	if (alsa_driver_check_card_type (driver)) {
 		alsa_driver_delete (driver);
@@ -2188,7 +2594,7 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 		if (snd_pcm_open (&driver->playback_handle,
 				  playback_alsa_device,
 				  SND_PCM_STREAM_PLAYBACK,
-				  SND_PCM_NONBLOCK) < 0) {
+				  open_mode) < 0) {
 			switch (errno) {
 			case EBUSY:
                                 current_apps = discover_alsa_using_apps ();
@@ -2233,7 +2639,7 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 		if (snd_pcm_open (&driver->capture_handle,
 				  capture_alsa_device,
 				  SND_PCM_STREAM_CAPTURE,
-				  SND_PCM_NONBLOCK) < 0) {
+				  open_mode) < 0) {
 			switch (errno) {
 			case EBUSY:
                                 current_apps = discover_alsa_using_apps ();
@@ -2370,6 +2776,12 @@ alsa_driver_new (char *name, char *playback_alsa_device,
 
 	driver->client = client;
 
+	if (aggregate_devices
+	    && alsa_driver_add_aggregates (driver, aggregate_devices)) {
+		alsa_driver_delete (driver);
+		return NULL;
+	}
+
 	return (jack_driver_t *) driver;
 }
 
@@ -2475,7 +2887,7 @@ driver_get_descriptor ()
 	desc = calloc (1, sizeof (jack_driver_desc_t));
 
 	strcpy (desc->name,"alsa");
-	desc->nparams = 18;
+	desc->nparams = 20;
   
 	params = calloc (desc->nparams, sizeof (jack_driver_param_desc_t));
 
@@ -2638,6 +3050,29 @@ driver_get_descriptor ()
 		" seq - ALSA Sequencer driver\n"
 		" raw - ALSA RawMIDI driver\n");
 
+	i++;
+	strcpy (params[i].name, "timer");
+	params[i].character  = 'T';
+	params[i].type       = JackDriverParamBool;
+	params[i].value.i    = 0;
+	strcpy (params[i].short_desc, "Wake up by timer instead of interrupt");
+	strcpy (params[i].long_desc,
+		"Wake up from a timer set from the hardware position and\n"
+		"its timestamp, rather than from the period interrupt,\n"
+		"which is turned off if the device allows it");
+
+	i++;
+	strcpy (params[i].name, "aggregate");
+	params[i].character  = 'A';
+	params[i].type       = JackDriverParamString;
+	strcpy (params[i].value.str, "");
+	strcpy (params[i].short_desc, "Extra ALSA devices to add, resampled");
+	strcpy (params[i].long_desc,
+		"ALSA devices, separated by spaces, whose channels are added\n"
+		"after those of the main device. Each runs on its own clock\n"
+		"and is resampled to follow the main one, at a ratio set from\n"
+		"its hardware pointer");
+
 	desc->params = params;
 
 	return desc;
@@ -2665,6 +3100,8 @@ driver_initialize (jack_client_t *client, const JSList * params)
 	jack_nframes_t systemic_output_latency = 0;
 	char *midi_driver_name = "none";
 	alsa_midi_t *midi = NULL;
+	int timer_wakeup = FALSE;
+	char *aggregate_devices = NULL;
 	const JSList * node;
 	const jack_driver_param_t * param;
 
@@ -2757,6 +3194,14 @@ driver_initialize (jack_client_t *client, const JSList * params)
 			midi_driver_name = strdup (param->value.str);
 			break;
 
+		case 'T':
+			timer_wakeup = param->value.i;
+			break;
+
+		case 'A':
+			aggregate_devices = strdup (param->value.str);
+			break;
+
 		}
 	}
 			
@@ -2781,7 +3226,8 @@ driver_initialize (jack_client_t *client, const JSList * params)
 				user_capture_nchnls, user_playback_nchnls,
 				shorts_first, 
 				systemic_input_latency,
-				systemic_output_latency, midi);
+				systemic_output_latency, midi,
+				timer_wakeup, aggregate_devices);
 }
 
 void
@@ -64,6 +64,8 @@ typedef struct _alsa_driver {
     unsigned long                 interleave_unit;
     unsigned long                *capture_interleave_skip;
     unsigned long                *playback_interleave_skip;
+    jack_default_audio_sample_t **capture_bufs;   /* per channel, NULL if not connected */
+    jack_default_audio_sample_t **playback_bufs;
     channel_t                     max_nchannels;
     channel_t                     user_nchannels;
     channel_t                     playback_nchannels;
@@ -117,6 +119,7 @@ typedef struct _alsa_driver {
     char has_hw_monitoring;
     char has_hw_metering;
     char quirk_bswap;
+    char timer_wakeup;
 
     ReadCopyFunction read_via_copy;
     WriteCopyFunction write_via_copy;
@@ -139,6 +142,8 @@ typedef struct _alsa_driver {
     alsa_midi_t *midi;
     int xrun_recovery;
 
+    JSList *aggregates;
+
 } alsa_driver_t;
 
 static inline void 
@@ -163,17 +163,503 @@
  * less random than rand(), but good enough and 10x faster 
  */
 
+#define FAST_RAND_A 96314165U
+#define FAST_RAND_C 907633515U
+#define FAST_RAND_SEED 22222
+
+static unsigned int fast_rand_seed = FAST_RAND_SEED;
+
 static inline unsigned int fast_rand() {
-	static unsigned int seed = 22222;
-	seed = (seed * 96314165) + 907633515;
+	fast_rand_seed = (fast_rand_seed * FAST_RAND_A) + FAST_RAND_C;
+
+	return fast_rand_seed;
+}
+
+/* CONVERSION KERNELS
+
+   The integer conversions below do their arithmetic -- clipping,
+   scaling, rounding and dither noise -- a block of MEMOPS_BLOCK samples
+   at a time, using one of the kernel sets here, chosen for the CPU at
+   run time. What is left per sample is storing or loading the integer
+   in the device format, at whatever stride the device uses.
+
+   The vector kernels give bit-identical results to the generic ones:
+   they clip to the same limits before scaling instead of branching,
+   round with the current rounding mode just like lrintf(), keep the
+   same order of float operations for the dither, and step the noise
+   generator through the same sequence, several values at a time.
+*/
 
-	return seed;
+#define MEMOPS_BLOCK 256
+
+typedef struct {
+	const char *name;
+	int (*usable) (void);
+	/* dst = round (clip (src, -1, 1) * scale) */
+	void (*f2i) (int32_t *dst, const float *src, unsigned long n, float scale);
+	/* dst = src / scale */
+	void (*i2f) (float *dst, const int32_t *src, unsigned long n, float scale);
+	/* the next n values of fast_rand() */
+	void (*rand) (uint32_t *dst, unsigned long n);
+	/* 16 bit with rectangular dither, one random value per sample */
+	void (*f2i_rect16) (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n);
+	/* 16 bit with triangular dither, two random values per sample */
+	void (*f2i_tri16) (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n);
+} memops_kernels_t;
+
+/* fast_rand() stepped n times is seed * lcg_mul[n] + lcg_add[n] */
+static uint32_t lcg_mul[9];
+static uint32_t lcg_add[9];
+
+static inline float
+clip (float s, float min, float max)
+{
+	/* NaN falls through, like it does in the macros above */
+	if (s <= min) {
+		return min;
+	} else if (s >= max) {
+		return max;
+	}
+	return s;
 }
 
+static int
+memops_usable_generic (void)
+{
+	return 1;
+}
+
+static void
+memops_f2i_generic (int32_t *dst, const float *src, unsigned long n, float scale)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = f_round (clip (src[i], NORMALIZED_FLOAT_MIN, NORMALIZED_FLOAT_MAX) * scale);
+	}
+}
+
+static void
+memops_i2f_generic (float *dst, const int32_t *src, unsigned long n, float scale)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = src[i] / scale;
+	}
+}
+
+static void
+memops_rand_generic (uint32_t *dst, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = fast_rand ();
+	}
+}
+
+static void
+memops_f2i_rect16_generic (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n)
+{
+	jack_default_audio_sample_t val;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		val = (src[i] * SAMPLE_16BIT_SCALING) + rnd[i] / (float) UINT_MAX - 0.5f;
+		float_16_scaled (val, dst[i]);
+	}
+}
+
+static void
+memops_f2i_tri16_generic (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n)
+{
+	jack_default_audio_sample_t val;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		val = (src[i] * SAMPLE_16BIT_SCALING) + ((float) rnd[2*i] + (float) rnd[2*i+1]) / (float) UINT_MAX - 1.0f;
+		float_16_scaled (val, dst[i]);
+	}
+}
+
+static const memops_kernels_t memops_generic = {
+	"generic", memops_usable_generic,
+	memops_f2i_generic, memops_i2f_generic, memops_rand_generic,
+	memops_f2i_rect16_generic, memops_f2i_tri16_generic
+};
+
+/* One body for all vector kernels, written against the V_* operations
+   defined for each instruction set just before it is expanded. The
+   tails shorter than a vector go to the generic kernels.
+
+   An unsigned 32 bit value is converted as its two 16 bit halves,
+   which are exact, so the one rounding happens in the final add, as it
+   does for (float) u. Dividing by (float) UINT_MAX, which is 2^32, is
+   exactly a multiplication by 2^-32. Clipping is done as
+   min (hi, max (lo, x)), which hands a NaN through to the conversion
+   like the scalar code does.
+*/
+
+#define V_U2F(x) \
+	V_ADDF (V_MULF (V_I2F (V_SRLI ((x), 16)), V_SET1F (65536.0f)), \
+		V_I2F (V_ANDI ((x), V_SET1I (0xffff))))
+
+#define MEMOPS_KERNELS(sfx, attr)					\
+static void attr							\
+memops_f2i_##sfx (int32_t *dst, const float *src, unsigned long n, float scale) \
+{									\
+	VF lo = V_SET1F (NORMALIZED_FLOAT_MIN);				\
+	VF hi = V_SET1F (NORMALIZED_FLOAT_MAX);				\
+	VF k = V_SET1F (scale);						\
+	unsigned long i;						\
+									\
+	for (i = 0; i + W <= n; i += W) {				\
+		VF s = V_MINF (hi, V_MAXF (lo, V_LOADF (src + i)));	\
+		V_STOREI (dst + i, V_F2I (V_MULF (s, k)));		\
+	}								\
+	memops_f2i_generic (dst + i, src + i, n - i, scale);		\
+}									\
+									\
+static void attr							\
+memops_i2f_##sfx (float *dst, const int32_t *src, unsigned long n, float scale) \
+{									\
+	VF k = V_SET1F (scale);						\
+	unsigned long i;						\
+									\
+	for (i = 0; i + W <= n; i += W) {				\
+		V_STOREF (dst + i, V_DIVF (V_I2F (V_LOADI (src + i)), k)); \
+	}								\
+	memops_i2f_generic (dst + i, src + i, n - i, scale);		\
+}									\
+									\
+static void attr							\
+memops_rand_##sfx (uint32_t *dst, unsigned long n)			\
+{									\
+	unsigned long i = 0;						\
+									\
+	if (n >= 2 * W) {						\
+		VI mul = V_SET1I (lcg_mul[W]);				\
+		VI add = V_SET1I (lcg_add[W]);				\
+		VI s;							\
+									\
+		for (; i < W; i++) {					\
+			dst[i] = fast_rand ();				\
+		}							\
+		s = V_LOADI (dst);					\
+		for (; i + W <= n; i += W) {				\
+			s = V_ADDI (V_MULI (s, mul), add);		\
+			V_STOREI (dst + i, s);				\
+		}							\
+		fast_rand_seed = dst[i - 1];				\
+	}								\
+	memops_rand_generic (dst + i, n - i);				\
+}									\
+									\
+static void attr							\
+memops_f2i_rect16_##sfx (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n) \
+{									\
+	VF lo = V_SET1F (SAMPLE_16BIT_MIN_F);				\
+	VF hi = V_SET1F (SAMPLE_16BIT_MAX_F);				\
+	VF k = V_SET1F (SAMPLE_16BIT_SCALING);				\
+	VF rk = V_SET1F (1.0f / 4294967296.0f);				\
+	VF half = V_SET1F (0.5f);					\
+	unsigned long i;						\
+									\
+	for (i = 0; i + W <= n; i += W) {				\
+		VF r = V_MULF (V_U2F (V_LOADI (rnd + i)), rk);		\
+		VF val = V_SUBF (V_ADDF (V_MULF (V_LOADF (src + i), k), r), half); \
+		V_STOREI (dst + i, V_F2I (V_MINF (hi, V_MAXF (lo, val)))); \
+	}								\
+	memops_f2i_rect16_generic (dst + i, src + i, rnd + i, n - i);	\
+}									\
+									\
+static void attr							\
+memops_f2i_tri16_##sfx (int32_t *dst, const float *src, const uint32_t *rnd, unsigned long n) \
+{									\
+	VF lo = V_SET1F (SAMPLE_16BIT_MIN_F);				\
+	VF hi = V_SET1F (SAMPLE_16BIT_MAX_F);				\
+	VF k = V_SET1F (SAMPLE_16BIT_SCALING);				\
+	VF rk = V_SET1F (1.0f / 4294967296.0f);				\
+	VF one = V_SET1F (1.0f);					\
+	unsigned long i;						\
+									\
+	for (i = 0; i + W <= n; i += W) {				\
+		VF a = V_U2F (V_LOADI (rnd + 2*i));			\
+		VF b = V_U2F (V_LOADI (rnd + 2*i + W));			\
+		VF r = V_MULF (V_PAIRSUM (a, b), rk);			\
+		VF val = V_SUBF (V_ADDF (V_MULF (V_LOADF (src + i), k), r), one); \
+		V_STOREI (dst + i, V_F2I (V_MINF (hi, V_MAXF (lo, val)))); \
+	}								\
+	memops_f2i_tri16_generic (dst + i, src + i, rnd + 2*i, n - i);	\
+}									\
+									\
+static const memops_kernels_t memops_##sfx = {				\
+	#sfx, memops_usable_##sfx,					\
+	memops_f2i_##sfx, memops_i2f_##sfx, memops_rand_##sfx,		\
+	memops_f2i_rect16_##sfx, memops_f2i_tri16_##sfx		\
+};
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+#include <immintrin.h>
+
+static int
+memops_usable_sse2 (void)
+{
+	__builtin_cpu_init ();
+	return __builtin_cpu_supports ("sse2");
+}
+
+static int
+memops_usable_avx2 (void)
+{
+	__builtin_cpu_init ();
+	return __builtin_cpu_supports ("avx2");
+}
+
+/* SSE2 has no 32 bit multiply keeping the low halves */
+static inline __m128i __attribute__((target("sse2")))
+mullo_epi32_sse2 (__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32 (a, b);
+	__m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, 0x08), _mm_shuffle_epi32 (odd, 0x08));
+}
+
+/* { a0+a1, a2+a3, b0+b1, b2+b3 } */
+static inline __m128 __attribute__((target("sse2")))
+pairsum_ps_sse2 (__m128 a, __m128 b)
+{
+	return _mm_add_ps (_mm_shuffle_ps (a, b, 0x88), _mm_shuffle_ps (a, b, 0xdd));
+}
+
+#define W		4
+#define VF		__m128
+#define VI		__m128i
+#define V_SET1F		_mm_set1_ps
+#define V_SET1I(x)	_mm_set1_epi32 ((int) (x))
+#define V_LOADF		_mm_loadu_ps
+#define V_STOREF	_mm_storeu_ps
+#define V_LOADI(p)	_mm_loadu_si128 ((const __m128i *) (p))
+#define V_STOREI(p, x)	_mm_storeu_si128 ((__m128i *) (p), (x))
+#define V_MAXF		_mm_max_ps
+#define V_MINF		_mm_min_ps
+#define V_ADDF		_mm_add_ps
+#define V_SUBF		_mm_sub_ps
+#define V_MULF		_mm_mul_ps
+#define V_DIVF		_mm_div_ps
+#define V_F2I		_mm_cvtps_epi32
+#define V_I2F		_mm_cvtepi32_ps
+#define V_ADDI		_mm_add_epi32
+#define V_MULI		mullo_epi32_sse2
+#define V_ANDI		_mm_and_si128
+#define V_SRLI		_mm_srli_epi32
+#define V_PAIRSUM	pairsum_ps_sse2
+
+MEMOPS_KERNELS(sse2, __attribute__((target("sse2"))))
+
+#undef W
+#undef VF
+#undef VI
+#undef V_SET1F
+#undef V_SET1I
+#undef V_LOADF
+#undef V_STOREF
+#undef V_LOADI
+#undef V_STOREI
+#undef V_MAXF
+#undef V_MINF
+#undef V_ADDF
+#undef V_SUBF
+#undef V_MULF
+#undef V_DIVF
+#undef V_F2I
+#undef V_I2F
+#undef V_ADDI
+#undef V_MULI
+#undef V_ANDI
+#undef V_SRLI
+#undef V_PAIRSUM
+
+/* the 128 bit lanes of the shuffles hold pairs { 0 1 4 5 | 2 3 6 7 } */
+static inline __m256 __attribute__((target("avx2")))
+pairsum_ps_avx2 (__m256 a, __m256 b)
+{
+	__m256 sum = _mm256_add_ps (_mm256_shuffle_ps (a, b, 0x88), _mm256_shuffle_ps (a, b, 0xdd));
+
+	return _mm256_castpd_ps (_mm256_permute4x64_pd (_mm256_castps_pd (sum), 0xd8));
+}
+
+#define W		8
+#define VF		__m256
+#define VI		__m256i
+#define V_SET1F		_mm256_set1_ps
+#define V_SET1I(x)	_mm256_set1_epi32 ((int) (x))
+#define V_LOADF		_mm256_loadu_ps
+#define V_STOREF	_mm256_storeu_ps
+#define V_LOADI(p)	_mm256_loadu_si256 ((const __m256i *) (p))
+#define V_STOREI(p, x)	_mm256_storeu_si256 ((__m256i *) (p), (x))
+#define V_MAXF		_mm256_max_ps
+#define V_MINF		_mm256_min_ps
+#define V_ADDF		_mm256_add_ps
+#define V_SUBF		_mm256_sub_ps
+#define V_MULF		_mm256_mul_ps
+#define V_DIVF		_mm256_div_ps
+#define V_F2I		_mm256_cvtps_epi32
+#define V_I2F		_mm256_cvtepi32_ps
+#define V_ADDI		_mm256_add_epi32
+#define V_MULI		_mm256_mullo_epi32
+#define V_ANDI		_mm256_and_si256
+#define V_SRLI		_mm256_srli_epi32
+#define V_PAIRSUM	pairsum_ps_avx2
+
+MEMOPS_KERNELS(avx2, __attribute__((target("avx2"))))
+
+#undef W
+#undef VF
+#undef VI
+#undef V_SET1F
+#undef V_SET1I
+#undef V_LOADF
+#undef V_STOREF
+#undef V_LOADI
+#undef V_STOREI
+#undef V_MAXF
+#undef V_MINF
+#undef V_ADDF
+#undef V_SUBF
+#undef V_MULF
+#undef V_DIVF
+#undef V_F2I
+#undef V_I2F
+#undef V_ADDI
+#undef V_MULI
+#undef V_ANDI
+#undef V_SRLI
+#undef V_PAIRSUM
+
+static const memops_kernels_t *memops_kernel_sets[] = {
+	&memops_avx2, &memops_sse2, &memops_generic, NULL
+};
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+/* AArch64 only: ARMv7 NEON lacks round-to-nearest conversion and
+   division */
+
+#include <arm_neon.h>
+
+static int
+memops_usable_neon (void)
+{
+	return 1;
+}
+
+#define W		4
+#define VF		float32x4_t
+#define VI		int32x4_t
+#define V_SET1F		vdupq_n_f32
+#define V_SET1I(x)	vdupq_n_s32 ((int32_t) (x))
+#define V_LOADF		vld1q_f32
+#define V_STOREF	vst1q_f32
+#define V_LOADI(p)	vld1q_s32 ((const int32_t *) (p))
+#define V_STOREI(p, x)	vst1q_s32 ((int32_t *) (p), (x))
+#define V_MAXF		vmaxq_f32
+#define V_MINF		vminq_f32
+#define V_ADDF		vaddq_f32
+#define V_SUBF		vsubq_f32
+#define V_MULF		vmulq_f32
+#define V_DIVF		vdivq_f32
+#define V_F2I		vcvtnq_s32_f32
+#define V_I2F		vcvtq_f32_s32
+#define V_ADDI		vaddq_s32
+#define V_MULI		vmulq_s32
+#define V_ANDI		vandq_s32
+#define V_SRLI(x, n)	vreinterpretq_s32_u32 (vshrq_n_u32 (vreinterpretq_u32_s32 (x), (n)))
+#define V_PAIRSUM	vpaddq_f32
+
+MEMOPS_KERNELS(neon, )
+
+static const memops_kernels_t *memops_kernel_sets[] = {
+	&memops_neon, &memops_generic, NULL
+};
+
+#else
+
+static const memops_kernels_t *memops_kernel_sets[] = {
+	&memops_generic, NULL
+};
+
+#endif
+
+static const memops_kernels_t *memops_kernels = NULL;
+
+static const memops_kernels_t *
+memops_select (const char *name)
+{
+	const memops_kernels_t **k;
+	int i;
+
+	if (lcg_mul[0] == 0) {
+		lcg_mul[0] = 1;
+		lcg_add[0] = 0;
+		for (i = 1; i < 9; i++) {
+			lcg_mul[i] = lcg_mul[i-1] * FAST_RAND_A;
+			lcg_add[i] = lcg_add[i-1] * FAST_RAND_A + FAST_RAND_C;
+		}
+	}
+
+	for (k = memops_kernel_sets; *k; k++) {
+		if ((name == NULL || strcmp (name, (*k)->name) == 0) && (*k)->usable ()) {
+			return *k;
+		}
+	}
+	return NULL;
+}
+
+static inline const memops_kernels_t *
+memops_get (void)
+{
+	if (memops_kernels == NULL) {
+		memops_kernels = memops_select (NULL);
+	}
+	return memops_kernels;
+}
+
+int
+memops_use_kernels (const char *name)
+{
+	const memops_kernels_t *k;
+
+	if ((k = memops_select (name)) == NULL) {
+		return -1;
+	}
+	memops_kernels = k;
+	fast_rand_seed = FAST_RAND_SEED;
+	return 0;
+}
+
+const char *
+memops_kernels_name (void)
+{
+	return memops_get ()->name;
+}
 
 /* functions for native float sample data */
 
+/* A non-interleaved float channel in the mmap area is laid out just
+   like a port buffer, so it is moved with a single memcpy. Port
+   buffers live in the shared memory that every client maps, so
+   handing out pointers into the mmap area instead is not possible.
+*/
+
 void sample_move_floatLE_sSs (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip) {
+	if (src_skip == sizeof (float)) {
+		memcpy (dst, src, nsamples * sizeof (float));
+		return;
+	}
 	while (nsamples--) {
 		*dst = *((float *) src);
 		dst++;
@@ -182,6 +668,10 @@ void sample_move_floatLE_sSs (jack_default_audio_sample_t *dst, char *src, unsig
 }
 
 void sample_move_dS_floatLE (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state) {
+	if (dst_skip == sizeof (float)) {
+		memcpy (dst, src, nsamples * sizeof (float));
+		return;
+	}
 	while (nsamples--) {
 		*((float *) dst) = *src;
 		dst += dst_skip;
@@ -214,269 +704,385 @@ void sample_move_dS_floatLE (char *dst, jack_default_audio_sample_t *src, unsign
 
 /* functions for native integer sample data */
 
+#define block_size(n) ((n) < MEMOPS_BLOCK ? (n) : MEMOPS_BLOCK)
+
 void sample_move_d32u24_sSs (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 	int32_t z;
 
-	while (nsamples--) {
-
-		float_24u32 (*src, z);
-
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_24BIT_SCALING);
 
+		for (i = 0; i < n; i++) {
+			z = tmp[i] << 8;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		dst[0]=(char)(z>>24);
-		dst[1]=(char)(z>>16);
-		dst[2]=(char)(z>>8);
-		dst[3]=(char)(z);
+			dst[0]=(char)(z>>24);
+			dst[1]=(char)(z>>16);
+			dst[2]=(char)(z>>8);
+			dst[3]=(char)(z);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		dst[0]=(char)(z);
-		dst[1]=(char)(z>>8);
-		dst[2]=(char)(z>>16);
-		dst[3]=(char)(z>>24);
+			dst[0]=(char)(z);
+			dst[1]=(char)(z>>8);
+			dst[2]=(char)(z>>16);
+			dst[3]=(char)(z>>24);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_d32u24_sS (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	while (nsamples--) {
-		float_24u32 (*src, *((int32_t*) dst));
-		dst += dst_skip;
-		src++;
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_24BIT_SCALING);
+
+		for (i = 0; i < n; i++) {
+			*((int32_t*) dst) = tmp[i] << 8;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_dS_s32u24s (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
 	/* ALERT: signed sign-extension portability !!! */
 
-	while (nsamples--) {
-		int x;
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
+			int x;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		x = (unsigned char)(src[0]);
-		x <<= 8;
-		x |= (unsigned char)(src[1]);
-		x <<= 8;
-		x |= (unsigned char)(src[2]);
-		x <<= 8;
-		x |= (unsigned char)(src[3]);
+			x = (unsigned char)(src[0]);
+			x <<= 8;
+			x |= (unsigned char)(src[1]);
+			x <<= 8;
+			x |= (unsigned char)(src[2]);
+			x <<= 8;
+			x |= (unsigned char)(src[3]);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		x = (unsigned char)(src[3]);
-		x <<= 8;
-		x |= (unsigned char)(src[2]);
-		x <<= 8;
-		x |= (unsigned char)(src[1]);
-		x <<= 8;
-		x |= (unsigned char)(src[0]);
+			x = (unsigned char)(src[3]);
+			x <<= 8;
+			x |= (unsigned char)(src[2]);
+			x <<= 8;
+			x |= (unsigned char)(src[1]);
+			x <<= 8;
+			x |= (unsigned char)(src[0]);
 #endif
-		*dst = (x >> 8) / SAMPLE_24BIT_SCALING;
-		dst++;
-		src += src_skip;
+			tmp[i] = x >> 8;
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_24BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_dS_s32u24 (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
 	/* ALERT: signed sign-extension portability !!! */
 
-	while (nsamples--) {
-		*dst = (*((int *) src) >> 8) / SAMPLE_24BIT_SCALING;
-		dst++;
-		src += src_skip;
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
+			tmp[i] = *((int *) src) >> 8;
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_24BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_d24_sSs (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 	int32_t z;
 
-	while (nsamples--) {
-		float_24 (*src, z);
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_24BIT_SCALING);
+
+		for (i = 0; i < n; i++) {
+			z = tmp[i];
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		dst[0]=(char)(z>>16);
-		dst[1]=(char)(z>>8);
-		dst[2]=(char)(z);
+			dst[0]=(char)(z>>16);
+			dst[1]=(char)(z>>8);
+			dst[2]=(char)(z);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		dst[0]=(char)(z);
-		dst[1]=(char)(z>>8);
-		dst[2]=(char)(z>>16);
+			dst[0]=(char)(z);
+			dst[1]=(char)(z>>8);
+			dst[2]=(char)(z>>16);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_d24_sS (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-        int32_t z;
-	
-	while (nsamples--) {
-		float_24 (*src, z);
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_24BIT_SCALING);
+
+		for (i = 0; i < n; i++) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		memcpy (dst, &z, 3);
+			memcpy (dst, &tmp[i], 3);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		memcpy (dst, (char *)&z + 1, 3);
+			memcpy (dst, (char *)&tmp[i] + 1, 3);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_dS_s24s (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
 	/* ALERT: signed sign-extension portability !!! */
 
-	while (nsamples--) {
-		int x;
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
+			int x;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		x = (unsigned char)(src[0]);
-		x <<= 8;
-		x |= (unsigned char)(src[1]);
-		x <<= 8;
-		x |= (unsigned char)(src[2]);
-		/* correct sign bit and the rest of the top byte */
-		if (src[0] & 0x80) {
-			x |= 0xff << 24;
-		}
+			x = (unsigned char)(src[0]);
+			x <<= 8;
+			x |= (unsigned char)(src[1]);
+			x <<= 8;
+			x |= (unsigned char)(src[2]);
+			/* correct sign bit and the rest of the top byte */
+			if (src[0] & 0x80) {
+				x |= 0xff << 24;
+			}
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		x = (unsigned char)(src[2]);
-		x <<= 8;
-		x |= (unsigned char)(src[1]);
-		x <<= 8;
-		x |= (unsigned char)(src[0]);
-		/* correct sign bit and the rest of the top byte */
-		if (src[2] & 0x80) {
-			x |= 0xff << 24;
-		}
+			x = (unsigned char)(src[2]);
+			x <<= 8;
+			x |= (unsigned char)(src[1]);
+			x <<= 8;
+			x |= (unsigned char)(src[0]);
+			/* correct sign bit and the rest of the top byte */
+			if (src[2] & 0x80) {
+				x |= 0xff << 24;
+			}
 #endif
-		*dst = x / SAMPLE_24BIT_SCALING;
-		dst++;
-		src += src_skip;
+			tmp[i] = x;
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_24BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void sample_move_dS_s24 (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
 	/* ALERT: signed sign-extension portability !!! */
 
-	while (nsamples--) {
-		int x;
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
+			int x;
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		memcpy((char*)&x + 1, src, 3);
+			memcpy((char*)&x + 1, src, 3);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		memcpy(&x, src, 3);
+			memcpy(&x, src, 3);
 #endif
-		x >>= 8;
-		*dst = x / SAMPLE_24BIT_SCALING;
-		dst++;
-		src += src_skip;
+			tmp[i] = x >> 8;
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_24BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
 
 
-void sample_move_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	int16_t tmp;
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 
-	while (nsamples--) {
-		// float_16 (*src, tmp);
-
-		if (*src <= NORMALIZED_FLOAT_MIN) {
-			tmp = SAMPLE_16BIT_MIN;
-		} else if (*src >= NORMALIZED_FLOAT_MAX) {
-			tmp = SAMPLE_16BIT_MAX;
-		} else {
-			tmp = (int16_t) f_round (*src * SAMPLE_16BIT_SCALING);
-		}
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_16BIT_SCALING);
 
+		for (i = 0; i < n; i++) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		dst[0]=(char)(tmp>>8);
-		dst[1]=(char)(tmp);
+			dst[0]=(char)(tmp[i]>>8);
+			dst[1]=(char)(tmp[i]);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		dst[0]=(char)(tmp);
-		dst[1]=(char)(tmp>>8);
+			dst[0]=(char)(tmp[i]);
+			dst[1]=(char)(tmp[i]>>8);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
-void sample_move_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	while (nsamples--) {
-		float_16 (*src, *((int16_t*) dst));
-		dst += dst_skip;
-		src++;
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->f2i (tmp, src, n, SAMPLE_16BIT_SCALING);
+
+		for (i = 0; i < n; i++) {
+			*((int16_t*) dst) = tmp[i];
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
-void sample_move_dither_rect_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_dither_rect_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	jack_default_audio_sample_t val;
-	int16_t      tmp;
+	const memops_kernels_t *k = memops_get ();
+	uint32_t rnd[MEMOPS_BLOCK];
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 
-	while (nsamples--) {
-		val = (*src * SAMPLE_16BIT_SCALING) + fast_rand() / (float) UINT_MAX - 0.5f;
-		float_16_scaled (val, tmp);
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->rand (rnd, n);
+		k->f2i_rect16 (tmp, src, rnd, n);
+
+		for (i = 0; i < n; i++) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		dst[0]=(char)(tmp>>8);
-		dst[1]=(char)(tmp);
+			dst[0]=(char)(tmp[i]>>8);
+			dst[1]=(char)(tmp[i]);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		dst[0]=(char)(tmp);
-		dst[1]=(char)(tmp>>8);
+			dst[0]=(char)(tmp[i]);
+			dst[1]=(char)(tmp[i]>>8);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
-void sample_move_dither_rect_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_dither_rect_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	jack_default_audio_sample_t val;
-
-	while (nsamples--) {
-		val = (*src * SAMPLE_16BIT_SCALING) + fast_rand() / (float)UINT_MAX - 0.5f;
-		float_16_scaled (val, *((int16_t*) dst));
-		dst += dst_skip;
-		src++;
+	const memops_kernels_t *k = memops_get ();
+	uint32_t rnd[MEMOPS_BLOCK];
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->rand (rnd, n);
+		k->f2i_rect16 (tmp, src, rnd, n);
+
+		for (i = 0; i < n; i++) {
+			*((int16_t*) dst) = tmp[i];
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
-void sample_move_dither_tri_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_dither_tri_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	jack_default_audio_sample_t val;
-	int16_t      tmp;
+	const memops_kernels_t *k = memops_get ();
+	uint32_t rnd[2 * MEMOPS_BLOCK];
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 
-	while (nsamples--) {
-		val = (*src * SAMPLE_16BIT_SCALING) + ((float)fast_rand() + (float)fast_rand()) / (float)UINT_MAX - 1.0f;
-		float_16_scaled (val, tmp);
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->rand (rnd, 2 * n);
+		k->f2i_tri16 (tmp, src, rnd, n);
 
+		for (i = 0; i < n; i++) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		dst[0]=(char)(tmp>>8);
-		dst[1]=(char)(tmp);
+			dst[0]=(char)(tmp[i]>>8);
+			dst[1]=(char)(tmp[i]);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		dst[0]=(char)(tmp);
-		dst[1]=(char)(tmp>>8);
+			dst[0]=(char)(tmp[i]);
+			dst[1]=(char)(tmp[i]>>8);
 #endif
-		dst += dst_skip;
-		src++;
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
-void sample_move_dither_tri_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
+void sample_move_dither_tri_d16_sS (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)
 {
-	jack_default_audio_sample_t val;
-
-	while (nsamples--) {
-		val = (*src * SAMPLE_16BIT_SCALING) + ((float)fast_rand() + (float)fast_rand()) / (float)UINT_MAX - 1.0f;
-		float_16_scaled (val, *((int16_t*) dst));
-		dst += dst_skip;
-		src++;
+	const memops_kernels_t *k = memops_get ();
+	uint32_t rnd[2 * MEMOPS_BLOCK];
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
+	while (nsamples) {
+		n = block_size (nsamples);
+		k->rand (rnd, 2 * n);
+		k->f2i_tri16 (tmp, src, rnd, n);
+
+		for (i = 0; i < n; i++) {
+			*((int16_t*) dst) = tmp[i];
+			dst += dst_skip;
+		}
+		src += n;
+		nsamples -= n;
 	}
 }
 
+/* The noise shaping filter feeds each sample's error into the next one,
+   so these stay scalar; making the noise in line costs nothing next to
+   the filter's dependency chain. */
+
 void sample_move_dither_shaped_d16_sSs (char *dst,  jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state)	
 {
 	jack_default_audio_sample_t     x;
@@ -557,37 +1163,56 @@ void sample_move_dither_shaped_d16_sS (char *dst,  jack_default_audio_sample_t *
 	state->idx = idx;
 }
 
-void sample_move_dS_s16s (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip) 	
+void sample_move_dS_s16s (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
 	short z;
 
 	/* ALERT: signed sign-extension portability !!! */
-	while (nsamples--) {
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-		z = (unsigned char)(src[0]);
-		z <<= 8;
-		z |= (unsigned char)(src[1]);
+			z = (unsigned char)(src[0]);
+			z <<= 8;
+			z |= (unsigned char)(src[1]);
 #elif __BYTE_ORDER == __BIG_ENDIAN
-		z = (unsigned char)(src[1]);
-		z <<= 8;
-		z |= (unsigned char)(src[0]);
+			z = (unsigned char)(src[1]);
+			z <<= 8;
+			z |= (unsigned char)(src[0]);
 #endif
-		*dst = z / SAMPLE_16BIT_SCALING;
-		dst++;
-		src += src_skip;
+			tmp[i] = z;
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_16BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
+
+void sample_move_dS_s16 (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip)
 
-void sample_move_dS_s16 (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip) 
-	
 {
+	const memops_kernels_t *k = memops_get ();
+	int32_t tmp[MEMOPS_BLOCK];
+	unsigned long i, n;
+
 	/* ALERT: signed sign-extension portability !!! */
-	while (nsamples--) {
-		*dst = (*((short *) src)) / SAMPLE_16BIT_SCALING;
-		dst++;
-		src += src_skip;
+	while (nsamples) {
+		n = block_size (nsamples);
+
+		for (i = 0; i < n; i++) {
+			tmp[i] = *((short *) src);
+			src += src_skip;
+		}
+		k->i2f (dst, tmp, n, SAMPLE_16BIT_SCALING);
+		dst += n;
+		nsamples -= n;
 	}
-}	
+}
 
 void memset_interleave (char *dst, char val, unsigned long bytes, 
 			unsigned long unit_bytes, 
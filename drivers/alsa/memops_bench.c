@@ -0,0 +1,432 @@
+/*
+    Benchmark and conformance check for the memops conversions.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+/* memops_bench: times the sample format conversions and copies of
+   memops.c for each kernel set the CPU can run, over a range of buffer
+   sizes and interleave strides, and checks that every kernel set gives
+   the same output, bit for bit, as the generic one. Exits non-zero if
+   one does not.
+
+   With -i it instead times one period of an interleaved device the way
+   alsa_driver.c converts it: every channel over the whole period, then
+   all channels a block of frames at a time.
+
+   It is built along with the drivers but not installed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <jack/memops.h>
+
+#define MAX_SAMPLES  4096
+#define MAX_CHANNELS 128
+#define MAX_BYTES    4
+
+typedef void (*to_device_t) (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state);
+typedef void (*from_device_t) (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long src_skip);
+typedef void (*copy_t) (char *dst, char *src, unsigned long src_bytes, unsigned long dst_skip_bytes, unsigned long src_skip_bytes);
+
+typedef struct {
+	const char    *name;
+	unsigned int   bytes;	/* per sample in the device format */
+	to_device_t    to_device;
+	from_device_t  from_device;
+	copy_t         copy;
+} conversion_t;
+
+#define TO(f, b)   { #f, b, f, NULL, NULL }
+#define FROM(f, b) { #f, b, NULL, f, NULL }
+#define COPY(f, b) { #f, b, NULL, NULL, f }
+
+static const conversion_t conversions[] = {
+	TO (sample_move_dS_floatLE, 4),
+	TO (sample_move_d32u24_sSs, 4),
+	TO (sample_move_d32u24_sS, 4),
+	TO (sample_move_d24_sSs, 3),
+	TO (sample_move_d24_sS, 3),
+	TO (sample_move_d16_sSs, 2),
+	TO (sample_move_d16_sS, 2),
+	TO (sample_move_dither_rect_d16_sSs, 2),
+	TO (sample_move_dither_rect_d16_sS, 2),
+	TO (sample_move_dither_tri_d16_sSs, 2),
+	TO (sample_move_dither_tri_d16_sS, 2),
+	TO (sample_move_dither_shaped_d16_sSs, 2),
+	TO (sample_move_dither_shaped_d16_sS, 2),
+	FROM (sample_move_floatLE_sSs, 4),
+	FROM (sample_move_dS_s32u24s, 4),
+	FROM (sample_move_dS_s32u24, 4),
+	FROM (sample_move_dS_s24s, 3),
+	FROM (sample_move_dS_s24, 3),
+	FROM (sample_move_dS_s16s, 2),
+	FROM (sample_move_dS_s16, 2),
+	COPY (memcpy_interleave_d16_s16, 2),
+	COPY (memcpy_interleave_d24_s24, 3),
+	COPY (memcpy_interleave_d32_s32, 4),
+};
+
+#define NCONVERSIONS (sizeof (conversions) / sizeof (conversions[0]))
+
+static const char *kernel_sets[] = { "generic", "sse2", "avx2", "neon", NULL };
+static const unsigned long sizes[] = { 64, 256, 1024, 4096, 0 };
+static const unsigned long channels[] = { 1, 2, 8, 32, 64, 128, 0 };
+
+#define NSIZES    (sizeof (sizes) / sizeof (sizes[0]))
+#define NCHANNELS (sizeof (channels) / sizeof (channels[0]))
+
+/* as ALSA_INTERLEAVE_BLOCK_BYTES/_MIN_FRAMES in alsa_driver.c */
+#define BLOCK_BYTES  16384
+#define BLOCK_FRAMES 16
+
+/* frames per period for -i */
+#define CYCLE_FRAMES 1024
+
+static jack_default_audio_sample_t floats[MAX_SAMPLES];
+static char device[MAX_SAMPLES * MAX_CHANNELS * MAX_BYTES];
+
+/* the generic output, per conversion/size/stride, for the check */
+static char *golden[NCONVERSIONS][NSIZES][NCHANNELS];
+
+/* the port buffers and mmap area of an interleaved device, for -i */
+static jack_default_audio_sample_t ports[MAX_CHANNELS][CYCLE_FRAMES];
+static char area[CYCLE_FRAMES * MAX_CHANNELS * MAX_BYTES];
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The same input for every run: full scale noise with the edge cases
+   the conversions clip or round specially. */
+static void
+fill_input (void)
+{
+	unsigned int seed = 1;
+	unsigned long i;
+
+	for (i = 0; i < MAX_SAMPLES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		floats[i] = (seed / 4294967296.0f) * 2.2f - 1.1f;
+	}
+	floats[0] = 1.0f;
+	floats[1] = -1.0f;
+	floats[2] = 0.5f / 32767.0f;
+	floats[3] = -0.5f / 8388607.0f;
+	floats[4] = nextafterf (1.0f, 0.0f);
+	floats[5] = 0.0f;
+
+	for (i = 0; i < sizeof (device); i++) {
+		seed = seed * 1664525 + 1013904223;
+		device[i] = seed >> 24;
+	}
+}
+
+/* Runs one conversion once and returns a copy of everything it wrote. */
+static char *
+run_once (const conversion_t *c, unsigned long n, unsigned long skip)
+{
+	static char dst[MAX_SAMPLES * MAX_CHANNELS * MAX_BYTES];
+	static jack_default_audio_sample_t fdst[MAX_SAMPLES];
+	dither_state_t state;
+	char *out;
+	size_t len;
+
+	memset (&state, 0, sizeof (state));
+
+	if (c->to_device) {
+		memset (dst, 0, n * skip);
+		c->to_device (dst, floats, n, skip, &state);
+		len = n * skip;
+		out = malloc (len);
+		memcpy (out, dst, len);
+	} else if (c->from_device) {
+		c->from_device (fdst, device, n, skip);
+		len = n * sizeof (jack_default_audio_sample_t);
+		out = malloc (len);
+		memcpy (out, fdst, len);
+	} else {
+		memset (dst, 0, n * skip);
+		c->copy (dst, device, n * c->bytes, skip, skip);
+		len = n * skip;
+		out = malloc (len);
+		memcpy (out, dst, len);
+	}
+
+	return out;
+}
+
+static size_t
+output_size (const conversion_t *c, unsigned long n, unsigned long skip)
+{
+	return c->from_device ? n * sizeof (jack_default_audio_sample_t) : n * skip;
+}
+
+static double
+time_conversion (const conversion_t *c, unsigned long n, unsigned long skip, unsigned long total)
+{
+	static char dst[MAX_SAMPLES * MAX_CHANNELS * MAX_BYTES];
+	static jack_default_audio_sample_t fdst[MAX_SAMPLES];
+	dither_state_t state;
+	unsigned long i, iterations = total > n ? total / n : 1;
+	double start;
+
+	memset (&state, 0, sizeof (state));
+	start = now ();
+
+	for (i = 0; i < iterations; i++) {
+		if (c->to_device) {
+			c->to_device (dst, floats, n, skip, &state);
+		} else if (c->from_device) {
+			c->from_device (fdst, device, n, skip);
+		} else {
+			c->copy (dst, device, n * c->bytes, skip, skip);
+		}
+	}
+
+	return (now () - start) / (iterations * n);
+}
+
+/* One period of nch interleaved channels, converted per channel over
+   the whole period if !blocked, else all channels of a block of frames
+   before the next block. */
+static void
+run_cycle (const conversion_t *c, unsigned long nch, int blocked, dither_state_t *states)
+{
+	unsigned long skip = nch * c->bytes;
+	unsigned long block = CYCLE_FRAMES;
+	unsigned long done, n, chn;
+
+	if (blocked) {
+		block = BLOCK_BYTES / skip;
+		if (block < BLOCK_FRAMES) {
+			block = BLOCK_FRAMES;
+		}
+	}
+
+	for (done = 0; done < CYCLE_FRAMES; done += n) {
+		n = (CYCLE_FRAMES - done < block) ? CYCLE_FRAMES - done : block;
+		for (chn = 0; chn < nch; chn++) {
+			char *addr = area + chn * c->bytes + done * skip;
+
+			if (c->to_device) {
+				c->to_device (addr, ports[chn] + done, n, skip, states + chn);
+			} else {
+				c->from_device (ports[chn] + done, addr, n, skip);
+			}
+		}
+	}
+}
+
+static double
+time_cycle (const conversion_t *c, unsigned long nch, int blocked, unsigned long total)
+{
+	static dither_state_t states[MAX_CHANNELS];
+	unsigned long i, iterations = total / (CYCLE_FRAMES * nch);
+	double start;
+
+	if (iterations == 0) {
+		iterations = 1;
+	}
+
+	memset (states, 0, sizeof (states));
+	start = now ();
+
+	for (i = 0; i < iterations; i++) {
+		run_cycle (c, nch, blocked, states);
+	}
+
+	return (now () - start) / iterations;
+}
+
+static void
+compare_cycles (const char *only, unsigned long total)
+{
+	const char **set;
+	unsigned int c, ch;
+
+	for (ch = 0; ch < MAX_CHANNELS; ch++) {
+		memcpy (ports[ch], floats, sizeof (ports[ch]));
+	}
+	memcpy (area, device, sizeof (area));
+
+	printf ("%-34s %-8s %4s %12s %12s %7s\n",
+		"conversion", "kernels", "chan", "channel us", "blocked us", "speedup");
+
+	for (set = kernel_sets; *set; set++) {
+
+		if (only && strcmp (only, *set)) {
+			continue;
+		}
+		if (memops_use_kernels (*set)) {
+			continue;
+		}
+
+		for (c = 0; c < NCONVERSIONS; c++) {
+			const conversion_t *conv = &conversions[c];
+
+			if (conv->copy) {
+				continue;
+			}
+
+			for (ch = 0; channels[ch]; ch++) {
+				double per_channel, blocked;
+
+				per_channel = time_cycle (conv, channels[ch], 0, total);
+				blocked = time_cycle (conv, channels[ch], 1, total);
+				printf ("%-34s %-8s %4lu %12.3f %12.3f %7.2f\n",
+					conv->name, *set, channels[ch], per_channel * 1e6,
+					blocked * 1e6, per_channel / blocked);
+			}
+		}
+	}
+}
+
+static void
+usage (void)
+{
+	fprintf (stderr, "usage: memops_bench [ -k kernels ] [ -s samples ] [ -c | -i ]\n");
+	fprintf (stderr, "    -k, --kernels   time only this kernel set (generic, sse2, avx2, neon)\n");
+	fprintf (stderr, "    -s, --samples   samples to convert per measurement (default 4000000)\n");
+	fprintf (stderr, "    -c, --check     only check the kernel sets against generic, no timing\n");
+	fprintf (stderr, "    -i, --interleaved  time a %d frame period of an interleaved device,\n"
+		 "                       per channel against blocked\n", CYCLE_FRAMES);
+}
+
+int
+main (int argc, char *argv[])
+{
+	const char *only = NULL;
+	unsigned long total = 4000000;
+	int check_only = 0;
+	int interleaved = 0;
+	int failures = 0;
+	const char **set;
+	unsigned int c, s, ch;
+	int opt;
+
+	const char *short_options = "k:s:cih";
+	struct option long_options[] = {
+		{ "kernels", 1, 0, 'k' },
+		{ "samples", 1, 0, 's' },
+		{ "check", 0, 0, 'c' },
+		{ "interleaved", 0, 0, 'i' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'k':
+			only = optarg;
+			break;
+		case 's':
+			total = strtoul (optarg, NULL, 10);
+			break;
+		case 'c':
+			check_only = 1;
+			break;
+		case 'i':
+			interleaved = 1;
+			break;
+		default:
+			usage ();
+			return 1;
+		}
+	}
+
+	if (only && memops_use_kernels (only)) {
+		fprintf (stderr, "memops_bench: kernel set \"%s\" is not available\n", only);
+		return 1;
+	}
+
+	fill_input ();
+
+	if (interleaved) {
+		compare_cycles (only, total);
+		return 0;
+	}
+
+	for (c = 0; c < NCONVERSIONS; c++) {
+		for (s = 0; sizes[s]; s++) {
+			for (ch = 0; channels[ch]; ch++) {
+				memops_use_kernels ("generic");
+				golden[c][s][ch] = run_once (&conversions[c], sizes[s],
+							     channels[ch] * conversions[c].bytes);
+			}
+		}
+	}
+
+	if (!check_only) {
+		printf ("%-34s %-8s %7s %4s %10s %8s\n",
+			"conversion", "kernels", "samples", "chan", "ns/sample", "GB/s");
+	}
+
+	for (set = kernel_sets; *set; set++) {
+
+		if (only && strcmp (only, *set)) {
+			continue;
+		}
+		if (memops_use_kernels (*set)) {
+			continue;
+		}
+
+		for (c = 0; c < NCONVERSIONS; c++) {
+			const conversion_t *conv = &conversions[c];
+
+			for (s = 0; sizes[s]; s++) {
+				for (ch = 0; channels[ch]; ch++) {
+					unsigned long skip = channels[ch] * conv->bytes;
+					char *out;
+					double t;
+
+					memops_use_kernels (*set);
+					out = run_once (conv, sizes[s], skip);
+					if (memcmp (out, golden[c][s][ch], output_size (conv, sizes[s], skip))) {
+						printf ("MISMATCH: %s with %s kernels, %lu samples, %lu channels\n",
+							conv->name, *set, sizes[s], channels[ch]);
+						failures++;
+					}
+					free (out);
+
+					if (check_only) {
+						continue;
+					}
+
+					t = time_conversion (conv, sizes[s], skip, total);
+					printf ("%-34s %-8s %7lu %4lu %10.3f %8.3f\n",
+						conv->name, *set, sizes[s], channels[ch], t * 1e9,
+						(sizeof (jack_default_audio_sample_t) + conv->bytes) / t * 1e-9);
+				}
+			}
+		}
+	}
+
+	printf ("%d mismatch%s\n", failures, failures == 1 ? "" : "es");
+
+	return failures ? 1 : 0;
+}
@@ -61,6 +61,8 @@ net_driver_wait (net_driver_t *driver, int extra_fd, int *status, float *delayed
     int delay;
 
     delay = netjack_wait( netj, driver->engine->get_microseconds );
+    driver->buffered_frames = netj->buffered_frames;
+    driver->rate_ratio = netj->rate_ratio;
     if( delay ) {
 	    //driver->engine->delay( driver->engine, (float)delay );
 	    jack_error( "netxruns amount: %dms", delay/1000 );
@@ -274,8 +276,7 @@ net_driver_attach (net_driver_t *driver)
     }
     driver->engine->set_sample_rate (driver->engine, netj->sample_rate);
 
-    netjack_attach( netj );
-    return 0;
+    return netjack_attach( netj );
 }
 
 static int
@@ -318,7 +319,9 @@ net_driver_new (jack_client_t * client,
 		unsigned int redundancy,
 		int dont_htonl_floats,
 		int always_deadline,
-		int jitter_val)
+		int jitter_val,
+		unsigned int opus_frame_size,
+		unsigned int adaptive)
 {
     net_driver_t * driver;
 
@@ -362,7 +365,9 @@ net_driver_new (jack_client_t * client,
 		redundancy,
 		dont_htonl_floats,
 	        always_deadline, 
-		jitter_val	);
+		jitter_val,
+		opus_frame_size,
+		adaptive );
 
     netjack_startup( netj );
 
@@ -387,7 +392,7 @@ driver_get_descriptor ()
 
     desc = calloc (1, sizeof (jack_driver_desc_t));
     strcpy (desc->name, "net");
-    desc->nparams = 18;
+    desc->nparams = 21;
 
     params = calloc (desc->nparams, sizeof (jack_driver_param_desc_t));
 
@@ -484,6 +489,26 @@ driver_get_descriptor ()
             "sets celt encoding and kbits value one channel is encoded at");
     strcpy (params[i].long_desc, params[i].short_desc);
 
+    i++;
+    strcpy (params[i].name, "opus");
+    params[i].character  = 'P';
+    params[i].type       = JackDriverParamUInt;
+    params[i].value.ui   = 0U;
+    strcpy (params[i].short_desc,
+            "sets opus encoding and kbits value one channel is encoded at");
+    strcpy (params[i].long_desc, params[i].short_desc);
+
+    i++;
+    strcpy (params[i].name, "opus-frame-size");
+    params[i].character  = 'F';
+    params[i].type       = JackDriverParamUInt;
+    params[i].value.ui   = 0U;
+    strcpy (params[i].short_desc,
+            "Opus frame size in samples (0 for the period size)");
+    strcpy (params[i].long_desc,
+            "Opus frame size in samples, the period is coded as several frames "
+            "of this size. Must divide the period size (0 for the period size)");
+
     i++;
     strcpy (params[i].name, "bit-depth");
     params[i].character  = 'b';
@@ -545,6 +570,17 @@ driver_get_descriptor ()
     strcpy (params[i].short_desc,
             "Always wait until deadline");
     strcpy (params[i].long_desc, params[i].short_desc);
+
+    i++;
+    strcpy (params[i].name, "adaptive");
+    params[i].character  = 'A';
+    params[i].type       = JackDriverParamUInt;
+    params[i].value.ui   = 0U;
+    strcpy (params[i].short_desc,
+            "Adapt to measured packet jitter and clock drift");
+    strcpy (params[i].long_desc,
+            "Follow the master's clock rate as measured from packet arrival, "
+            "and size the jitter margin from the measured packet jitter");
     desc->params = params;
 
     return desc;
@@ -572,6 +608,8 @@ driver_initialize (jack_client_t *client, const JSList * params)
     int dont_htonl_floats = 0;
     int always_deadline = 0;
     int jitter_val = 0;
+    unsigned int opus_frame_size = 0;
+    unsigned int adaptive = 0;
     const JSList * node;
     const jack_driver_param_t * param;
 
@@ -640,6 +678,20 @@ driver_initialize (jack_client_t *client, const JSList * params)
 #endif
 		break;
 
+	    case 'P':
+#if HAVE_OPUS
+		bitdepth = OPUS_MODE;
+		resample_factor = param->value.ui;
+#else
+		printf( "not built with opus support\n" );
+		exit(10);
+#endif
+		break;
+
+	    case 'F':
+		opus_frame_size = param->value.ui;
+		break;
+
             case 't':
                 handle_transport_sync = param->value.ui;
                 break;
@@ -665,6 +717,9 @@ driver_initialize (jack_client_t *client, const JSList * params)
             case 'D':
                 always_deadline = param->value.ui;
                 break;
+            case 'A':
+                adaptive = param->value.ui;
+                break;
         }
     }
 
@@ -674,7 +729,8 @@ driver_initialize (jack_client_t *client, const JSList * params)
                            listen_port, handle_transport_sync,
                            resample_factor, resample_factor_up, bitdepth,
 			   use_autoconfig, latency, redundancy,
-			   dont_htonl_floats, always_deadline, jitter_val);
+			   dont_htonl_floats, always_deadline, jitter_val,
+			   opus_frame_size, adaptive);
 }
 
 void
@@ -63,6 +63,10 @@ $Id: net_driver.c,v 1.17 2006/04/16 20:16:10 torbenh Exp $
 #include <celt/celt.h>
 #endif
 
+#if HAVE_OPUS
+#include <opus/opus_custom.h>
+#endif
+
 #include "netjack.h"
 #include "netjack_packet.h"
 
@@ -70,6 +74,7 @@ $Id: net_driver.c,v 1.17 2006/04/16 20:16:10 torbenh Exp $
 //#include "jack/control.h"
 
 #define MIN(x,y) ((x)<(y) ? (x) : (y))
+#define MAX(x,y) ((x)>(y) ? (x) : (y))
 
 static int sync_state = 1;
 static jack_transport_state_t last_transport_state;
@@ -88,6 +93,75 @@ net_driver_sync_cb(jack_transport_state_t state, jack_position_t *pos, void *dat
     return retval;
 }
 
+// Adaptive mode.
+//
+// The period of the master, as seen by our clock, is the slope of the
+// arrival times over the framecnts, measured over a long window so
+// that the arrival jitter averages out. The deadline then advances by
+// that instead of by our nominal period, and only the jitter is left
+// to the goodness based adjustments. The jitter itself is estimated
+// like RFC 3550 does, and sizes the margin we ask the master for.
+//
+// As the slave runs one cycle per received packet there is no sample
+// rate difference to resample away, only the timing has to follow.
+
+#define NETJACK_DRIFT_MIN_WINDOW  64
+#define NETJACK_DRIFT_MAX_WINDOW  65536
+
+static void
+netjack_track_arrival( netjack_driver_state_t *netj, jack_nframes_t framecnt, jack_time_t timestamp )
+{
+    float nominal = (float) netj->period_size * 1000000.0f / (float) netj->sample_rate;
+    jack_nframes_t window;
+
+    if( !netj->arrival_valid || (framecnt - netj->last_arrival_framecnt) > (jack_nframes_t) netj->resync_threshold + 1 ) {
+	// first packet, or we lost track. start over.
+	netj->arrival_anchor = timestamp;
+	netj->arrival_anchor_framecnt = framecnt;
+	netj->arrival_valid = 1;
+    } else {
+	float d = (float)(int64_t)(timestamp - netj->last_arrival)
+		- netj->master_period_usecs * (float)(framecnt - netj->last_arrival_framecnt);
+
+	netj->arrival_jitter += (fabsf( d ) - netj->arrival_jitter) / 16.0f;
+
+	window = framecnt - netj->arrival_anchor_framecnt;
+	if( window >= NETJACK_DRIFT_MIN_WINDOW ) {
+	    float period = (float)(timestamp - netj->arrival_anchor) / (float) window;
+
+	    // no sane clock is off by more than a percent.
+	    if( fabsf( period - nominal ) < nominal / 100.0f ) {
+		netj->master_period_usecs = period;
+		netj->rate_ratio = nominal / period;
+	    }
+	}
+	if( window >= NETJACK_DRIFT_MAX_WINDOW ) {
+	    // keep half the window, so the estimate can follow slow changes.
+	    netj->arrival_anchor_framecnt += window / 2;
+	    netj->arrival_anchor += (jack_time_t) (netj->master_period_usecs * (float)(window / 2));
+	}
+    }
+
+    netj->last_arrival = timestamp;
+    netj->last_arrival_framecnt = framecnt;
+}
+
+// how far to move the deadline for the next period.
+static jack_time_t
+netjack_next_period_usecs( netjack_driver_state_t *netj )
+{
+    jack_time_t usecs;
+
+    if( !netj->adaptive )
+	return netj->period_usecs;
+
+    netj->deadline_remainder += netj->master_period_usecs;
+    usecs = (jack_time_t) netj->deadline_remainder;
+    netj->deadline_remainder -= (float) usecs;
+
+    return usecs;
+}
+
 int netjack_wait( netjack_driver_state_t *netj, jack_time_t (*get_microseconds)(void) )
 {
     int we_have_the_expected_frame = 0;
@@ -168,9 +242,15 @@ int netjack_wait( netjack_driver_state_t *netj, jack_time_t (*get_microseconds)(
 	netj->deadline_goodness = (int)pkthdr->sync_state;
 	netj->packet_data_valid = 1;
 
+	if( netj->adaptive )
+		netjack_track_arrival( netj, netj->expected_framecnt, packet_recv_time_stamp );
+
 	int want_deadline;
 	if( netj->jitter_val != 0 )
 		want_deadline = netj->jitter_val;
+	else if( netj->adaptive )
+		want_deadline = MIN( netj->period_usecs/4 + 4*(int)netj->arrival_jitter,
+				     (int)netj->period_usecs*MAX( netj->latency, 1 ) );
 	else if( netj->latency < 4 )
 		want_deadline = -netj->period_usecs/2;
 	else
@@ -191,10 +271,10 @@ int netjack_wait( netjack_driver_state_t *netj, jack_time_t (*get_microseconds)(
 //		netj->deadline_offset = (netj->period_usecs*90/100);
 //	}
 
-	netj->next_deadline += netj->period_usecs;
+	netj->next_deadline += netjack_next_period_usecs( netj );
     } else {
 	netj->time_to_deadline = 0;
-	netj->next_deadline += netj->period_usecs;
+	netj->next_deadline += netjack_next_period_usecs( netj );
 	// bah... the packet is not there.
 	// either
 	// - it got lost.
@@ -310,6 +390,11 @@ int netjack_wait( netjack_driver_state_t *netj, jack_time_t (*get_microseconds)(
 
     int retval = 0;
 
+    // complete packets from the one we are about to play on.
+    if( netj->adaptive )
+	netj->buffered_frames = (jack_nframes_t) lrintf( packet_cache_get_fill( netj->packcache, netj->expected_framecnt )
+							 * netj->packcache->size / 100.0f ) * netj->period_size;
+
     if( !netj->packet_data_valid ) {
 	netj->num_lost_packets += 1;
 	if( netj->num_lost_packets == 1 )
@@ -361,7 +446,7 @@ void netjack_send_silence( netjack_driver_state_t *netj, int syncstate )
 }
 
 
-void netjack_attach( netjack_driver_state_t *netj )
+int netjack_attach( netjack_driver_state_t *netj )
 {
     //puts ("net_driver_attach");
     jack_port_t * port;
@@ -411,6 +496,15 @@ void netjack_attach( netjack_driver_state_t *netj )
 #else
 	    netj->capture_srcs = jack_slist_append(netj->capture_srcs, celt_decoder_create( netj->celt_mode ) );
 #endif
+#endif
+	} else if( netj->bitdepth == OPUS_MODE ) {
+#if HAVE_OPUS
+	    netjack_opus_codec *codec = netjack_opus_codec_new( netj->opus_mode, netj->opus_frame_size, 0 );
+	    if( codec == NULL ) {
+		jack_error ("NET: cannot create opus decoder for %s", buf);
+		goto fail;
+	    }
+	    netj->capture_srcs = jack_slist_append(netj->capture_srcs, codec );
 #endif
 	} else {
 #if HAVE_SAMPLERATE
@@ -459,6 +553,15 @@ void netjack_attach( netjack_driver_state_t *netj )
 	    CELTMode *celt_mode = celt_mode_create( netj->sample_rate, 1, netj->period_size, NULL );
 	    netj->playback_srcs = jack_slist_append(netj->playback_srcs, celt_encoder_create( celt_mode ) );
 #endif
+#endif
+	} else if( netj->bitdepth == OPUS_MODE ) {
+#if HAVE_OPUS
+	    netjack_opus_codec *codec = netjack_opus_codec_new( netj->opus_mode, netj->opus_frame_size, 1 );
+	    if( codec == NULL ) {
+		jack_error ("NET: cannot create opus encoder for %s", buf);
+		goto fail;
+	    }
+	    netj->playback_srcs = jack_slist_append(netj->playback_srcs, codec );
 #endif
 	} else {
 #if HAVE_SAMPLERATE
@@ -483,6 +586,14 @@ void netjack_attach( netjack_driver_state_t *netj )
     }
 
     jack_activate (netj->client);
+    return 0;
+
+#if HAVE_OPUS
+fail:
+    // the render functions expect a codec for every audio port
+    netjack_detach( netj );
+    return -1;
+#endif
 }
 
 
@@ -506,6 +617,11 @@ void netjack_detach( netjack_driver_state_t *netj )
             celt_decoder_destroy(decoder);
         }
         else
+#endif
+#if HAVE_OPUS
+        if( netj->bitdepth == OPUS_MODE )
+            netjack_opus_codec_free(node->data);
+        else
 #endif
         {
 #if HAVE_SAMPLERATE
@@ -515,7 +631,7 @@ void netjack_detach( netjack_driver_state_t *netj )
         }
     }
     jack_slist_free (netj->capture_srcs);
-    netj->playback_srcs = NULL;
+    netj->capture_srcs = NULL;
 
     for (node = netj->playback_ports; node; node = jack_slist_next (node))
         jack_port_unregister (netj->client,
@@ -533,6 +649,11 @@ void netjack_detach( netjack_driver_state_t *netj )
             celt_encoder_destroy(encoder);
         }
         else
+#endif
+#if HAVE_OPUS
+        if( netj->bitdepth == OPUS_MODE )
+            netjack_opus_codec_free(node->data);
+        else
 #endif
         {
 #if HAVE_SAMPLERATE
@@ -551,6 +672,27 @@ void netjack_detach( netjack_driver_state_t *netj )
 }
 
 
+#if HAVE_OPUS
+// opus custom modes have no CTL for the lookahead. It is the overlap of
+// the short MDCT, picked the same way opus_custom_mode_create() does.
+static int
+netjack_opus_lookahead( jack_nframes_t sample_rate, jack_nframes_t frame_size )
+{
+    int lm;
+
+    if( frame_size * 75 >= sample_rate && (frame_size % 16) == 0 )
+	lm = 3;
+    else if( frame_size * 150 >= sample_rate && (frame_size % 8) == 0 )
+	lm = 2;
+    else if( frame_size * 300 >= sample_rate && (frame_size % 4) == 0 )
+	lm = 1;
+    else
+	lm = 0;
+
+    return ((frame_size >> lm) >> 2) << 2;
+}
+#endif
+
 netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
 		jack_client_t * client,
                 const char *name,
@@ -570,7 +712,9 @@ netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
 		unsigned int redundancy,
 		int dont_htonl_floats,
 		int always_deadline,
-		int jitter_val )
+		int jitter_val,
+		unsigned int opus_frame_size,
+		unsigned int adaptive )
 {
 
     // Fill in netj values.
@@ -605,7 +749,7 @@ netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
     netj->client = client;
 
 
-    if ((bitdepth != 0) && (bitdepth != 8) && (bitdepth != 16) && (bitdepth != CELT_MODE))
+    if ((bitdepth != 0) && (bitdepth != 8) && (bitdepth != 16) && (bitdepth != CELT_MODE) && (bitdepth != OPUS_MODE))
     {
         jack_info ("Invalid bitdepth: %d (8, 16 or 0 for float) !!!", bitdepth);
         return NULL;
@@ -620,6 +764,8 @@ netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
     netj->resample_factor_up = resample_factor_up;
 
     netj->jitter_val = jitter_val;
+    netj->opus_frame_size = opus_frame_size;
+    netj->adaptive = adaptive;
 
     return netj;
 }
@@ -631,6 +777,13 @@ void netjack_release( netjack_driver_state_t *netj )
 
     packet_cache_free( netj->packcache );
     netj->packcache = NULL;
+
+#if HAVE_OPUS
+    if( netj->bitdepth == OPUS_MODE && netj->opus_mode ) {
+	opus_custom_mode_destroy( netj->opus_mode );
+	netj->opus_mode = NULL;
+    }
+#endif
 }
 
 int
@@ -774,8 +927,8 @@ netjack_startup( netjack_driver_state_t *netj )
     else
 	netj->deadline_offset = netj->period_usecs + 10*netj->latency*netj->period_usecs/100;
 
-    if( netj->bitdepth == CELT_MODE ) {
-	// celt mode.
+    if( netj->bitdepth == CELT_MODE || netj->bitdepth == OPUS_MODE ) {
+	// celt and opus mode, the factor is the kbits per channel.
 	// TODO: this is a hack. But i dont want to change the packet header.
 	netj->resample_factor = (netj->resample_factor * netj->period_size * 1024 / netj->sample_rate / 8)&(~1);
 	netj->resample_factor_up = (netj->resample_factor_up * netj->period_size * 1024 / netj->sample_rate / 8)&(~1);
@@ -787,6 +940,34 @@ netjack_startup( netjack_driver_state_t *netj )
 	netj->net_period_up = (float) netj->period_size / (float) netj->resample_factor_up;
     }
 
+#if HAVE_OPUS
+    if( netj->bitdepth == OPUS_MODE ) {
+	int err;
+	jack_nframes_t frames;
+
+	if( netj->opus_frame_size == 0 || (netj->period_size % netj->opus_frame_size) != 0 ) {
+	    if( netj->opus_frame_size != 0 )
+		jack_info( "opus frame size %d does not divide the period, using %d", netj->opus_frame_size, netj->period_size );
+	    netj->opus_frame_size = netj->period_size;
+	}
+
+	// every opus frame needs its length and at least one byte.
+	frames = netj->period_size / netj->opus_frame_size;
+	if( (netj->net_period_down / frames) < 3 || (netj->net_period_up / frames) < 3 ) {
+	    jack_error( "opus bitrate too low for %d frames per period", frames );
+	    exit(1);
+	}
+
+	netj->opus_mode = opus_custom_mode_create( netj->sample_rate, netj->opus_frame_size, &err );
+	if( netj->opus_mode == NULL ) {
+	    jack_error( "cannot create opus mode for %d frames at %d Hz (%s), try a smaller opus frame size",
+			netj->opus_frame_size, netj->sample_rate, opus_strerror( err ) );
+	    exit(1);
+	}
+	netj->codec_latency = 2*netjack_opus_lookahead( netj->sample_rate, netj->opus_frame_size );
+    }
+#endif
+
     netj->rx_bufsize = sizeof (jacknet_packet_header) + netj->net_period_down * netj->capture_channels * get_sample_size (netj->bitdepth);
     netj->packcache = packet_cache_new (netj->latency + 50, netj->rx_bufsize, netj->mtu);
 
@@ -804,5 +985,12 @@ netjack_startup( netjack_driver_state_t *netj )
 
     netj->running_free = 0;
 
+    netj->arrival_valid = 0;
+    netj->arrival_jitter = 0.0f;
+    netj->master_period_usecs = (float) netj->period_size * 1000000.0f / (float) netj->sample_rate;
+    netj->deadline_remainder = 0.0f;
+    netj->rate_ratio = netj->adaptive ? 1.0f : 0.0f;
+    netj->buffered_frames = 0;
+
     return 0;
 }
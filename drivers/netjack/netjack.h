@@ -36,6 +36,10 @@
 #include <celt/celt.h>
 #endif
 
+#if HAVE_OPUS
+#include <opus/opus_custom.h>
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -113,8 +117,25 @@ struct _netjack_driver_state {
     unsigned int   resample_factor_up;
     int		   jitter_val;
     struct _packet_cache * packcache;
+
+    // adaptive mode, see netjack_track_arrival()
+    unsigned int   adaptive;
+    jack_time_t	   arrival_anchor;
+    jack_nframes_t arrival_anchor_framecnt;
+    jack_time_t	   last_arrival;
+    jack_nframes_t last_arrival_framecnt;
+    int		   arrival_valid;
+    float	   arrival_jitter;
+    float	   master_period_usecs;
+    float	   deadline_remainder;
+    float	   rate_ratio;
+    jack_nframes_t buffered_frames;
 #if HAVE_CELT
     CELTMode	   *celt_mode;
+#endif
+    jack_nframes_t opus_frame_size;
+#if HAVE_OPUS
+    OpusCustomMode *opus_mode;
 #endif
 };
 
@@ -122,7 +143,7 @@ int netjack_wait( netjack_driver_state_t *netj, jack_time_t (*get_microseconds)(
 void netjack_send_silence( netjack_driver_state_t *netj, int syncstate );
 void netjack_read( netjack_driver_state_t *netj, jack_nframes_t nframes ) ;
 void netjack_write( netjack_driver_state_t *netj, jack_nframes_t nframes, int syncstate );
-void netjack_attach( netjack_driver_state_t *netj );
+int netjack_attach( netjack_driver_state_t *netj );
 void netjack_detach( netjack_driver_state_t *netj );
 
 netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
@@ -144,7 +165,9 @@ netjack_driver_state_t *netjack_init (netjack_driver_state_t *netj,
 		unsigned int redundancy,
 		int dont_htonl_floats,
 		int always_deadline,
-		int jitter_val );
+		int jitter_val,
+		unsigned int opus_frame_size,
+		unsigned int adaptive );
 
 void netjack_release( netjack_driver_state_t *netj );
 int netjack_startup( netjack_driver_state_t *netj );
@@ -32,7 +32,7 @@
 #define _DARWIN_C_SOURCE
 #endif
 
-#if HAVE_PPOLL
+#if HAVE_PPOLL || defined(__linux__)
 #define _GNU_SOURCE
 #endif
 
@@ -71,6 +71,10 @@
 #include <celt/celt.h>
 #endif
 
+#if HAVE_OPUS
+#include <opus/opus_custom.h>
+#endif
+
 #include "netjack_packet.h"
 
 // JACK2 specific.
@@ -80,6 +84,24 @@
 #define jack_error printf
 #endif
 
+// Batched socket IO: all fragments of a period go out with one
+// sendmmsg(), and packet_cache_drain_socket() picks up to
+// NETJACK_MMSG_BATCH fragments per recvmmsg().
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define NETJACK_USE_MMSG 1
+#define NETJACK_MMSG_BATCH 64
+
+typedef struct _netjack_rx_batch netjack_rx_batch;
+
+struct _netjack_rx_batch
+{
+    struct mmsghdr     msgs[NETJACK_MMSG_BATCH];
+    struct iovec       iov[NETJACK_MMSG_BATCH];
+    struct sockaddr_in addr[NETJACK_MMSG_BATCH];
+    char	      *buf;
+};
+#endif
+
 int fraggo = 0;
 
 void
@@ -130,6 +152,8 @@ int get_sample_size (int bitdepth)
     //JN: if the former, why not int16_t, if the latter, shouldn't it depend on -c N?    
     if( bitdepth == CELT_MODE )
 	return sizeof( unsigned char );
+    if( bitdepth == OPUS_MODE )
+	return sizeof( unsigned char );
     return sizeof (int32_t);
 }
 
@@ -145,17 +169,35 @@ int jack_port_is_midi(const char *porttype)
 
 
 // fragment management functions.
+//
+// The cache is a ring indexed by framecnt modulo its size. The size is
+// rounded up to a power of two, so that consecutive framecnts keep
+// landing in consecutive slots when the 32bit counter wraps.
+
+// wrap-safe framecnt ordering: non-zero if a comes before b.
+static inline int
+framecnt_before (jack_nframes_t a, jack_nframes_t b)
+{
+    return (int32_t) (a - b) < 0;
+}
+
+static inline cache_packet *
+packet_cache_slot (packet_cache *pcache, jack_nframes_t framecnt)
+{
+    return &(pcache->packets[framecnt & (pcache->size - 1)]);
+}
 
 packet_cache
 *packet_cache_new (int num_packets, int pkt_size, int mtu)
 {
     int fragment_payload_size = mtu - sizeof (jacknet_packet_header);
-    int i, fragment_number;
+    int i, fragment_number, bitmap_words;
 
     if( pkt_size == sizeof(jacknet_packet_header) )
 	    fragment_number = 1;
     else
 	    fragment_number = (pkt_size - sizeof (jacknet_packet_header) - 1) / fragment_payload_size + 1;
+    bitmap_words = (fragment_number + 31) / 32;
 
     packet_cache *pcache = malloc (sizeof (packet_cache));
     if (pcache == NULL)
@@ -164,11 +206,14 @@ packet_cache
         return NULL;
     }
 
-    pcache->size = num_packets;
-    pcache->packets = malloc (sizeof (cache_packet) * num_packets);
+    pcache->size = 1;
+    while (pcache->size < num_packets)
+        pcache->size <<= 1;
+    pcache->packets = malloc (sizeof (cache_packet) * pcache->size);
     pcache->master_address_valid = 0;
     pcache->last_framecnt_retreived = 0;
     pcache->last_framecnt_retreived_valid = 0;
+    pcache->rx_batch = NULL;
 
     if (pcache->packets == NULL)
     {
@@ -176,16 +221,17 @@ packet_cache
         return NULL;
     }
 
-    for (i = 0; i < num_packets; i++)
+    for (i = 0; i < pcache->size; i++)
     {
         pcache->packets[i].valid = 0;
         pcache->packets[i].num_fragments = fragment_number;
+        pcache->packets[i].fragments_received = 0;
         pcache->packets[i].packet_size = pkt_size;
         pcache->packets[i].mtu = mtu;
         pcache->packets[i].framecnt = 0;
-        pcache->packets[i].fragment_array = malloc (sizeof (char) * fragment_number);
+        pcache->packets[i].fragment_bitmap = calloc (bitmap_words, sizeof (uint32_t));
         pcache->packets[i].packet_buf = malloc (pkt_size);
-        if ((pcache->packets[i].fragment_array == NULL) || (pcache->packets[i].packet_buf == NULL))
+        if ((pcache->packets[i].fragment_bitmap == NULL) || (pcache->packets[i].packet_buf == NULL))
         {
             jack_error ("could not allocate packet cache (3)");
             return NULL;
@@ -193,6 +239,28 @@ packet_cache
     }
     pcache->mtu = mtu;
 
+#ifdef NETJACK_USE_MMSG
+    netjack_rx_batch *rx = malloc (sizeof (netjack_rx_batch));
+    if (rx != NULL && (rx->buf = malloc (NETJACK_MMSG_BATCH * mtu)) != NULL)
+    {
+        memset (rx->msgs, 0, sizeof (rx->msgs));
+        for (i = 0; i < NETJACK_MMSG_BATCH; i++)
+        {
+            rx->iov[i].iov_base = rx->buf + i * mtu;
+            rx->iov[i].iov_len = mtu;
+            rx->msgs[i].msg_hdr.msg_iov = &(rx->iov[i]);
+            rx->msgs[i].msg_hdr.msg_iovlen = 1;
+            rx->msgs[i].msg_hdr.msg_name = &(rx->addr[i]);
+        }
+        pcache->rx_batch = rx;
+    }
+    else
+    {
+        // fall back to one recvfrom() per fragment
+        free (rx);
+    }
+#endif
+
     return pcache;
 }
 
@@ -205,65 +273,61 @@ packet_cache_free (packet_cache *pcache)
 
     for (i = 0; i < pcache->size; i++)
     {
-        free (pcache->packets[i].fragment_array);
+        free (pcache->packets[i].fragment_bitmap);
         free (pcache->packets[i].packet_buf);
     }
 
+#ifdef NETJACK_USE_MMSG
+    if (pcache->rx_batch)
+    {
+        free (((netjack_rx_batch *) pcache->rx_batch)->buf);
+        free (pcache->rx_batch);
+    }
+#endif
+
     free (pcache->packets);
     free (pcache);
 }
 
+// Returns NULL when the slot of framecnt is taken by a newer packet,
+// the fragment is too late to be of any use then.
 cache_packet
 *packet_cache_get_packet (packet_cache *pcache, jack_nframes_t framecnt)
 {
-    int i;
-    cache_packet *retval;
+    cache_packet *retval = packet_cache_slot (pcache, framecnt);
 
-    for (i = 0; i < pcache->size; i++)
+    if (retval->valid)
     {
-        if (pcache->packets[i].valid && (pcache->packets[i].framecnt == framecnt))
-            return &(pcache->packets[i]);
-    }
+        if (retval->framecnt == framecnt)
+            return retval;
 
-    // The Packet is not in the packet cache.
-    // find a free packet.
+        if (framecnt_before (framecnt, retval->framecnt))
+            return NULL;
 
-    retval = packet_cache_get_free_packet (pcache);
-    if (retval != NULL)
-    {
-        cache_packet_set_framecnt (retval, framecnt);
-        return retval;
+        // The slot holds a packet from at least one lap ago,
+        // which would have been the oldest one anyway.
+        //printf( "Dropping %d from Cache :S\n", retval->framecnt );
+        cache_packet_reset (retval);
     }
 
-    // No Free Packet available
-    // Get The Oldest packet and reset it.
-
-    retval = packet_cache_get_oldest_packet (pcache);
-    //printf( "Dropping %d from Cache :S\n", retval->framecnt );
-    cache_packet_reset (retval);
     cache_packet_set_framecnt (retval, framecnt);
 
     return retval;
 }
 
-// TODO: fix wrapping case... need to pass
-//       current expected frame here.
-//
-//       or just save framecount into packet_cache.
-
 cache_packet
 *packet_cache_get_oldest_packet (packet_cache *pcache)
 {
-    jack_nframes_t minimal_frame = JACK_MAX_FRAMES;
     cache_packet *retval = &(pcache->packets[0]);
+    int found = 0;
     int i;
 
     for (i = 0; i < pcache->size; i++)
     {
-        if (pcache->packets[i].valid && (pcache->packets[i].framecnt < minimal_frame))
+        if (pcache->packets[i].valid && (!found || framecnt_before (pcache->packets[i].framecnt, retval->framecnt)))
         {
-            minimal_frame = pcache->packets[i].framecnt;
             retval = &(pcache->packets[i]);
+            found = 1;
         }
     }
 
@@ -287,29 +351,34 @@ cache_packet
 void
 cache_packet_reset (cache_packet *pack)
 {
-    int i;
     pack->valid = 0;
-
-    // XXX: i dont think this is necessary here...
-    //      fragement array is cleared in _set_framecnt()
-
-    for (i = 0; i < pack->num_fragments; i++)
-        pack->fragment_array[i] = 0;
 }
 
 void
 cache_packet_set_framecnt (cache_packet *pack, jack_nframes_t framecnt)
 {
-    int i;
-
     pack->framecnt = framecnt;
 
-    for (i = 0; i < pack->num_fragments; i++)
-        pack->fragment_array[i] = 0;
+    memset (pack->fragment_bitmap, 0, ((pack->num_fragments + 31) / 32) * sizeof (uint32_t));
+    pack->fragments_received = 0;
 
     pack->valid = 1;
 }
 
+static inline void
+cache_packet_mark_fragment (cache_packet *pack, jack_nframes_t fragment_nr)
+{
+    uint32_t *word = &(pack->fragment_bitmap[fragment_nr >> 5]);
+    uint32_t bit = 1U << (fragment_nr & 31);
+
+    // duplicates must not be counted twice.
+    if (!(*word & bit))
+    {
+        *word |= bit;
+        pack->fragments_received += 1;
+    }
+}
+
 void
 cache_packet_add_fragment (cache_packet *pack, char *packet_buf, int rcv_len)
 {
@@ -331,7 +400,7 @@ cache_packet_add_fragment (cache_packet *pack, char *packet_buf, int rcv_len)
     if (fragment_nr == 0)
     {
         memcpy (pack->packet_buf, packet_buf, rcv_len);
-        pack->fragment_array[0] = 1;
+        cache_packet_mark_fragment (pack, 0);
 
         return;
     }
@@ -341,7 +410,7 @@ cache_packet_add_fragment (cache_packet *pack, char *packet_buf, int rcv_len)
         if ((fragment_nr * fragment_payload_size + rcv_len - sizeof (jacknet_packet_header)) <= (pack->packet_size - sizeof (jacknet_packet_header)))
         {
             memcpy (packet_bufX + fragment_nr * fragment_payload_size, dataX, rcv_len - sizeof (jacknet_packet_header));
-            pack->fragment_array[fragment_nr] = 1;
+            cache_packet_mark_fragment (pack, fragment_nr);
         }
         else
             jack_error ("too long packet received...");
@@ -351,12 +420,7 @@ cache_packet_add_fragment (cache_packet *pack, char *packet_buf, int rcv_len)
 int
 cache_packet_is_complete (cache_packet *pack)
 {
-    int i;
-    for (i = 0; i < pack->num_fragments; i++)
-        if (pack->fragment_array[i] == 0)
-            return 0;
-
-    return 1;
+    return pack->fragments_received == pack->num_fragments;
 }
 
 #ifndef WIN32
@@ -516,6 +580,68 @@ netjack_poll_deadline (int sockfd, jack_time_t deadline, jack_time_t (*get_micro
     return 0;
 }
 #endif
+static void
+packet_cache_receive_fragment (packet_cache *pcache, char *rx_packet, int rcv_len, struct sockaddr_in *sender_address, size_t senderlen, jack_time_t timestamp)
+{
+    jacknet_packet_header *pkthdr = (jacknet_packet_header *) rx_packet;
+    jack_nframes_t framecnt;
+    cache_packet *cpack;
+
+    if (pcache->master_address_valid) {
+	// Verify its from our master.
+	if (memcmp (sender_address, &(pcache->master_address), senderlen) != 0)
+	    return;
+    } else {
+	// Setup this one as master
+	//printf( "setup master...\n" );
+	memcpy ( &(pcache->master_address), sender_address, senderlen );
+	pcache->master_address_valid = 1;
+    }
+
+    framecnt = ntohl (pkthdr->framecnt);
+    if( pcache->last_framecnt_retreived_valid && !framecnt_before( pcache->last_framecnt_retreived, framecnt ))
+	return;
+
+    cpack = packet_cache_get_packet (pcache, framecnt);
+    if (cpack == NULL)
+	return;
+    cache_packet_add_fragment (cpack, rx_packet, rcv_len);
+    cpack->recv_timestamp = timestamp;
+}
+
+#ifdef NETJACK_USE_MMSG
+// Returns 0 when the socket is drained, -1 if recvmmsg() is not
+// supported by the kernel.
+static int
+packet_cache_drain_socket_batched( packet_cache *pcache, int sockfd, jack_time_t (*get_microseconds)(void) )
+{
+    netjack_rx_batch *rx = pcache->rx_batch;
+    jack_time_t timestamp;
+    int i, n;
+
+    while (1)
+    {
+        for (i = 0; i < NETJACK_MMSG_BATCH; i++)
+            rx->msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+
+        n = recvmmsg (sockfd, rx->msgs, NETJACK_MMSG_BATCH, MSG_DONTWAIT, NULL);
+        if (n < 0)
+            return (errno == ENOSYS) ? -1 : 0;
+
+        timestamp = get_microseconds();
+        for (i = 0; i < n; i++)
+            packet_cache_receive_fragment (pcache, rx->buf + i * pcache->mtu,
+                                           rx->msgs[i].msg_len, &(rx->addr[i]),
+                                           rx->msgs[i].msg_hdr.msg_namelen, timestamp);
+
+        // a short batch means the queue was empty, save the
+        // syscall that would tell us so.
+        if (n < NETJACK_MMSG_BATCH)
+            return 0;
+    }
+}
+#endif
+
 // This now reads all a socket has into the cache.
 // replacing netjack_recv functions.
 
@@ -523,10 +649,7 @@ void
 packet_cache_drain_socket( packet_cache *pcache, int sockfd, jack_time_t (*get_microseconds)(void) )
 {
     char *rx_packet = alloca (pcache->mtu);
-    jacknet_packet_header *pkthdr = (jacknet_packet_header *) rx_packet;
     int rcv_len;
-    jack_nframes_t framecnt;
-    cache_packet *cpack;
     struct sockaddr_in sender_address;
 #ifdef WIN32
     size_t senderlen = sizeof( struct sockaddr_in );
@@ -534,6 +657,17 @@ packet_cache_drain_socket( packet_cache *pcache, int sockfd, jack_time_t (*get_m
     ioctlsocket( sockfd, FIONBIO, &parm );
 #else
     socklen_t senderlen = sizeof( struct sockaddr_in );
+#endif
+#ifdef NETJACK_USE_MMSG
+    if (pcache->rx_batch)
+    {
+        if (packet_cache_drain_socket_batched (pcache, sockfd, get_microseconds) == 0)
+            return;
+
+        free (((netjack_rx_batch *) pcache->rx_batch)->buf);
+        free (pcache->rx_batch);
+        pcache->rx_batch = NULL;
+    }
 #endif
     while (1)
     {
@@ -547,24 +681,7 @@ packet_cache_drain_socket( packet_cache *pcache, int sockfd, jack_time_t (*get_m
         if (rcv_len < 0)
             return;
 
-	if (pcache->master_address_valid) {
-	    // Verify its from our master.
-	    if (memcmp (&sender_address, &(pcache->master_address), senderlen) != 0)
-		continue;
-	} else {
-	    // Setup this one as master
-	    //printf( "setup master...\n" );
-	    memcpy ( &(pcache->master_address), &sender_address, senderlen );
-	    pcache->master_address_valid = 1;
-	}
-
-        framecnt = ntohl (pkthdr->framecnt);
-	if( pcache->last_framecnt_retreived_valid && (framecnt <= pcache->last_framecnt_retreived ))
-	    continue;
-
-        cpack = packet_cache_get_packet (pcache, framecnt);
-        cache_packet_add_fragment (cpack, rx_packet, rcv_len);
-	cpack->recv_timestamp = get_microseconds();
+        packet_cache_receive_fragment (pcache, rx_packet, rcv_len, &sender_address, senderlen, get_microseconds());
     }
 }
 
@@ -583,7 +700,7 @@ packet_cache_clear_old_packets (packet_cache *pcache, jack_nframes_t framecnt )
 
     for (i = 0; i < pcache->size; i++)
     {
-        if (pcache->packets[i].valid && (pcache->packets[i].framecnt < framecnt))
+        if (pcache->packets[i].valid && framecnt_before (pcache->packets[i].framecnt, framecnt))
         {
             cache_packet_reset (&(pcache->packets[i]));
         }
@@ -593,18 +710,9 @@ packet_cache_clear_old_packets (packet_cache *pcache, jack_nframes_t framecnt )
 int
 packet_cache_retreive_packet_pointer( packet_cache *pcache, jack_nframes_t framecnt, char **packet_buf, int pkt_size, jack_time_t *timestamp )
 {
-    int i;
-    cache_packet *cpack = NULL;
-
-
-    for (i = 0; i < pcache->size; i++) {
-        if (pcache->packets[i].valid && (pcache->packets[i].framecnt == framecnt)) {
-	    cpack = &(pcache->packets[i]);
-            break;
-	}
-    }
+    cache_packet *cpack = packet_cache_slot (pcache, framecnt);
 
-    if( cpack == NULL ) {
+    if( !cpack->valid || cpack->framecnt != framecnt ) {
 	//printf( "retreive packet: %d....not found\n", framecnt );
 	return -1;
     }
@@ -627,18 +735,9 @@ packet_cache_retreive_packet_pointer( packet_cache *pcache, jack_nframes_t frame
 int
 packet_cache_release_packet( packet_cache *pcache, jack_nframes_t framecnt )
 {
-    int i;
-    cache_packet *cpack = NULL;
-
-
-    for (i = 0; i < pcache->size; i++) {
-        if (pcache->packets[i].valid && (pcache->packets[i].framecnt == framecnt)) {
-	    cpack = &(pcache->packets[i]);
-            break;
-	}
-    }
+    cache_packet *cpack = packet_cache_slot (pcache, framecnt);
 
-    if( cpack == NULL ) {
+    if( !cpack->valid || cpack->framecnt != framecnt ) {
 	//printf( "retreive packet: %d....not found\n", framecnt );
 	return -1;
     }
@@ -662,7 +761,7 @@ packet_cache_get_fill( packet_cache *pcache, jack_nframes_t expected_framecnt )
     {
 	cache_packet *cpack = &(pcache->packets[i]);
         if (cpack->valid && cache_packet_is_complete( cpack ))
-	    if( cpack->framecnt >= expected_framecnt )
+	    if( !framecnt_before( cpack->framecnt, expected_framecnt ) )
 		num_packets_before_us += 1;
     }
 
@@ -676,10 +775,18 @@ packet_cache_get_next_available_framecnt( packet_cache *pcache, jack_nframes_t e
     int i;
     jack_nframes_t best_offset = JACK_MAX_FRAMES/2-1;
     int retval = 0;
+    cache_packet *cpack = packet_cache_slot (pcache, expected_framecnt);
+
+    // the common case, the expected packet is there.
+    if( cpack->valid && cpack->framecnt == expected_framecnt && cache_packet_is_complete( cpack ) ) {
+	if( framecnt )
+	    *framecnt = expected_framecnt;
+	return 1;
+    }
 
     for (i = 0; i < pcache->size; i++)
     {
-	cache_packet *cpack = &(pcache->packets[i]);
+	cpack = &(pcache->packets[i]);
 	//printf( "p%d: valid=%d, frame %d\n", i, cpack->valid, cpack->framecnt );
 
         if (!cpack->valid || !cache_packet_is_complete( cpack )) {
@@ -687,7 +794,7 @@ packet_cache_get_next_available_framecnt( packet_cache *pcache, jack_nframes_t e
 	    continue;
 	}
 
-	if( cpack->framecnt < expected_framecnt )
+	if( framecnt_before( cpack->framecnt, expected_framecnt ) )
 	    continue;
 
 	if( (cpack->framecnt - expected_framecnt) > best_offset ) {
@@ -696,9 +803,6 @@ packet_cache_get_next_available_framecnt( packet_cache *pcache, jack_nframes_t e
 
 	best_offset = cpack->framecnt - expected_framecnt;
 	retval = 1;
-
-	if( best_offset == 0 )
-	    break;
     }
     if( retval && framecnt )
 	*framecnt = expected_framecnt + best_offset;
@@ -723,7 +827,7 @@ packet_cache_get_highest_available_framecnt( packet_cache *pcache, jack_nframes_
 	    continue;
 	}
 
-	if (cpack->framecnt < best_value) {
+	if( retval && framecnt_before( cpack->framecnt, best_value ) ) {
 	    continue;
 	}
 
@@ -770,6 +874,60 @@ packet_cache_find_latency( packet_cache *pcache, jack_nframes_t expected_framecn
 
     return retval;
 }
+#ifdef NETJACK_USE_MMSG
+// Send all fragments of a packet with one sendmmsg(). Each fragment
+// is a copy of the header followed by a slice of packet_buf, so the
+// payload is not copied.
+static int
+netjack_sendmmsg (int sockfd, char *packet_buf, int pkt_size, int flags, struct sockaddr *addr, int addr_size, int mtu)
+{
+    int fragment_payload_size = mtu - sizeof (jacknet_packet_header);
+    int payload_size = pkt_size - sizeof (jacknet_packet_header);
+    int frag_total = (payload_size + fragment_payload_size - 1) / fragment_payload_size;
+    jacknet_packet_header *headers = alloca (frag_total * sizeof (jacknet_packet_header));
+    struct iovec *iov = alloca (2 * frag_total * sizeof (struct iovec));
+    struct mmsghdr *msgs = alloca (frag_total * sizeof (struct mmsghdr));
+    char *packet_bufX = packet_buf + sizeof (jacknet_packet_header);
+    int i, n, sent;
+
+    memset (msgs, 0, frag_total * sizeof (struct mmsghdr));
+
+    for (i = 0; i < frag_total; i++)
+    {
+        memcpy (&headers[i], packet_buf, sizeof (jacknet_packet_header));
+        headers[i].fragment_nr = htonl (i);
+
+        iov[2*i].iov_base = &headers[i];
+        iov[2*i].iov_len = sizeof (jacknet_packet_header);
+        iov[2*i+1].iov_base = packet_bufX + i * fragment_payload_size;
+        iov[2*i+1].iov_len = (i < frag_total - 1) ? fragment_payload_size : payload_size - i * fragment_payload_size;
+
+        msgs[i].msg_hdr.msg_name = addr;
+        msgs[i].msg_hdr.msg_namelen = addr_size;
+        msgs[i].msg_hdr.msg_iov = &iov[2*i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+
+    for (sent = 0; sent < frag_total; sent += n)
+    {
+        n = sendmmsg (sockfd, msgs + sent, frag_total - sent, flags);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                n = 0;
+                continue;
+            }
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int netjack_use_sendmmsg = 1;
+#endif
+
 // fragmented packet IO
 void
 netjack_sendto (int sockfd, char *packet_buf, int pkt_size, int flags, struct sockaddr *addr, int addr_size, int mtu)
@@ -797,6 +955,20 @@ netjack_sendto (int sockfd, char *packet_buf, int pkt_size, int flags, struct so
     else
     {
 	int err;
+#ifdef NETJACK_USE_MMSG
+	if (netjack_use_sendmmsg)
+	{
+	    if (netjack_sendmmsg (sockfd, packet_buf, pkt_size, flags, addr, addr_size, mtu) == 0)
+		return;
+	    if (errno != ENOSYS)
+	    {
+		perror( "send" );
+		return;
+	    }
+	    // old kernel, send fragment by fragment from now on
+	    netjack_use_sendmmsg = 0;
+	}
+#endif
         // Copy the packet header to the tx pack first.
         memcpy(tx_packet, packet_buf, sizeof (jacknet_packet_header));
 
@@ -1444,6 +1616,166 @@ render_jack_ports_to_payload_celt (JSList *playback_ports, JSList *playback_srcs
     }
 }
 
+#endif
+
+#if HAVE_OPUS
+#define NETJACK_OPUS_MAX_BYTES 1275	// largest opus frame
+
+netjack_opus_codec *
+netjack_opus_codec_new (OpusCustomMode *mode, jack_nframes_t frame_size, int encoder)
+{
+    int err;
+    netjack_opus_codec *codec = calloc (1, sizeof (netjack_opus_codec));
+
+    if (codec == NULL)
+	return NULL;
+
+    codec->frame_size = frame_size;
+    if (encoder) {
+	codec->encoder = opus_custom_encoder_create (mode, 1, &err);
+	if (codec->encoder == NULL) {
+	    jack_error ("cannot create opus encoder: %s", opus_strerror (err));
+	    free (codec);
+	    return NULL;
+	}
+	// every frame gets exactly the bytes we reserved for it.
+	opus_custom_encoder_ctl (codec->encoder, OPUS_SET_VBR (0));
+	opus_custom_encoder_ctl (codec->encoder, OPUS_SET_COMPLEXITY (10));
+    } else {
+	codec->decoder = opus_custom_decoder_create (mode, 1, &err);
+	if (codec->decoder == NULL) {
+	    jack_error ("cannot create opus decoder: %s", opus_strerror (err));
+	    free (codec);
+	    return NULL;
+	}
+    }
+
+    return codec;
+}
+
+void
+netjack_opus_codec_free (netjack_opus_codec *codec)
+{
+    if (codec == NULL)
+	return;
+    if (codec->encoder)
+	opus_custom_encoder_destroy (codec->encoder);
+    if (codec->decoder)
+	opus_custom_decoder_destroy (codec->decoder);
+    free (codec);
+}
+
+// render functions for opus.
+void
+render_payload_to_jack_ports_opus (void *packet_payload, jack_nframes_t net_period_down, JSList *capture_ports, JSList *capture_srcs, jack_nframes_t nframes)
+{
+    int chn = 0;
+    JSList *node = capture_ports;
+    JSList *src_node = capture_srcs;
+
+    unsigned char *packet_bufX = (unsigned char *)packet_payload;
+
+    while (node != NULL)
+    {
+        jack_port_t *port = (jack_port_t *) node->data;
+        jack_default_audio_sample_t* buf = jack_port_get_buffer (port, nframes);
+
+        const char *porttype = jack_port_type (port);
+
+        if (jack_port_is_audio (porttype))
+        {
+            // audio port, decode opus data.
+	    netjack_opus_codec *codec = src_node->data;
+	    int frames = nframes / codec->frame_size;
+	    int frame_bytes = net_period_down / frames;
+	    int i;
+
+	    for (i = 0; i < frames; i++) {
+		unsigned char *frameX = packet_bufX + i * frame_bytes;
+		float *out = buf + i * codec->frame_size;
+		int len = 0;
+
+		if( packet_payload )
+		    len = (frameX[0] << 8) | frameX[1];
+
+		// a missing packet, or a frame the encoder could not
+		// produce: let the decoder conceal the gap.
+		if( len == 0 || len > frame_bytes - 2 )
+		    opus_custom_decode_float( codec->decoder, NULL, 0, out, codec->frame_size );
+		else if( opus_custom_decode_float( codec->decoder, frameX + 2, len, out, codec->frame_size ) != (int) codec->frame_size )
+		    memset( out, 0, codec->frame_size * sizeof (float) );
+	    }
+
+	    src_node = jack_slist_next (src_node);
+        }
+        else if (jack_port_is_midi (porttype))
+        {
+            // midi port, decode midi events
+            // convert the data buffer to a standard format (uint32_t based)
+            unsigned int buffer_size_uint32 = net_period_down / 4;
+            uint32_t * buffer_uint32 = (uint32_t*) packet_bufX;
+	    if( packet_payload )
+		decode_midi_buffer (buffer_uint32, buffer_size_uint32, buf);
+        }
+        packet_bufX = (packet_bufX + net_period_down);
+        node = jack_slist_next (node);
+        chn++;
+    }
+}
+
+void
+render_jack_ports_to_payload_opus (JSList *playback_ports, JSList *playback_srcs, jack_nframes_t nframes, void *packet_payload, jack_nframes_t net_period_up)
+{
+    int chn = 0;
+    JSList *node = playback_ports;
+    JSList *src_node = playback_srcs;
+
+    unsigned char *packet_bufX = (unsigned char *)packet_payload;
+
+    while (node != NULL)
+    {
+        jack_port_t *port = (jack_port_t *) node->data;
+        jack_default_audio_sample_t* buf = jack_port_get_buffer (port, nframes);
+        const char *porttype = jack_port_type (port);
+
+        if (jack_port_is_audio (porttype))
+        {
+            // audio port, encode opus data.
+	    netjack_opus_codec *codec = src_node->data;
+	    int frames = nframes / codec->frame_size;
+	    int frame_bytes = net_period_up / frames;
+	    int max_bytes = frame_bytes - 2;
+	    int i;
+
+	    if( max_bytes > NETJACK_OPUS_MAX_BYTES )
+		max_bytes = NETJACK_OPUS_MAX_BYTES;
+
+	    for (i = 0; i < frames; i++) {
+		unsigned char *frameX = packet_bufX + i * frame_bytes;
+		int encoded_bytes = opus_custom_encode_float( codec->encoder, buf + i * codec->frame_size, codec->frame_size, frameX + 2, max_bytes );
+
+		if( encoded_bytes < 0 )
+		    encoded_bytes = 0;
+		frameX[0] = (encoded_bytes >> 8) & 0xff;
+		frameX[1] = encoded_bytes & 0xff;
+	    }
+
+	    src_node = jack_slist_next( src_node );
+        }
+        else if (jack_port_is_midi (porttype))
+        {
+            // encode midi events from port to packet
+            // convert the data buffer to a standard format (uint32_t based)
+            unsigned int buffer_size_uint32 = net_period_up / 4;
+            uint32_t * buffer_uint32 = (uint32_t*) packet_bufX;
+            encode_midi_buffer (buffer_uint32, buffer_size_uint32, buf);
+        }
+        packet_bufX = (packet_bufX + net_period_up);
+        node = jack_slist_next (node);
+        chn++;
+    }
+}
+
 #endif
 /* Wrapper functions with bitdepth argument... */
 void
@@ -1456,6 +1788,10 @@ render_payload_to_jack_ports (int bitdepth, void *packet_payload, jack_nframes_t
 #if HAVE_CELT
     else if (bitdepth == CELT_MODE)
         render_payload_to_jack_ports_celt (packet_payload, net_period_down, capture_ports, capture_srcs, nframes);
+#endif
+#if HAVE_OPUS
+    else if (bitdepth == OPUS_MODE)
+        render_payload_to_jack_ports_opus (packet_payload, net_period_down, capture_ports, capture_srcs, nframes);
 #endif
     else
         render_payload_to_jack_ports_float (packet_payload, net_period_down, capture_ports, capture_srcs, nframes, dont_htonl_floats);
@@ -1471,6 +1807,10 @@ render_jack_ports_to_payload (int bitdepth, JSList *playback_ports, JSList *play
 #if HAVE_CELT
     else if (bitdepth == CELT_MODE)
         render_jack_ports_to_payload_celt (playback_ports, playback_srcs, nframes, packet_payload, net_period_up);
+#endif
+#if HAVE_OPUS
+    else if (bitdepth == OPUS_MODE)
+        render_jack_ports_to_payload_opus (playback_ports, playback_srcs, nframes, packet_payload, net_period_up);
 #endif
     else
         render_jack_ports_to_payload_float (playback_ports, playback_srcs, nframes, packet_payload, net_period_up, dont_htonl_floats);
@@ -39,10 +39,15 @@
 
 #include <jack/midiport.h>
 
+#if HAVE_OPUS
+#include <opus/opus_custom.h>
+#endif
+
 //#include <netinet/in.h>
 // The Packet Header.
 
 #define CELT_MODE 1000   // Magic bitdepth value that indicates CELT compression
+#define OPUS_MODE 999    // Magic bitdepth value that indicates OPUS compression
 #define MASTER_FREEWHEELS 0x80000000
 
 typedef struct _jacknet_packet_header jacknet_packet_header;
@@ -80,17 +85,19 @@ union _int_float
 };
 
 // fragment reorder cache.
+// a ring of packets, framecnt N lives in packets[N % size].
 typedef struct _cache_packet cache_packet;
 
 struct _cache_packet
 {
     int		    valid;
     int		    num_fragments;
+    int		    fragments_received;
     int		    packet_size;
     int		    mtu;
     jack_time_t	    recv_timestamp;
     jack_nframes_t  framecnt;
-    char *	    fragment_array;
+    uint32_t *	    fragment_bitmap;
     char *	    packet_buf;
 };
 
@@ -105,6 +112,7 @@ struct _packet_cache
     int master_address_valid;
     jack_nframes_t last_framecnt_retreived;
     int last_framecnt_retreived_valid;
+    void *rx_batch;	// recvmmsg() buffers, NULL if not available
 };
 
 // fragment cache function prototypes
@@ -145,6 +153,23 @@ void render_payload_to_jack_ports(int bitdepth, void *packet_payload, jack_nfram
 
 void render_jack_ports_to_payload(int bitdepth, JSList *playback_ports, JSList *playback_srcs, jack_nframes_t nframes, void *packet_payload, jack_nframes_t net_period_up, int dont_htonl_floats );
 
+#if HAVE_OPUS
+// per channel opus state, these are the capture_srcs/playback_srcs in OPUS_MODE.
+// a period is coded as nframes/frame_size opus frames, each one stored as
+// a 16bit big endian length and the encoded bytes. length 0 means lost.
+typedef struct _netjack_opus_codec netjack_opus_codec;
+
+struct _netjack_opus_codec
+{
+    OpusCustomEncoder *encoder;
+    OpusCustomDecoder *decoder;
+    jack_nframes_t     frame_size;
+};
+
+netjack_opus_codec *netjack_opus_codec_new(OpusCustomMode *mode, jack_nframes_t frame_size, int encoder);
+void netjack_opus_codec_free(netjack_opus_codec *codec);
+#endif
+
 
 // XXX: This is sort of deprecated:
 //      This one waits forever. an is not using ppoll
@@ -205,6 +205,16 @@ typedef struct _jack_driver {
    prior to this, and the start function after this one has returned.
 
     JackDriverBufSizeFunction bufsize;
+
+
+   A driver that holds audio ahead of the cycle (a network jitter
+   buffer, for example) or that corrects for a clock it does not run
+   from may report that here, from its "wait" function. The engine
+   publishes both with each cycle's statistics. They are left at zero
+   by drivers that have nothing to report.
+
+    jack_nframes_t buffered_frames;
+    float rate_ratio;
 */
 
 /* define the fields here... */	
@@ -221,7 +231,9 @@ typedef struct _jack_driver {
     JackDriverNullCycleFunction null_cycle; \
     JackDriverStopFunction stop; \
     JackDriverStartFunction start; \
-    JackDriverBufSizeFunction bufsize;
+    JackDriverBufSizeFunction bufsize; \
+    jack_nframes_t buffered_frames; \
+    float rate_ratio;
 
     JACK_DRIVER_DECL			/* expand the macro */
 
@@ -37,11 +37,23 @@ typedef struct {
     jack_shmsize_t   offset;
 } jack_port_buffer_info_t;
 
+/* A mix of a set of output ports that the engine computes once per
+ * cycle for all the input ports connected to exactly that set.
+ */
+typedef struct _jack_port_mix {
+    struct _jack_port_internal **sources; /* sorted by port id */
+    unsigned int             nsources;
+    jack_port_buffer_info_t *buffer_info;
+    unsigned int             refcount;	/* input ports using this mix */
+    unsigned int             mixed_cycle;
+} jack_port_mix_t;
+
 /* The engine keeps an array of these in its local memory. */
 typedef struct _jack_port_internal {
     struct _jack_port_shared *shared;
     JSList                   *connections;
     jack_port_buffer_info_t  *buffer_info;
+    jack_port_mix_t          *mix;	/* input ports only, see premix */
 } jack_port_internal_t;
 
 /* The engine's internal port type structure. */
@@ -97,6 +109,13 @@ struct _jack_engine {
 
     jack_shm_info_t control_shm;
 
+    /* per-cycle statistics ring, written by the process thread */
+
+    jack_shm_info_t    stats_shm;
+    jack_stats_ring_t *stats;
+    jack_time_t        stats_cycle_end; /* of the previous cycle */
+    int                stats_xrun;      /* xrun since previous cycle */
+
     /* address-space local port buffer and segment info, 
        indexed by the port type_id 
     */
@@ -104,6 +123,13 @@ struct _jack_engine {
     jack_shm_info_t         port_segment[JACK_MAX_PORT_TYPES];
 
     unsigned int    port_max;
+
+    /* unused port ids, and which bucket of the port name index each
+       entry is linked into; protected by port_lock */
+    jack_port_id_t *port_free;
+    unsigned int    port_nfree;
+    uint32_t       *port_index_bucket;
+
     pthread_t	    server_thread;
     pthread_t	    watchdog_thread;
 
@@ -138,6 +164,9 @@ struct _jack_engine {
     pid_t           wait_pid;
     int             nozombies;
     int             timeout_count_threshold;
+    int             parallel;
+    int             futex_wakeup;
+    int             premix;
     volatile int    problems;
     volatile int    timeout_count;
     volatile int    new_clients_allowed;    
@@ -147,11 +176,32 @@ struct _jack_engine {
     JSList	   *clients_waiting;
     JSList	   *reserved_client_names;
 
+    /* topological order of the sortfeeds relation, kept up to date as
+       connections are made so that sorting the graph does not have to
+       work it out again; protected by `client_lock' */
+    jack_client_internal_t **sort_order;
+    jack_client_internal_t **sort_scratch;
+    unsigned int             sort_nclients;
+    unsigned int             sort_max;
+    unsigned int             sort_mark;
+
     jack_port_internal_t    *internal_ports;
     jack_client_internal_t  *timebase_client;
     jack_port_buffer_info_t *silent_buffer;
     jack_client_internal_t  *current_client;
 
+    /* parallel execution scratch space, sized by jack_rechain_graph() */
+    unsigned int             graph_size;
+    jack_client_internal_t **graph_ready;
+    jack_client_internal_t **graph_running;
+    struct pollfd           *graph_pfd;
+    unsigned int             graph_triggered; /* this cycle, futex mode */
+    unsigned int             graph_syscalls;  /* this cycle, futex mode */
+
+    /* shared input mixes, protected by the graph lock */
+    JSList                  *port_mixes;
+    unsigned int             mix_cycle;
+
 #define JACK_ENGINE_ROLLING_COUNT 32
 #define JACK_ENGINE_ROLLING_INTERVAL 1024
 
@@ -190,6 +240,7 @@ jack_engine_t  *jack_engine_new (int real_time, int real_time_priority,
 				 unsigned int port_max,
                                  pid_t waitpid, jack_nframes_t frame_time_offset, int nozombies, 
 				 int timeout_count_threshold,
+				 int parallel, int futex_wakeup, int premix,
 				 JSList *drivers);
 void		jack_engine_delete (jack_engine_t *);
 int		jack_run (jack_engine_t *engine);
@@ -257,6 +308,10 @@ void	jack_port_clear_connections (jack_engine_t *engine,
 void	jack_port_registration_notify (jack_engine_t *, jack_port_id_t, int);
 void	jack_port_release (jack_engine_t *engine, jack_port_internal_t *);
 void	jack_sort_graph (jack_engine_t *engine);
+int	jack_client_order_add (jack_engine_t *engine,
+			       jack_client_internal_t *client);
+void	jack_client_order_remove (jack_engine_t *engine,
+				  jack_client_internal_t *client);
 int     jack_stop_freewheeling (jack_engine_t* engine, int engine_exiting);
 jack_client_internal_t *
 jack_client_by_name (jack_engine_t *engine, const char *name);
@@ -0,0 +1,106 @@
+/*
+    Shared memory futexes used for process cycle wakeups.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#ifndef __jack_futex_h__
+#define __jack_futex_h__
+
+#include <jack/types.h>
+
+/* bits in jack_client_control_t.graph_wake */
+#define JACK_WAKE_PROCESS 0x1	/* run one process cycle */
+#define JACK_WAKE_EVENT   0x2	/* an event is waiting on the event socket */
+
+/* What one client costs per cycle with the FIFO handshake: the
+ * engine (or upstream client) write()s the wait FIFO, the client
+ * poll()s it, write()s the next FIFO, poll()s and read()s its wait
+ * FIFO, and the engine poll()s and read()s the last FIFO of the
+ * subgraph.
+ */
+#define JACK_FIFO_WAKEUP_SYSCALLS 7
+
+/* A futex word in one of the packed shared memory structures.  The
+ * member has to be declared JACK_FUTEX_ALIGNED: packing would
+ * otherwise drop its alignment, while the kernel and the atomic
+ * builtins need a naturally aligned 32 bit word.
+ */
+typedef struct {
+    volatile int32_t word;
+} jack_futex_t;
+
+#ifdef __GNUC__
+#define JACK_FUTEX_ALIGNED __attribute__((__aligned__ (4)))
+#else
+/* Add other things here for non-gcc platforms */
+#define JACK_FUTEX_ALIGNED
+#endif
+
+#if defined(__linux__) && !defined(JACK_USE_MACH_THREADS)
+
+#define JACK_USE_FUTEX 1
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* The futex words live in shared memory mapped by different
+ * processes, so the non-private operations must be used.
+ */
+
+/**
+ * Sleep while futex->word == val, for at most timeout_usecs.
+ *
+ * @return 0 when woken up or when the word no longer equals val, -1
+ * otherwise with errno set (ETIMEDOUT, EINTR, ...).
+ */
+static inline int
+jack_futex_wait (volatile jack_futex_t *futex, int32_t val,
+		 jack_time_t timeout_usecs)
+{
+	struct timespec timeout;
+
+	timeout.tv_sec = timeout_usecs / 1000000;
+	timeout.tv_nsec = (timeout_usecs % 1000000) * 1000;
+
+	if (syscall (SYS_futex, &futex->word, FUTEX_WAIT, val, &timeout, NULL, 0) == 0 ||
+	    errno == EAGAIN) {
+		return 0;
+	}
+
+	return -1;
+}
+
+static inline void
+jack_futex_wake (volatile jack_futex_t *futex)
+{
+	syscall (SYS_futex, &futex->word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/** Set bits in futex->word and wake whoever sleeps on it. */
+static inline void
+jack_futex_post (volatile jack_futex_t *futex, int32_t bits)
+{
+	__sync_fetch_and_or (&futex->word, bits);
+	jack_futex_wake (futex);
+}
+
+#endif /* __linux__ && !JACK_USE_MACH_THREADS */
+
+#endif /* __jack_futex_h__ */
@@ -60,6 +60,8 @@ extern void jack_info (const char *fmt, ...);
 #include <jack/transport.h>
 #include <jack/session.h>
 #include <jack/thread.h>
+#include <jack/statistics.h>
+#include <jack/futex.h>
 
 extern jack_thread_creator_t jack_thread_creator;
 
@@ -165,9 +167,55 @@ typedef struct {
 
 } POST_PACKED_STRUCTURE jack_frame_timer_t;
 
+/* Per-cycle statistics, written by the engine's process thread into
+ * a shared memory segment of its own and read by clients with
+ * jack_get_cycle_stats().  There is a single writer and readers never
+ * block it: a slot's seq is cleared before the slot is rewritten and
+ * set to the cycle number afterwards, so a reader can tell whether
+ * what it copied was overwritten meanwhile.  Client records go to a
+ * second ring, indexed by the running count in client_head.
+ */
+#define JACK_STATS_CYCLES  1024		/* power of two */
+#define JACK_STATS_CLIENTS (JACK_STATS_CYCLES * 8) /* power of two */
+
+/* bucket of a jack_timing_histogram_t for a duration */
+static inline unsigned int
+jack_timing_bucket (uint32_t usecs)
+{
+	unsigned int octave;
+
+	if (usecs < 4) {
+		return usecs;
+	}
+
+	octave = 31 - __builtin_clz (usecs);
+	if (octave > JACK_TIMING_BUCKETS / 4) {
+		return JACK_TIMING_BUCKETS - 1;
+	}
+
+	return 4 * (octave - 1) + ((usecs >> (octave - 2)) & 3);
+}
+
+typedef struct {
+    volatile uint64_t	  seq;		/* cycle number, 0 while written */
+    uint64_t		  first_client;	/* client_head before this cycle */
+    jack_cycle_stats_t	  stats;
+} jack_stats_slot_t;
+
+typedef struct {
+    volatile uint64_t	  cycle_head;	/* cycles written */
+    volatile uint64_t	  client_head;	/* client records written */
+    jack_stats_slot_t	  cycles[JACK_STATS_CYCLES];
+    jack_client_cycle_stats_t clients[JACK_STATS_CLIENTS];
+} jack_stats_ring_t;
+
 /* JACK engine shared memory data structure. */
 typedef struct {
 
+    jack_futex_t	  graph_futex JACK_FUTEX_ALIGNED; /* client completions */
+    volatile uint32_t	  port_name_changes; /* renames and aliases by clients */
+    volatile uint32_t	  port_generation; /* bumped on any port table change */
+
     jack_transport_state_t transport_state;
     volatile transport_command_t transport_cmd;
     transport_command_t	  previous_cmd;	/* previous transport_cmd */
@@ -199,12 +247,63 @@ typedef struct {
     float		  max_delayed_usecs;
     uint32_t		  port_max;
     int32_t		  engine_ok;
+    int8_t		  futex_wakeup;	/* clients woken via futexes */
+    uint32_t		  wakeup_syscalls_avoided; /* during last cycle */
+    jack_shm_registry_index_t stats_shm_index; /* jack_stats_ring_t */
     jack_port_type_id_t	  n_port_types;
     jack_port_type_info_t port_types[JACK_MAX_PORT_TYPES];
     jack_port_shared_t    ports[0];
 
 } POST_PACKED_STRUCTURE jack_control_t;
 
+/* Port name index, following ports[port_max] in the engine control
+ * segment.  It hashes the name and both aliases of every port in use
+ * into chains of entries (port id * 3 + which name).  Only the server
+ * writes it, with seq odd while it does so.  Clients rename ports and
+ * set aliases by writing shared memory directly and then bump
+ * port_name_changes; the server rebuilds the index when that no
+ * longer matches names_seen.  Readers must therefore verify whatever
+ * they find, and may only trust a miss if the index was neither
+ * stale nor modified during the lookup.
+ */
+#define JACK_PORT_INDEX_NONE 0xffffffffU
+
+typedef struct {
+    volatile uint32_t	  seq;
+    volatile uint32_t	  names_seen;	/* port_name_changes indexed */
+    uint32_t		  nbuckets;	/* power of two */
+    uint32_t		  nentries;	/* 3 * port_max */
+    /* followed by uint32_t heads[nbuckets] and next[nentries] */
+} jack_port_index_t;
+
+static inline jack_port_index_t *
+jack_port_index (jack_control_t *ctl)
+{
+	uintptr_t end = (uintptr_t) &ctl->ports[ctl->port_max];
+
+	return (jack_port_index_t *) ((end + 7) & ~(uintptr_t) 7);
+}
+
+static inline volatile uint32_t *
+jack_port_index_heads (jack_port_index_t *index)
+{
+	return (volatile uint32_t *) (index + 1);
+}
+
+static inline volatile uint32_t *
+jack_port_index_next (jack_port_index_t *index)
+{
+	return jack_port_index_heads (index) + index->nbuckets;
+}
+
+/* size of the index for port_max ports, including alignment */
+static inline size_t
+jack_port_index_size (unsigned int port_max, uint32_t nbuckets)
+{
+	return 7 + sizeof (jack_port_index_t)
+		+ sizeof (uint32_t) * (nbuckets + 3 * port_max);
+}
+
 typedef enum  {
   BufferSizeChange,
   SampleRateChange,
@@ -254,6 +353,10 @@ typedef enum {
 /* JACK client shared memory data structure. */
 typedef volatile struct {
 
+    jack_futex_t	graph_wake JACK_FUTEX_ALIGNED; /* w: engine and client r: client */
+    volatile int32_t	graph_done;       /* w: engine and client r: engine */
+    volatile uint32_t	graph_syscalls;   /* w: engine and client r: engine */
+
     volatile jack_client_id_t id;         /* w: engine r: engine and client */
     volatile jack_client_id_t uid;        /* w: engine r: engine and client */
     volatile jack_client_state_t state;   /* w: engine and client r: engine */
@@ -383,9 +486,26 @@ typedef enum {
 	GetClientByUUID = 26,
 	ReserveName = 30,
 	SessionReply = 31,
-	SessionHasCallback = 32
+	SessionHasCallback = 32,
+	GetClientTiming = 33,
+	ResetClientTiming = 34,
+	ConnectBatch = 35
 } RequestType;
 
+/* One operation of a ConnectBatch request.  External clients write
+ * nops of these to the request socket right after the request; the
+ * server answers with the request followed by nops int32_t statuses
+ * whenever the request status is >= 0.
+ */
+typedef struct {
+    int32_t connect;			/* 1: connect, 0: disconnect */
+    int32_t status;			/* written by the server */
+    char source_port[JACK_PORT_NAME_SIZE];
+    char destination_port[JACK_PORT_NAME_SIZE];
+} POST_PACKED_STRUCTURE jack_connection_op_t;
+
+#define JACK_CONNECTION_BATCH_MAX 4096
+
 struct _jack_request {
     
     //RequestType type;
@@ -421,6 +541,11 @@ struct _jack_request {
 				   comparing the 64 and 32 bit versions.
 				*/
 	} POST_PACKED_STRUCTURE port_connections;
+	struct {
+	    uint32_t nops;
+	    jack_connection_op_t *ops;	/* internal clients only, see
+					   port_connections above */
+	} POST_PACKED_STRUCTURE connect_batch;
 	struct {
 	    jack_client_id_t client_id;
 	    int32_t conditional;
@@ -429,6 +554,10 @@ struct _jack_request {
 	    char name[JACK_CLIENT_NAME_SIZE];
 	    jack_client_id_t uuid;
 	} POST_PACKED_STRUCTURE reservename;
+	struct {
+	    char name[JACK_CLIENT_NAME_SIZE];	/* empty: all clients */
+	    jack_client_timing_t timing;
+	} POST_PACKED_STRUCTURE client_timing;
 	struct {
 	    //jack_options_t options;
 	    uint32_t options;
@@ -463,9 +592,25 @@ typedef struct _jack_client_internal {
     JSList    *sortfeeds;    /* protected by engine->client_lock */
     int	       fedcount;
     int	       tfedcount;
+    unsigned int sort_index;	/* in engine->sort_order */
+    unsigned int sort_mark;	/* graph search scratch */
+
+    /* process timing, written by the engine RT thread only; the
+       server thread asks for a reset through timing_reset */
+    jack_client_timing_t timing;
+    volatile int timing_reset;
     jack_shm_info_t control_shm;
     unsigned long execution_order;
     struct  _jack_client_internal *next_client; /* not a linked list! */
+
+    /* parallel execution: distinct clients on the sortfeeds list, and
+       the number of distinct clients that feed this one. rebuilt by
+       jack_rechain_graph(), protected by engine->client_lock */
+    struct  _jack_client_internal **graph_feeds;
+    int        graph_nfeeds;
+    int        graph_feeds_max;
+    int        graph_fedcount;
+    int        graph_pending;   /* engine RT thread only */
     dlhandle handle;
     int     (*initialize)(jack_client_t*, const char*); /* int. clients only */
     void    (*finish)(void *);		/* internal clients only */
@@ -534,6 +679,11 @@ extern jack_port_t *jack_port_by_id_int (const jack_client_t *client,
 extern jack_port_t *jack_port_by_name_int (jack_client_t *client,
 					   const char *port_name);
 extern int jack_port_name_equals (jack_port_shared_t* port, const char* target);
+extern const char *jack_port_name_canonical (const char *target, char *buf,
+					     size_t size);
+extern uint32_t jack_port_name_hash (const char *name);
+extern int jack_port_index_find (jack_control_t *ctl, const char *name,
+				 jack_port_id_t *id);
 
 /** Get the size (in bytes) of the data structure used to store
  *  MIDI events internally. 
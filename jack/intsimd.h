@@ -52,5 +52,18 @@ void x86_sse_i2f (float *, const int *, int, float);
 
 void jack_port_set_funcs (void);
 
+/* audio port mixdown, see libjack/simd.c */
+
+/* Number of connections mixed in one pass over the mix buffer.  Larger
+ * fan-ins take one more pass per JACK_MIX_BATCH connections.
+ */
+#define JACK_MIX_BATCH 64
+
+typedef void (*jack_mix_func_t) (float *dest, const float * const *src,
+				 unsigned int nsrc, int add, int length);
+
+void jack_mix_generic (float *, const float * const *, unsigned int, int, int);
+jack_mix_func_t jack_mix_select (void);
+
 #endif /* __jack_intsimd_h__ */
 
@@ -823,6 +823,63 @@ int jack_disconnect (jack_client_t *,
 		     const char *source_port,
 		     const char *destination_port) JACK_OPTIONAL_WEAK_EXPORT;
 
+/**
+ * Start collecting connect and disconnect operations that will be
+ * sent to the server together by jack_connection_batch_commit().
+ *
+ * The server applies a committed batch while holding the graph lock
+ * and re-sorts the process graph once, instead of once per
+ * connection, so patchbays and session managers restoring large
+ * setups should prefer it to a loop over jack_connect().
+ *
+ * @return a new batch, or NULL on allocation failure
+ */
+jack_connection_batch_t *
+jack_connection_batch_begin (jack_client_t *) JACK_OPTIONAL_WEAK_EXPORT;
+
+/**
+ * Queue a jack_connect() of @a source_port to @a destination_port.
+ *
+ * @return 0 on success, otherwise a non-zero error code (the batch
+ * is full or out of memory)
+ */
+int jack_connection_batch_connect (jack_connection_batch_t *,
+				   const char *source_port,
+				   const char *destination_port) JACK_OPTIONAL_WEAK_EXPORT;
+
+/**
+ * Queue a jack_disconnect() of @a source_port from @a
+ * destination_port.
+ *
+ * @return 0 on success, otherwise a non-zero error code
+ */
+int jack_connection_batch_disconnect (jack_connection_batch_t *,
+				      const char *source_port,
+				      const char *destination_port) JACK_OPTIONAL_WEAK_EXPORT;
+
+/**
+ * Send the queued operations to the server and free the batch.
+ *
+ * All operations are checked first: if any of them names an unknown
+ * port, pairs ports of the wrong direction or type, or connects a
+ * port owned by an inactive client, nothing is changed.  Otherwise
+ * the operations are applied in the order they were queued.
+ *
+ * @param results if non-NULL, receives one result per queued
+ * operation: 0 on success, EEXIST for a connection that was already
+ * made, ECANCELED for a valid operation of a rejected batch, or -1.
+ *
+ * @return 0 if every operation succeeded, the number of failed
+ * operations, or -1 if the batch could not be delivered.
+ */
+int jack_connection_batch_commit (jack_connection_batch_t *,
+				  int *results) JACK_OPTIONAL_WEAK_EXPORT;
+
+/**
+ * Free a batch without sending it.
+ */
+void jack_connection_batch_abort (jack_connection_batch_t *) JACK_OPTIONAL_WEAK_EXPORT;
+
 /**
  * Perform the same function as jack_disconnect() using port handles
  * rather than names.  This avoids the name lookup inherent in the
@@ -1085,17 +1142,30 @@ int jack_recompute_total_latency (jack_client_t*, jack_port_t* port) JACK_OPTION
  * @param flags A value used to select ports by their flags.  
  * If zero, no selection based on flags will be carried out.
  *
+ * Patterns that are plain names, optionally anchored with ^ and $
+ * or followed by .*, are matched without compiling a regular
+ * expression, and a full "^client:port$" name is looked up directly.
+ *
  * @return a NULL-terminated array of ports that match the specified
  * arguments.  The caller is responsible for calling jack_free(3) any
  * non-NULL returned value.
  *
- * @see jack_port_name_size(), jack_port_type_size()
+ * @see jack_port_name_size(), jack_port_type_size(),
+ * jack_get_ports_generation()
  */
 const char **jack_get_ports (jack_client_t *, 
 			     const char *port_name_pattern, 
 			     const char *type_name_pattern, 
 			     unsigned long flags) JACK_OPTIONAL_WEAK_EXPORT;
 
+/**
+ * @return a number that changes whenever a port is registered,
+ * unregistered, renamed or given an alias.  Clients that call
+ * jack_get_ports() often may keep its results for as long as this
+ * stays the same.
+ */
+uint32_t jack_get_ports_generation (jack_client_t *) JACK_OPTIONAL_WEAK_EXPORT;
+
 /**
  * @return address of the jack_port_t named @a port_name.
  *
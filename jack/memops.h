@@ -39,6 +39,17 @@ typedef struct {
     float e[DITHER_BUF_SIZE];
 } dither_state_t;
 
+/* The integer conversions do their arithmetic with kernels chosen for
+   the CPU at run time. memops_use_kernels() selects a set by name --
+   "generic", "sse2", "avx2" or "neon" -- or the best one available for
+   NULL, and returns -1 if the named set cannot run here. It also
+   restarts the dither noise sequence, so that the output of different
+   sets can be compared. memops_kernels_name() tells which set is in
+   use.
+*/
+int         memops_use_kernels (const char *name);
+const char *memops_kernels_name (void);
+
 /* float functions */
 void sample_move_floatLE_sSs (jack_default_audio_sample_t *dst, char *src, unsigned long nsamples, unsigned long dst_skip);
 void sample_move_dS_floatLE (char *dst, jack_default_audio_sample_t *src, unsigned long nsamples, unsigned long dst_skip, dither_state_t *state);
@@ -108,7 +108,8 @@ jack_midi_max_event_size(void* port_buffer) JACK_OPTIONAL_WEAK_EXPORT;
  *
  * Events must be written in order, sorted by their sample offsets.
  * JACK will not sort the events for you, and will refuse to store 
- * out-of-order events.
+ * out-of-order events, unless the buffer is in @ref JackMidiSortEvents
+ * mode (see @ref jack_midi_set_buffer_mode).
  *
  * @param port_buffer Buffer to write event to.
  * @param time Sample offset of event.
@@ -135,7 +136,8 @@ jack_midi_event_reserve(void           *port_buffer,
  *
  * Events must be written in order, sorted by their sample offsets.
  * JACK will not sort the events for you, and will refuse to store 
- * out-of-order events.
+ * out-of-order events, unless the buffer is in @ref JackMidiSortEvents
+ * mode (see @ref jack_midi_set_buffer_mode).
  *
  * @param port_buffer Buffer to write event to.
  * @param time Sample offset of event.
@@ -150,6 +152,118 @@ jack_midi_event_write(void                   *port_buffer,
                       size_t                  data_size) JACK_OPTIONAL_WEAK_EXPORT;
 
 
+/** Write a sequence of events to an event port buffer.
+ *
+ * This has the same effect as calling @ref jack_midi_event_write for each
+ * event in turn, but checks the order and the space the events need in
+ * one pass and then copies them in, which is cheaper when a client has
+ * several events to write at once.  The events must be sorted by their
+ * sample offsets, and no earlier than any event already in the buffer,
+ * unless a mode is set with @ref jack_midi_set_buffer_mode, in which case
+ * they are written one at a time.
+ *
+ * Writing stops at the first event that cannot be stored; it and the
+ * events after it are counted as lost (see
+ * @ref jack_midi_get_lost_event_count).
+ *
+ * @param port_buffer Buffer to write the events to.
+ * @param events Events to write.
+ * @param event_count Number of events in @a events.
+ * @return Number of events written, from the start of @a events.
+ */
+uint32_t
+jack_midi_event_write_batch(void                    *port_buffer,
+                            const jack_midi_event_t *events,
+                            uint32_t                 event_count) JACK_OPTIONAL_WEAK_EXPORT;
+
+
+/** An iterator over the events of a port buffer.
+ *
+ * The members are private; use @ref jack_midi_iterator_init and
+ * @ref jack_midi_iterator_next.
+ */
+typedef struct _jack_midi_iterator
+{
+	void     *port_buffer;
+	void     *next;
+	uint32_t  remaining;
+} jack_midi_iterator_t;
+
+
+/** Start iterating over the events of a port buffer.
+ *
+ * @param iterator Iterator to initialise.
+ * @param port_buffer Port buffer to read the events of.
+ */
+void
+jack_midi_iterator_init(jack_midi_iterator_t *iterator,
+                        void                 *port_buffer) JACK_OPTIONAL_WEAK_EXPORT;
+
+
+/** Get the next event of a port buffer.
+ *
+ * Reading every event of a buffer this way is cheaper than calling
+ * @ref jack_midi_event_get for each index.  The event's data is not
+ * copied; @a event points into the port buffer as it does for
+ * @ref jack_midi_event_get.
+ *
+ * @param iterator Iterator set up by @ref jack_midi_iterator_init.
+ * @param event Event structure to store the next event in.
+ * @return 0 on success, ENODATA if there are no more events.
+ */
+int
+jack_midi_iterator_next(jack_midi_iterator_t *iterator,
+                        jack_midi_event_t    *event) JACK_OPTIONAL_WEAK_EXPORT;
+
+
+/** Flags for @ref jack_midi_set_buffer_mode. */
+enum JackMidiBufferMode {
+
+	/** Events may be written in any order.  An event earlier than
+	 * events already in the buffer is inserted after the events at its
+	 * time or before, instead of being refused. */
+	JackMidiSortEvents = 0x1,
+
+	/** A control change written by @ref jack_midi_event_write replaces
+	 * the value of a change of the same controller on the same channel
+	 * at the same time, if only control changes lie between them,
+	 * instead of taking more space.  Data entry, data increment and
+	 * decrement and the (N)RPN number controllers are never merged. */
+	JackMidiCoalesceControllers = 0x2
+};
+
+
+/** Set how events written to an event port buffer are stored.
+ *
+ * The mode is a combination of @ref JackMidiBufferMode flags, and is 0,
+ * where events must be written in order and are stored as they are, when
+ * the buffer is created.  It is kept by @ref jack_midi_clear_buffer, but
+ * the buffer is created again when the buffer size changes, so clients
+ * are best to set it in every process cycle.  It applies only to the
+ * buffer of an output port.
+ *
+ * Sorting makes writing an event that is out of order take time linear in
+ * the number of events in the buffer.
+ *
+ * @param port_buffer Port buffer to set the mode of (must be an output
+ * port buffer).
+ * @param mode JackMidiBufferMode flags.
+ * @return 0 on success, EINVAL if @a mode has unknown flags.
+ */
+int
+jack_midi_set_buffer_mode(void     *port_buffer,
+                          uint32_t  mode) JACK_OPTIONAL_WEAK_EXPORT;
+
+
+/** Get the mode set by @ref jack_midi_set_buffer_mode.
+ *
+ * @param port_buffer Port buffer to get the mode of.
+ * @return JackMidiBufferMode flags.
+ */
+uint32_t
+jack_midi_get_buffer_mode(void           *port_buffer) JACK_OPTIONAL_WEAK_EXPORT;
+
+
 /** Get the number of events that could not be written to @a port_buffer.
  *
  * This function returning a non-zero value implies @a port_buffer is full.
@@ -49,6 +49,160 @@ float jack_get_xrun_delayed_usecs (jack_client_t *client);
  */
 void jack_reset_max_delayed_usecs (jack_client_t *client);
 
+/**
+ * @return the number of system calls the server saved during the
+ * most recent process cycle by waking clients through shared memory
+ * futexes instead of FIFOs, compared with what the FIFO handshake
+ * would have cost for the same clients.  Always 0 unless the server
+ * runs with futex wakeups enabled.
+ */
+uint32_t jack_get_wakeup_syscalls_avoided (jack_client_t *client);
+
+/**
+ * Flags of a jack_cycle_stats_t.
+ */
+enum JackCycleFlags {
+	/** the backend reported an xrun since the previous cycle */
+	JackCycleXRun = 0x1,
+	/** a client failed or timed out during the cycle */
+	JackCycleClientError = 0x2,
+	/** the cycle ended after the next expected driver wakeup */
+	JackCycleLate = 0x4
+};
+
+/**
+ * Flags of a jack_client_cycle_stats_t.
+ */
+enum JackClientCycleFlags {
+	/** the client had not finished when the cycle ended */
+	JackClientCycleTimedOut = 0x1
+};
+
+/**
+ * Timing of one process cycle of the server.  All times are in
+ * microseconds, as returned by jack_get_time().
+ */
+typedef struct {
+	uint64_t       cycle;		/**< sequence number, counts from 1 */
+	jack_time_t    wakeup;		/**< when the driver wait returned */
+	float          driver_wait_usecs; /**< end of previous cycle to wakeup */
+	float          delayed_usecs;	/**< wakeup delay reported by the driver */
+	float          process_usecs;	/**< wakeup to end of cycle */
+	jack_nframes_t nframes;		/**< frames processed */
+	uint32_t       flags;		/**< JackCycleFlags */
+	uint32_t       nclients;	/**< number of client records */
+	jack_nframes_t buffered_frames;	/**< audio the driver held ahead of the
+					     cycle, 0 if it does not say */
+	float          rate_ratio;	/**< the driver's clock correction,
+					     remote over local rate, 0 if none */
+} jack_cycle_stats_t;
+
+/** Size of jack_client_cycle_stats_t.name, see jack_client_name_size() */
+#define JACK_CYCLE_STATS_NAME_SIZE 33
+
+/**
+ * Timing of one external client during one process cycle.
+ */
+typedef struct {
+	uint32_t       flags;		/**< JackClientCycleFlags */
+	float          wake_usecs;	/**< from being signalled to running */
+	float          run_usecs;	/**< from running to finished */
+	char           name[JACK_CYCLE_STATS_NAME_SIZE]; /**< client name */
+} jack_client_cycle_stats_t;
+
+/**
+ * Copy the per-cycle statistics the server publishes in shared
+ * memory, without a request to the server.  The server keeps the
+ * most recent cycles in a ring; readers that fall behind silently
+ * lose the oldest ones, which shows as a gap in the cycle numbers.
+ *
+ * Start with *next_cycle set to 0.  Each call copies up to @a
+ * max_cycles cycles from *next_cycle onwards into @a cycles, and
+ * their client records into @a clients, cycles[0]'s first, then
+ * cycles[1]'s and so on.  It stops early when @a clients is full,
+ * and sets *next_cycle to the cycle to ask for next time.
+ *
+ * This function must not be called from the process thread: the
+ * first call attaches the shared memory segment.
+ *
+ * @return the number of cycles copied, or -1 if the statistics are
+ * not available.
+ */
+int jack_get_cycle_stats (jack_client_t *client, uint64_t *next_cycle,
+			  jack_cycle_stats_t *cycles,
+			  unsigned int max_cycles,
+			  jack_client_cycle_stats_t *clients,
+			  unsigned int max_clients);
+
+/**
+ * Number of buckets in a jack_timing_histogram_t.  Buckets are
+ * logarithmic with four steps per octave: bucket i counts durations
+ * from jack_timing_histogram_bucket_usecs(i) up to, but excluding,
+ * that of bucket i+1.  Bucket 0 starts at 0, the last one at
+ * 114688 usecs and has no upper bound: durations of about 131 ms and
+ * more all land there, only max_usecs tells them apart.
+ */
+#define JACK_TIMING_BUCKETS 64
+
+/**
+ * Distribution of one kind of duration, in microseconds.
+ */
+typedef struct {
+	uint64_t count;			/**< durations recorded */
+	uint64_t total_usecs;		/**< their sum */
+	float    max_usecs;		/**< the longest one */
+	uint32_t timeouts;		/**< how many hit the client timeout */
+	uint32_t buckets[JACK_TIMING_BUCKETS];
+} jack_timing_histogram_t;
+
+/**
+ * Process cycle timing of one client, as measured by the server.
+ */
+typedef struct {
+	/** from being signalled by the server (or the client before
+	 * it in the chain) to running its process thread */
+	jack_timing_histogram_t wake;
+	/** from running to having finished its process cycle */
+	jack_timing_histogram_t run;
+} jack_client_timing_t;
+
+/**
+ * Get the timing histograms the server keeps for an external client
+ * since it was created or since jack_reset_client_timing().  This
+ * is a request to the server, do not call it from the process thread.
+ *
+ * @param client_name name of the client to query, which need not be
+ * @a client itself.
+ *
+ * @return 0 on success, otherwise a non-zero error code (no such client).
+ */
+int jack_get_client_timing (jack_client_t *client, const char *client_name,
+			    jack_client_timing_t *timing);
+
+/**
+ * Clear the timing histograms of a client, or of all clients if
+ * @a client_name is NULL.
+ *
+ * @return 0 on success, otherwise a non-zero error code (no such client).
+ */
+int jack_reset_client_timing (jack_client_t *client, const char *client_name);
+
+/**
+ * @return the shortest duration, in microseconds, that is counted in
+ * @a bucket of a jack_timing_histogram_t.
+ */
+float jack_timing_histogram_bucket_usecs (unsigned int bucket);
+
+/**
+ * Estimate a percentile of a timing histogram, e.g. 99.9 for the
+ * p99.9.  The result is the upper edge of the bucket the percentile
+ * falls in, but never more than max_usecs.
+ *
+ * @return the duration in microseconds, 0 if the histogram is empty.
+ */
+float jack_timing_histogram_percentile (const jack_timing_histogram_t *hist,
+					float percentile);
+
 #ifdef __cplusplus
 }
 #endif
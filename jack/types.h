@@ -68,6 +68,12 @@ typedef struct _jack_port    jack_port_t;
  */
 typedef struct _jack_client  jack_client_t;
 
+/**
+ *  jack_connection_batch_t is an opaque type.  You may only access it
+ *  using the API provided.
+ */
+typedef struct _jack_connection_batch jack_connection_batch_t;
+
 /**
  *  Ports have unique ids. A port registration callback is the only
  *  place you ever need to know their value.
@@ -47,6 +47,7 @@
 #include <jack/thread.h>
 #include <jack/varargs.h>
 #include <jack/intsimd.h>
+#include <jack/futex.h>
 #include <jack/messagebuffer.h>
 
 #include <sysdeps/time.h>
@@ -330,9 +331,12 @@ jack_client_alloc ()
 	client->on_info_shutdown = NULL;
 	client->n_port_types = 0;
 	client->port_segment = NULL;
+	client->stats = NULL;
 
 #ifdef USE_DYNSIMD
 	init_cpu();
+#else /* !USE_DYNSIMD */
+	jack_port_set_funcs();
 #endif /* USE_DYNSIMD */
 
 	return client;
@@ -369,9 +373,12 @@ jack_client_alloc ()
 	client->on_info_shutdown = NULL;
 	client->n_port_types = 0;
 	client->port_segment = NULL;
+	client->stats = NULL;
 
 #ifdef USE_DYNSIMD
 	init_cpu();
+#else /* !USE_DYNSIMD */
+	jack_port_set_funcs();
 #endif /* USE_DYNSIMD */
 
 	return client;
@@ -394,6 +401,7 @@ jack_client_alloc_internal (jack_client_control_t *cc, jack_engine_t* engine)
 	
 	client->n_port_types = client->engine->n_port_types;
 	client->port_segment = &engine->port_segment[0];
+	client->stats = engine->stats;
 
 	return client;
 }
@@ -724,6 +732,23 @@ jack_handle_reorder (jack_client_t *client, jack_event_t *event)
 		client->graph_next_fd = -1;
 	}
 
+#ifdef JACK_USE_FUTEX
+	if (client->engine->futex_wakeup) {
+
+		/* the server wakes us through control->graph_wake,
+		   there are no FIFOs to open */
+
+		client->upstream_is_jackd = event->y.n;
+		client->pollmax = 1;
+
+		if (client->control->graph_order_cbset) {
+			client->graph_order (client->graph_order_arg);
+		}
+
+		return 0;
+	}
+#endif /* JACK_USE_FUTEX */
+
 	sprintf (path, "%s-%" PRIu32, client->fifo_prefix, event->x.n);
 	
 	if ((client->graph_wait_fd = open (path, O_RDONLY|O_NONBLOCK)) < 0) {
@@ -1915,6 +1940,21 @@ jack_wake_next_client (jack_client_t* client)
 	int pret = 0;
 	char c = 0;
 
+#ifdef JACK_USE_FUTEX
+	if (client->engine->futex_wakeup) {
+
+		/* the server is always our downstream: mark this
+		   client done, then wake the server if it sleeps */
+
+		client->control->graph_syscalls++;
+		__sync_synchronize ();
+		client->control->graph_done = 1;
+		__sync_fetch_and_add (&client->engine->graph_futex.word, 1);
+		jack_futex_wake (&client->engine->graph_futex);
+		return 0;
+	}
+#endif /* JACK_USE_FUTEX */
+
 	if (write (client->graph_next_fd, &c, sizeof (c))
 	    != sizeof (c)) {
 		DEBUG("cannot write byte to fd %d", client->graph_next_fd);
@@ -1998,11 +2038,89 @@ jack_client_core_wait (jack_client_t* client)
 
 #else /* !JACK_USE_MACH_THREADS */
 
+#ifdef JACK_USE_FUTEX
+
+/* Futex version of jack_client_core_wait(): the server sets bits in
+ * control->graph_wake for process wakeups and for events waiting on
+ * the event socket, so only one of them costs a system call.
+ */
+static int
+jack_client_futex_wait (jack_client_t* client)
+{
+	jack_client_control_t *control = client->control;
+	int32_t wake;
+
+	while (1) {
+		wake = __sync_lock_test_and_set (&control->graph_wake.word, 0);
+
+		if (wake == 0) {
+			int ret = jack_futex_wait (&control->graph_wake, 0,
+						   1000000);
+			control->graph_syscalls++;
+
+			if (ret == 0) {
+				continue;
+			}
+
+			if (errno != ETIMEDOUT && errno != EINTR) {
+				jack_error ("futex wait failed in client (%s)",
+					    strerror (errno));
+				return -1;
+			}
+
+			/* check the event socket anyway, like the
+			   poll(2) timeout in jack_client_core_wait()
+			   does */
+			wake = JACK_WAKE_EVENT;
+		}
+
+		pthread_testcancel();
+
+		if (wake & JACK_WAKE_PROCESS) {
+			control->awake_at = jack_get_microseconds();
+		}
+
+		if (wake & JACK_WAKE_EVENT) {
+			if (poll (client->pollfd, 1, 0) < 0 &&
+			    errno != EINTR) {
+				jack_error ("poll failed in client (%s)",
+					    strerror (errno));
+				return -1;
+			}
+
+			if (jack_client_process_events (client)) {
+				DEBUG ("event processing failed\n");
+				return 0;
+			}
+
+			if (control->dead ||
+			    client->pollfd[EVENT_POLL_INDEX].revents & ~POLLIN) {
+				DEBUG ("client appears dead or event pollfd "
+				       "has error status\n");
+				return -1;
+			}
+		}
+
+		if (wake & JACK_WAKE_PROCESS) {
+			DEBUG ("time to run process()\n");
+			return 0;
+		}
+	}
+}
+
+#endif /* JACK_USE_FUTEX */
+
 static int
 jack_client_core_wait (jack_client_t* client)
 {
 	jack_client_control_t *control = client->control;
 
+#ifdef JACK_USE_FUTEX
+	if (client->engine->futex_wakeup) {
+		return jack_client_futex_wait (client);
+	}
+#endif /* JACK_USE_FUTEX */
+
         /* this is not OS X - we're waiting on events & process wakeups */
 
 	DEBUG ("client polling on %s", client->pollmax == 2 ?
@@ -2650,6 +2768,14 @@ jack_client_close_aux (jack_client_t *client)
 		
 		if (client->thread_ok){
 			pthread_cancel (client->thread);
+#ifdef JACK_USE_FUTEX
+			/* a futex wait is not a cancellation point:
+			   wake the thread so that it reaches one */
+			if (client->engine->futex_wakeup) {
+				jack_futex_post (&client->control->graph_wake,
+						 JACK_WAKE_EVENT);
+			}
+#endif /* JACK_USE_FUTEX */
 			pthread_join (client->thread, &status);
 		}
 
@@ -2661,6 +2787,10 @@ jack_client_close_aux (jack_client_t *client)
 			jack_release_shm (&client->engine_shm);
 			client->engine = NULL;
 		}
+		if (client->stats) {
+			jack_release_shm (&client->stats_shm);
+			client->stats = NULL;
+		}
 
 		if (client->port_segment) {
 			jack_port_type_id_t ptid;
@@ -2805,6 +2935,195 @@ jack_disconnect (jack_client_t *client, const char *source_port,
 	return jack_client_deliver_request (client, &req);
 }
 
+struct _jack_connection_batch {
+	jack_client_t *client;
+	jack_connection_op_t *ops;
+	uint32_t nops;
+	uint32_t nalloc;
+};
+
+jack_connection_batch_t *
+jack_connection_batch_begin (jack_client_t *client)
+{
+	jack_connection_batch_t *batch;
+
+	if ((batch = (jack_connection_batch_t *)
+	     calloc (1, sizeof (jack_connection_batch_t))) == NULL) {
+		return NULL;
+	}
+
+	batch->client = client;
+
+	return batch;
+}
+
+static int
+jack_connection_batch_add (jack_connection_batch_t *batch, int connect,
+			   const char *source_port,
+			   const char *destination_port)
+{
+	jack_connection_op_t *op;
+
+	if (batch->nops == JACK_CONNECTION_BATCH_MAX) {
+		jack_error ("too many operations in connection batch (max %d)",
+			    JACK_CONNECTION_BATCH_MAX);
+		return ENOSPC;
+	}
+
+	if (batch->nops == batch->nalloc) {
+		uint32_t nalloc = batch->nalloc ? batch->nalloc * 2 : 16;
+
+		if ((op = (jack_connection_op_t *)
+		     realloc (batch->ops, nalloc * sizeof (*op))) == NULL) {
+			return ENOMEM;
+		}
+		batch->ops = op;
+		batch->nalloc = nalloc;
+	}
+
+	op = &batch->ops[batch->nops++];
+
+	VALGRIND_MEMSET (op, 0, sizeof (*op));
+
+	op->connect = connect;
+	op->status = 0;
+	snprintf (op->source_port, sizeof (op->source_port), "%s",
+		  source_port);
+	snprintf (op->destination_port, sizeof (op->destination_port), "%s",
+		  destination_port);
+
+	return 0;
+}
+
+int
+jack_connection_batch_connect (jack_connection_batch_t *batch,
+			       const char *source_port,
+			       const char *destination_port)
+{
+	return jack_connection_batch_add (batch, 1, source_port,
+					  destination_port);
+}
+
+int
+jack_connection_batch_disconnect (jack_connection_batch_t *batch,
+				  const char *source_port,
+				  const char *destination_port)
+{
+	return jack_connection_batch_add (batch, 0, source_port,
+					  destination_port);
+}
+
+static int
+jack_connection_batch_io (int fd, void *buf, size_t len, int out)
+{
+	ssize_t n;
+
+	while (len) {
+		n = out ? write (fd, buf, len) : read (fd, buf, len);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf = (char *) buf + n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* External clients send the operations after the request and get
+ * their statuses back after the reply, see jack_connection_op_t.
+ */
+static int
+oop_connection_batch_deliver (jack_client_t *client, jack_request_t *req,
+			      jack_connection_op_t *ops)
+{
+	uint32_t nops = req->x.connect_batch.nops;
+	int32_t status[64];
+	uint32_t i, j, n;
+
+	if (jack_connection_batch_io (client->request_fd, req,
+				      sizeof (*req), 1) ||
+	    jack_connection_batch_io (client->request_fd, ops,
+				      nops * sizeof (*ops), 1)) {
+		jack_error ("cannot send connection batch to server (%s)",
+			    strerror (errno));
+		return -1;
+	}
+
+	if (jack_connection_batch_io (client->request_fd, req,
+				      sizeof (*req), 0)) {
+		jack_error ("cannot read connection batch result from"
+			    " server (%s)", strerror (errno));
+		return -1;
+	}
+
+	/* a failed batch comes without statuses */
+	if (req->status < 0) {
+		return req->status;
+	}
+
+	for (i = 0; i < nops; i += n) {
+		n = nops - i;
+		if (n > sizeof (status) / sizeof (status[0])) {
+			n = sizeof (status) / sizeof (status[0]);
+		}
+		if (jack_connection_batch_io (client->request_fd, status,
+					      sizeof (int32_t) * n, 0)) {
+			jack_error ("cannot read connection batch statuses"
+				    " from server");
+			return -1;
+		}
+		for (j = 0; j < n; j++) {
+			ops[i + j].status = status[j];
+		}
+	}
+
+	return req->status;
+}
+
+int
+jack_connection_batch_commit (jack_connection_batch_t *batch, int *results)
+{
+	jack_client_t *client = batch->client;
+	jack_request_t req;
+	uint32_t i;
+	int ret;
+
+        VALGRIND_MEMSET (&req, 0, sizeof (req));
+
+	req.type = ConnectBatch;
+	req.x.connect_batch.nops = batch->nops;
+
+	if (client->request_fd < 0) {
+		/* internal client: the server reads our operations
+		 * and writes their statuses in place */
+		req.x.connect_batch.ops = batch->ops;
+		ret = jack_client_deliver_request (client, &req);
+	} else {
+		ret = oop_connection_batch_deliver (client, &req, batch->ops);
+	}
+
+	if (results) {
+		for (i = 0; i < batch->nops; i++) {
+			results[i] = (ret < 0) ? -1 : batch->ops[i].status;
+		}
+	}
+
+	jack_connection_batch_abort (batch);
+
+	return ret;
+}
+
+void
+jack_connection_batch_abort (jack_connection_batch_t *batch)
+{
+	free (batch->ops);
+	free (batch);
+}
+
 void
 jack_set_error_function (void (*func) (const char *))
 {
@@ -3073,6 +3392,131 @@ jack_reserve_client_name( jack_client_t *client, const char *name, const char *u
 	return jack_client_deliver_request( client, &request );
 }
 
+/* A port or type name pattern.  Most callers pass plain names,
+ * optionally anchored with ^ and $, which are matched without the
+ * regex engine; anything else is compiled as before.
+ */
+typedef enum {
+	JackPatternAny,
+	JackPatternExact,
+	JackPatternPrefix,
+	JackPatternSuffix,
+	JackPatternSubstring,
+	JackPatternRegex
+} jack_pattern_kind_t;
+
+typedef struct {
+	jack_pattern_kind_t kind;
+	size_t len;
+	char literal[JACK_PORT_NAME_SIZE+1];
+	regex_t regex;
+} jack_port_pattern_t;
+
+static int
+jack_port_pattern_compile (jack_port_pattern_t *pat, const char *pattern)
+{
+	const char *p = pattern;
+	const char *end;
+	int anchored_start = 0;
+	int anchored_end = 0;
+
+	pat->kind = JackPatternAny;
+	pat->len = 0;
+
+	if (pattern == NULL || pattern[0] == '\0') {
+		return 0;
+	}
+
+	end = pattern + strlen (pattern);
+
+	if (*p == '^') {
+		anchored_start = 1;
+		p++;
+	}
+
+	if (end > p && end[-1] == '$' && (end - 1 == p || end[-2] != '\\')) {
+		anchored_end = 1;
+		end--;
+	} else if (end - p >= 2 && end[-2] == '.' && end[-1] == '*' &&
+		   (end - 2 == p || end[-3] != '\\')) {
+		/* "name.*" matches just like "name" */
+		end -= 2;
+	}
+
+	while (p < end) {
+		if (pat->len == JACK_PORT_NAME_SIZE) {
+			goto regex;
+		}
+		if (*p == '\\') {
+			if (p + 1 == end || !strchr (".[]()*+?{}|^$\\", p[1])) {
+				goto regex;
+			}
+			p++;
+		} else if (strchr (".[]()*+?{}|^$", *p)) {
+			goto regex;
+		}
+		pat->literal[pat->len++] = *p++;
+	}
+
+	pat->literal[pat->len] = '\0';
+
+	if (anchored_start && anchored_end) {
+		pat->kind = JackPatternExact;
+	} else if (pat->len == 0) {
+		pat->kind = JackPatternAny;
+	} else if (anchored_start) {
+		pat->kind = JackPatternPrefix;
+	} else if (anchored_end) {
+		pat->kind = JackPatternSuffix;
+	} else {
+		pat->kind = JackPatternSubstring;
+	}
+
+	return 0;
+
+  regex:
+	pat->kind = JackPatternRegex;
+
+	if (regcomp (&pat->regex, pattern, REG_EXTENDED|REG_NOSUB)) {
+		jack_error ("invalid port search pattern \"%s\"", pattern);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+jack_port_pattern_match (jack_port_pattern_t *pat, const char *name)
+{
+	size_t len;
+
+	switch (pat->kind) {
+	case JackPatternAny:
+		return 1;
+	case JackPatternExact:
+		return strcmp (name, pat->literal) == 0;
+	case JackPatternPrefix:
+		return strncmp (name, pat->literal, pat->len) == 0;
+	case JackPatternSuffix:
+		len = strlen (name);
+		return len >= pat->len &&
+			memcmp (name + len - pat->len, pat->literal,
+				pat->len) == 0;
+	case JackPatternSubstring:
+		return strstr (name, pat->literal) != NULL;
+	default:
+		return regexec (&pat->regex, name, 0, NULL, 0) == 0;
+	}
+}
+
+static void
+jack_port_pattern_free (jack_port_pattern_t *pat)
+{
+	if (pat->kind == JackPatternRegex) {
+		regfree (&pat->regex);
+	}
+}
+
 const char **
 jack_get_ports (jack_client_t *client,
 		const char *port_name_pattern,
@@ -3083,67 +3527,83 @@ jack_get_ports (jack_client_t *client,
 	const char **matching_ports;
 	unsigned long match_cnt;
 	jack_port_shared_t *psp;
-	unsigned long i;
-	regex_t port_regex;
-	regex_t type_regex;
-	int matching;
+	unsigned long i, first, last;
+	jack_port_pattern_t port_pat;
+	jack_port_pattern_t type_pat;
+	char type_ok[JACK_MAX_PORT_TYPES];
+	jack_port_id_t id;
 
 	engine = client->engine;
 
-	if (port_name_pattern && port_name_pattern[0]) {
-		regcomp (&port_regex, port_name_pattern,
-			 REG_EXTENDED|REG_NOSUB);
+	if (jack_port_pattern_compile (&port_pat, port_name_pattern)) {
+		return NULL;
 	}
-	if (type_name_pattern && type_name_pattern[0]) {
-		regcomp (&type_regex, type_name_pattern,
-			 REG_EXTENDED|REG_NOSUB);
+	if (jack_port_pattern_compile (&type_pat, type_name_pattern)) {
+		jack_port_pattern_free (&port_pat);
+		return NULL;
+	}
+
+	/* there are only a few types: match them once */
+	for (i = 0; i < JACK_MAX_PORT_TYPES; i++) {
+		type_ok[i] = (i < (unsigned long) engine->n_port_types &&
+			      jack_port_pattern_match (
+				      &type_pat, engine->port_types[i].type_name));
 	}
 
 	psp = engine->ports;
 	match_cnt = 0;
+	first = 0;
+	last = engine->port_max;
+
+	if (port_pat.kind == JackPatternExact) {
+
+		/* a full port name: ask the name index first. it also
+		 * knows aliases, so only trust a hit on the name
+		 * itself, and scan if it cannot tell */
+
+		switch (jack_port_index_find (engine, port_pat.literal, &id)) {
+		case 0:
+			last = 0;
+			break;
+		case 1:
+			if (strcmp (psp[id].name, port_pat.literal) == 0) {
+				first = id;
+				last = id + 1;
+			}
+			break;
+		default:
+			break;
+		}
+	}
 
-	if ((matching_ports = (const char **) malloc (sizeof (char *) * (engine->port_max + 1))) == NULL) {
+	if ((matching_ports = (const char **) malloc (sizeof (char *) * (last - first + 1))) == NULL) {
+		jack_port_pattern_free (&port_pat);
+		jack_port_pattern_free (&type_pat);
 		return NULL;
 	}
 
-	for (i = 0; i < engine->port_max; i++) {
-		matching = 1;
+	for (i = first; i < last; i++) {
 
 		if (!psp[i].in_use) {
 			continue;
 		}
 
-		if (flags) {
-			if ((psp[i].flags & flags) != flags) {
-				matching = 0;
-			}
+		if (flags && (psp[i].flags & flags) != flags) {
+			continue;
 		}
 
-		if (matching && port_name_pattern && port_name_pattern[0]) {
-			if (regexec (&port_regex, psp[i].name, 0, NULL, 0)) {
-				matching = 0;
-			}
-		} 
+		if (psp[i].ptype_id >= JACK_MAX_PORT_TYPES ||
+		    !type_ok[psp[i].ptype_id]) {
+			continue;
+		}
 
-		if (matching && type_name_pattern && type_name_pattern[0]) {
-			jack_port_type_id_t ptid = psp[i].ptype_id;
-			if (regexec (&type_regex,
-				     engine->port_types[ptid].type_name,
-				     0, NULL, 0)) {
-				matching = 0;
-			}
-		} 
-		
-		if (matching) {
+		if (jack_port_pattern_match (&port_pat, psp[i].name)) {
 			matching_ports[match_cnt++] = psp[i].name;
 		}
 	}
-	if (port_name_pattern && port_name_pattern[0]) {
-		regfree (&port_regex);
-	}
-	if (type_name_pattern && type_name_pattern[0]) {
-		regfree (&type_regex);
-	}
+
+	jack_port_pattern_free (&port_pat);
+	jack_port_pattern_free (&type_pat);
 
 	if (match_cnt == 0) {
 		free (matching_ports);
@@ -3155,6 +3615,13 @@ jack_get_ports (jack_client_t *client,
 	return matching_ports;
 }
 
+uint32_t
+jack_get_ports_generation (jack_client_t *client)
+{
+	__sync_synchronize ();
+	return client->engine->port_generation;
+}
+
 float
 jack_cpu_load (jack_client_t *client)
 {
@@ -3179,6 +3646,165 @@ jack_reset_max_delayed_usecs (jack_client_t *client)
 	client->engine->max_delayed_usecs =  0.0f;
 }
 
+uint32_t
+jack_get_wakeup_syscalls_avoided (jack_client_t *client)
+{
+	return client->engine->wakeup_syscalls_avoided;
+}
+
+int
+jack_get_cycle_stats (jack_client_t *client, uint64_t *next_cycle,
+		      jack_cycle_stats_t *cycles, unsigned int max_cycles,
+		      jack_client_cycle_stats_t *clients,
+		      unsigned int max_clients)
+{
+	jack_stats_ring_t *ring;
+	jack_stats_slot_t *slot;
+	jack_cycle_stats_t stats;
+	uint64_t head, cycle, first;
+	unsigned int ncycles = 0;
+	unsigned int nclients = 0;
+	unsigned int i;
+
+	if (client->stats == NULL) {
+		client->stats_shm.index = client->engine->stats_shm_index;
+		if (jack_attach_shm (&client->stats_shm)) {
+			jack_error ("cannot attach statistics segment (%s)",
+				    strerror (errno));
+			return -1;
+		}
+		client->stats = (jack_stats_ring_t *)
+			jack_shm_addr (&client->stats_shm);
+	}
+
+	ring = client->stats;
+	head = ring->cycle_head;
+	__sync_synchronize ();
+
+	/* skip what the server has overwritten already */
+	cycle = *next_cycle;
+	if (cycle + JACK_STATS_CYCLES <= head) {
+		cycle = head - JACK_STATS_CYCLES + 1;
+	}
+	if (cycle == 0) {
+		cycle = 1;
+	}
+
+	for (; cycle <= head && ncycles < max_cycles; cycle++) {
+
+		slot = &ring->cycles[cycle & (JACK_STATS_CYCLES - 1)];
+
+		if (slot->seq != cycle) {
+			continue;
+		}
+		__sync_synchronize ();
+		stats = slot->stats;
+		first = slot->first_client;
+		__sync_synchronize ();
+		if (slot->seq != cycle) {
+			continue;
+		}
+
+		if (stats.nclients > max_clients - nclients) {
+			if (ncycles) {
+				break;
+			}
+			/* cannot fit even on its own: truncate */
+			stats.nclients = max_clients;
+		}
+
+		for (i = 0; i < stats.nclients; i++) {
+			clients[nclients + i] = ring->clients[
+				(first + i) & (JACK_STATS_CLIENTS - 1)];
+		}
+		__sync_synchronize ();
+		if (ring->client_head - first > JACK_STATS_CLIENTS) {
+			continue;
+		}
+
+		cycles[ncycles++] = stats;
+		nclients += stats.nclients;
+	}
+
+	*next_cycle = cycle;
+
+	return ncycles;
+}
+
+int
+jack_get_client_timing (jack_client_t *client, const char *client_name,
+			jack_client_timing_t *timing)
+{
+	jack_request_t req;
+
+	VALGRIND_MEMSET (&req, 0, sizeof (req));
+
+	req.type = GetClientTiming;
+	snprintf (req.x.client_timing.name,
+		  sizeof (req.x.client_timing.name), "%s", client_name);
+
+	if (jack_client_deliver_request (client, &req)) {
+		return -1;
+	}
+
+	memcpy (timing, &req.x.client_timing.timing,
+		sizeof (jack_client_timing_t));
+	return 0;
+}
+
+int
+jack_reset_client_timing (jack_client_t *client, const char *client_name)
+{
+	jack_request_t req;
+
+	VALGRIND_MEMSET (&req, 0, sizeof (req));
+
+	req.type = ResetClientTiming;
+	snprintf (req.x.client_timing.name,
+		  sizeof (req.x.client_timing.name), "%s",
+		  client_name ? client_name : "");
+
+	return jack_client_deliver_request (client, &req);
+}
+
+float
+jack_timing_histogram_bucket_usecs (unsigned int bucket)
+{
+	/* inverse of jack_timing_bucket() */
+	if (bucket < 4) {
+		return bucket;
+	}
+
+	return (float) ((4 + (bucket & 3)) << (bucket / 4 - 1));
+}
+
+float
+jack_timing_histogram_percentile (const jack_timing_histogram_t *hist,
+				  float percentile)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (hist->count == 0) {
+		return 0.0f;
+	}
+
+	rank = (uint64_t) (hist->count * (percentile / 100.0) + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	for (i = 0; i < JACK_TIMING_BUCKETS - 1; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			float edge = jack_timing_histogram_bucket_usecs (i + 1);
+			return edge < hist->max_usecs ? edge : hist->max_usecs;
+		}
+	}
+
+	return hist->max_usecs;
+}
+
 pthread_t
 jack_client_thread_id (jack_client_t *client)
 {
@@ -8,6 +8,8 @@ struct _jack_client {
     jack_client_control_t *control;
     jack_shm_info_t        engine_shm;
     jack_shm_info_t        control_shm;
+    jack_shm_info_t        stats_shm;	/* see jack_get_cycle_stats() */
+    jack_stats_ring_t     *stats;
 
     struct pollfd*  pollfd;
     int             pollmax;
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <alloca.h>
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
@@ -34,6 +35,7 @@ typedef struct _jack_midi_port_info_private {
         uint32_t              event_count; /**< Number of events stored in this buffer */
 	jack_nframes_t        last_write_loc; /**< Used for both writing and mixdown */
 	uint32_t              events_lost;	  /**< Number of events lost in this buffer */
+	uint32_t              mode;	  /**< JackMidiBufferMode flags */
 } POST_PACKED_STRUCTURE jack_midi_port_info_private_t;
 
 typedef struct _jack_midi_port_internal_event {
@@ -76,6 +78,29 @@ jack_midi_buffer_init(void  *port_buffer,
 	info->event_count = 0;
 	info->last_write_loc = 0;
 	info->events_lost = 0;
+	info->mode = 0;
+}
+
+
+int
+jack_midi_set_buffer_mode(void     *port_buffer,
+                          uint32_t  mode)
+{
+	jack_midi_port_info_private_t *info =
+		(jack_midi_port_info_private_t *) port_buffer;
+
+	if (mode & ~(JackMidiSortEvents | JackMidiCoalesceControllers))
+		return EINVAL;
+
+	info->mode = mode;
+	return 0;
+}
+
+
+uint32_t
+jack_midi_get_buffer_mode(void           *port_buffer)
+{
+	return ((jack_midi_port_info_private_t *) port_buffer)->mode;
 }
 
 
@@ -138,24 +163,151 @@ jack_midi_max_event_size(void           *port_buffer)
 }
 
 
+/* Store an event that is known to be in order and to fit, and return
+ * where its data goes. */
+static inline jack_midi_data_t*
+jack_midi_event_append(jack_midi_port_info_private_t *info,
+                       jack_nframes_t                 time,
+                       size_t                         data_size)
+{
+	jack_midi_port_internal_event_t *event =
+		(jack_midi_port_internal_event_t *) (info + 1) + info->event_count;
+
+	event->time = time;
+	event->size = data_size;
+	info->event_count += 1;
+
+	if (data_size <= MIDI_INLINE_MAX)
+		return event->inline_data;
+
+	info->last_write_loc += data_size;
+	event->byte_offset = info->buffer_size - 1 - info->last_write_loc;
+	return (jack_midi_data_t *) info + event->byte_offset;
+}
+
+
+/* The index an event at time is stored at in time order: after every
+ * event at the same time or earlier. */
+static inline uint32_t
+jack_midi_event_position(jack_midi_port_info_private_t *info,
+                         jack_nframes_t                 time)
+{
+	jack_midi_port_internal_event_t *event_buffer =
+		(jack_midi_port_internal_event_t *) (info + 1);
+	uint32_t low = 0;
+	uint32_t high = info->event_count;
+	uint32_t mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (event_buffer[mid].time <= time)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+
+/* Store an event that is known to fit in time order, moving the
+ * events after it up.  Only the event headers move, the data of the
+ * events that are not inline stays where it is. */
+static jack_midi_data_t*
+jack_midi_event_insert(jack_midi_port_info_private_t *info,
+                       jack_nframes_t                 time,
+                       size_t                         data_size)
+{
+	jack_midi_port_internal_event_t *event_buffer =
+		(jack_midi_port_internal_event_t *) (info + 1);
+	jack_midi_port_internal_event_t event;
+	uint32_t position = jack_midi_event_position(info, time);
+	jack_midi_data_t *retbuf;
+
+	retbuf = jack_midi_event_append(info, time, data_size);
+	if (position == info->event_count - 1)
+		return retbuf;
+
+	event = event_buffer[info->event_count - 1];
+	memmove(&event_buffer[position + 1], &event_buffer[position],
+	        (info->event_count - 1 - position)
+	        * sizeof(jack_midi_port_internal_event_t));
+	event_buffer[position] = event;
+
+	if (data_size <= MIDI_INLINE_MAX)
+		return event_buffer[position].inline_data;
+	return retbuf;
+}
+
+
+/* Whether a change of this controller makes an earlier change of it
+ * at the same time redundant.  Data entry and the parameter number
+ * controllers act in sequence, so every one of them counts. */
+static inline int
+jack_midi_controller_coalesces(jack_midi_data_t controller)
+{
+	return controller != 6 && controller != 38
+		&& (controller < 96 || controller > 101);
+}
+
+
+/* In JackMidiCoalesceControllers mode, replace the value of a change
+ * of the same controller on the same channel at the same time, if
+ * only controller changes come between them.  Returns 1 if the event
+ * was merged into one already in the buffer. */
+static int
+jack_midi_event_coalesce(jack_midi_port_info_private_t *info,
+                         jack_nframes_t                 time,
+                         const jack_midi_data_t        *data,
+                         size_t                         data_size)
+{
+	jack_midi_port_internal_event_t *event_buffer =
+		(jack_midi_port_internal_event_t *) (info + 1);
+	jack_midi_port_internal_event_t *event;
+	uint32_t position;
+
+	if (data_size != 3 || (data[0] & 0xf0) != 0xb0
+	    || !jack_midi_controller_coalesces(data[1]))
+		return 0;
+
+	if (time >= info->nframes || info->event_count == 0)
+		return 0;
+
+	if (!(info->mode & JackMidiSortEvents)
+	    && time < event_buffer[info->event_count-1].time)
+		return 0;
+
+	position = jack_midi_event_position(info, time);
+	while (position-- > 0) {
+		event = &event_buffer[position];
+		if (event->time != time || event->size != 3
+		    || (event->inline_data[0] & 0xf0) != 0xb0)
+			break;
+		if (event->inline_data[0] == data[0]
+		    && event->inline_data[1] == data[1]) {
+			event->inline_data[2] = data[2];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
 jack_midi_data_t*
 jack_midi_event_reserve(void           *port_buffer,
                         jack_nframes_t  time, 
                         size_t          data_size)
 {
-	jack_midi_data_t *retbuf = (jack_midi_data_t *) port_buffer;
-
 	jack_midi_port_info_private_t *info =
 		(jack_midi_port_info_private_t *) port_buffer;
 	jack_midi_port_internal_event_t *event_buffer =
 		(jack_midi_port_internal_event_t *) (info + 1);
-	size_t buffer_size =
-		info->buffer_size;
 	
 	if (time < 0 || time >= info->nframes)
  		goto failed;
  
- 	if (info->event_count > 0 && time < event_buffer[info->event_count-1].time)
+	/* Events before the last one are only taken in JackMidiSortEvents mode */
+ 	if (info->event_count > 0 && time < event_buffer[info->event_count-1].time
+	    && !(info->mode & JackMidiSortEvents))
  		goto failed;
 
 	/* Check if data_size is >0 and there is enough space in the buffer for the event. */
@@ -163,21 +315,11 @@ jack_midi_event_reserve(void           *port_buffer,
 		goto failed; // return NULL?
 	} else if (jack_midi_max_event_size (port_buffer) < data_size) {
 		goto failed;
+	} else if (info->event_count > 0
+	           && time < event_buffer[info->event_count-1].time) {
+		return jack_midi_event_insert(info, time, data_size);
 	} else {
-		jack_midi_port_internal_event_t *event = &event_buffer[info->event_count];
-
-		event->time = time;
-		event->size = data_size;
-		if (data_size <= MIDI_INLINE_MAX) {
-			retbuf = event->inline_data;
-		} else {
-			info->last_write_loc += data_size;
-			retbuf = &retbuf[buffer_size - 1 - info->last_write_loc];
-			event->byte_offset =
-				buffer_size - 1 - info->last_write_loc;
-		}
-		info->event_count += 1;
-		return retbuf;
+		return jack_midi_event_append(info, time, data_size);
 	}
  failed:
  	info->events_lost++;
@@ -191,8 +333,15 @@ jack_midi_event_write(void                   *port_buffer,
                       const jack_midi_data_t *data,
                       size_t                  data_size)
 {
-	jack_midi_data_t *retbuf =
-		jack_midi_event_reserve(port_buffer, time, data_size);
+	jack_midi_port_info_private_t *info =
+		(jack_midi_port_info_private_t *) port_buffer;
+	jack_midi_data_t *retbuf;
+
+	if ((info->mode & JackMidiCoalesceControllers)
+	    && jack_midi_event_coalesce(info, time, data, data_size))
+		return 0;
+
+	retbuf = jack_midi_event_reserve(port_buffer, time, data_size);
 
 	if (retbuf) {
 		memcpy(retbuf, data, data_size);
@@ -203,6 +352,98 @@ jack_midi_event_write(void                   *port_buffer,
 }
 
 
+uint32_t
+jack_midi_event_write_batch(void                    *port_buffer,
+                            const jack_midi_event_t *events,
+                            uint32_t                 event_count)
+{
+	jack_midi_port_info_private_t *info =
+		(jack_midi_port_info_private_t *) port_buffer;
+	jack_midi_port_internal_event_t *event_buffer =
+		(jack_midi_port_internal_event_t *) (info + 1);
+	jack_nframes_t last_time = 0;
+	size_t used_size;
+	uint32_t n, i;
+
+	/* Sorting or coalescing is done event by event */
+	if (info->mode) {
+		for (n = 0; n < event_count; n++)
+			if (jack_midi_event_write(port_buffer, events[n].time,
+			                          events[n].buffer, events[n].size))
+				break;
+		if (n < event_count)
+			info->events_lost += event_count - n - 1;
+		return n;
+	}
+
+	if (info->event_count > 0)
+		last_time = event_buffer[info->event_count-1].time;
+	used_size = sizeof(jack_midi_port_info_private_t)
+		+ info->last_write_loc
+		+ info->event_count * sizeof(jack_midi_port_internal_event_t);
+
+	/* Find how many of the events can be stored, with the checks that
+	 * jack_midi_event_reserve makes, so that they can be copied in
+	 * without checking each one again */
+	for (n = 0; n < event_count; n++) {
+		if (events[n].time >= info->nframes
+		    || events[n].time < last_time
+		    || events[n].size == 0)
+			break;
+		used_size += sizeof(jack_midi_port_internal_event_t);
+		if (events[n].size > MIDI_INLINE_MAX)
+			used_size += events[n].size;
+		if (used_size > info->buffer_size)
+			break;
+		last_time = events[n].time;
+	}
+
+	for (i = 0; i < n; i++)
+		memcpy(jack_midi_event_append(info, events[i].time, events[i].size),
+		       events[i].buffer, events[i].size);
+
+	info->events_lost += event_count - n;
+	return n;
+}
+
+
+void
+jack_midi_iterator_init(jack_midi_iterator_t *iterator,
+                        void                 *port_buffer)
+{
+	jack_midi_port_info_private_t *info =
+		(jack_midi_port_info_private_t *) port_buffer;
+
+	iterator->port_buffer = port_buffer;
+	iterator->next = info + 1;
+	iterator->remaining = info->event_count;
+}
+
+
+int
+jack_midi_iterator_next(jack_midi_iterator_t *iterator,
+                        jack_midi_event_t    *event)
+{
+	jack_midi_port_internal_event_t *port_event =
+		(jack_midi_port_internal_event_t *) iterator->next;
+
+	if (iterator->remaining == 0)
+#ifdef ENODATA
+		return ENODATA;
+#else
+		return ENOMSG;
+#endif
+
+	event->time = port_event->time;
+	event->size = port_event->size;
+	event->buffer = jack_midi_event_data(iterator->port_buffer, port_event);
+
+	iterator->next = port_event + 1;
+	iterator->remaining--;
+	return 0;
+}
+
+
 /* Can't check to make sure this port is an output anymore.  If this gets
  * called on an input port, all clients after the client that calls it
  * will think there are no events in the buffer as the event count has
@@ -220,6 +461,58 @@ jack_midi_clear_buffer(void           *port_buffer)
 }
 
 
+/* The next unread event of one connection, while mixing down.  The
+ * cursors of all connections that have events left are kept in a
+ * binary min-heap ordered by the time of that event, and by position
+ * in the connection list for events at the same time, so the earliest
+ * is always on top. */
+typedef struct _jack_midi_merge_cursor {
+	jack_midi_port_info_private_t   *info;
+	jack_midi_port_internal_event_t *event;
+	jack_midi_port_internal_event_t *end;
+	uint32_t                         order;
+} jack_midi_merge_cursor_t;
+
+static inline int
+jack_midi_merge_before(const jack_midi_merge_cursor_t *a,
+                       const jack_midi_merge_cursor_t *b)
+{
+	return a->event->time < b->event->time
+		|| (a->event->time == b->event->time && a->order < b->order);
+}
+
+static inline void
+jack_midi_merge_sift_up(jack_midi_merge_cursor_t *heap, uint32_t i)
+{
+	jack_midi_merge_cursor_t cursor = heap[i];
+
+	while (i > 0 && jack_midi_merge_before(&cursor, &heap[(i - 1) / 2])) {
+		heap[i] = heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap[i] = cursor;
+}
+
+static inline void
+jack_midi_merge_sift_down(jack_midi_merge_cursor_t *heap, uint32_t n)
+{
+	jack_midi_merge_cursor_t cursor = heap[0];
+	uint32_t i = 0;
+	uint32_t child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n
+		    && jack_midi_merge_before(&heap[child + 1], &heap[child]))
+			child++;
+		if (!jack_midi_merge_before(&heap[child], &cursor))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = cursor;
+}
+
+
 /* jack_midi_port_functions.mixdown */
 static void
 jack_midi_port_mixdown(jack_port_t    *port, jack_nframes_t nframes)
@@ -230,82 +523,81 @@ jack_midi_port_mixdown(jack_port_t    *port, jack_nframes_t nframes)
 	jack_nframes_t  i          = 0;
 	int             err        = 0;
 	jack_nframes_t  lost_events = 0;
-
-	/* The next (single) event to mix in to the buffer */
-	jack_midi_port_info_private_t   *earliest_info;
-	jack_midi_port_internal_event_t *earliest_event;
-	jack_midi_data_t                *earliest_buffer;
-	
-	jack_midi_port_info_private_t   *in_info;   /* For finding next event */
-	jack_midi_port_internal_event_t *in_events; /* Corresponds to in_info */
+	uint32_t        num_connections = 0;
+	uint32_t        num_cursors = 0;
+	size_t          data_size  = 0;
+	int             fits;
+
+	jack_midi_merge_cursor_t        *heap;
+	jack_midi_port_internal_event_t *event;
+	jack_midi_port_info_private_t   *in_info;
 	jack_midi_port_info_private_t   *out_info;  /* Output 'buffer' */
 
 	jack_midi_clear_buffer(port->mix_buffer);
 	
 	out_info = (jack_midi_port_info_private_t *) port->mix_buffer;
 
-	/* This function uses jack_midi_port_info_private_t.last_write_loc of the
-	 * source ports to store indices of the last event read from that buffer
-	 * so far.  This is OK because last_write_loc is used when writing events
-	 * to a buffer, which at this stage is already complete so the value
-	 * can be safely smashed. */
-	
-	/* Iterate through all connections to see how many events we need to mix,
-	 * and initialise their 'last event read' (last_write_loc) to 0 */
+	for (node = port->connections; node; node = jack_slist_next(node))
+		num_connections++;
+
+	heap = (jack_midi_merge_cursor_t *)
+		alloca(num_connections * sizeof(jack_midi_merge_cursor_t));
+
+	/* Count the events to mix and put a cursor on the first event of
+	 * every connection that has one */
 	for (node = port->connections; node; node = jack_slist_next(node)) {
 		input = (jack_port_t *) node->data;
 		in_info =
 			(jack_midi_port_info_private_t *) jack_output_port_buffer(input);
 		num_events += in_info->event_count;
 		lost_events += in_info->events_lost;
-		in_info->last_write_loc = 0;
+		data_size += in_info->last_write_loc;
+
+		if (in_info->event_count > 0) {
+			heap[num_cursors].info = in_info;
+			heap[num_cursors].event =
+				(jack_midi_port_internal_event_t *) (in_info + 1);
+			heap[num_cursors].end =
+				heap[num_cursors].event + in_info->event_count;
+			heap[num_cursors].order = num_cursors;
+			jack_midi_merge_sift_up(heap, num_cursors);
+			num_cursors++;
+		}
 	}
 
-	/* Write the events in the order of their timestamps */
-	for (i = 0; i < num_events; ++i) {
-		earliest_info = NULL;
-		earliest_event = NULL;
-		earliest_buffer = NULL;
-
-		/* Find the earliest unread event, to mix next
-		 * (search for an event earlier than earliest_event) */
-		for (node = port->connections; node; node = jack_slist_next(node)) {
-			in_info = (jack_midi_port_info_private_t *)
-				jack_output_port_buffer(((jack_port_t *) node->data));
-			in_events = (jack_midi_port_internal_event_t *) (in_info + 1);
-
-			/* If there are unread events left in this port.. */
-			if (in_info->event_count > in_info->last_write_loc) {
-				/* .. and this event is the new earliest .. */
-				/* NOTE: that's why we compare time with <, not <= */
-				if (earliest_info == NULL
-						|| in_events[in_info->last_write_loc].time
-					       < earliest_event->time) {
-					/* .. then set this event as the next earliest */
-					earliest_info = in_info;
-					earliest_event = (jack_midi_port_internal_event_t *)
-						(&in_events[in_info->last_write_loc]);
-				}
-			}
-		}
+	/* In the usual case everything fits, which is checked once here
+	 * rather than for every event */
+	fits = sizeof(jack_midi_port_info_private_t)
+		+ num_events * sizeof(jack_midi_port_internal_event_t)
+		+ data_size <= out_info->buffer_size;
 
-		if (earliest_info && earliest_event) {
-			earliest_buffer = (jack_midi_data_t *) earliest_info;
-			
-			/* Write event to output */
+	/* Write the events in the order of their timestamps */
+	while (num_cursors > 0) {
+		event = heap[0].event;
+
+		if (fits) {
+			memcpy(jack_midi_event_append(out_info, event->time,
+			                              event->size),
+			       jack_midi_event_data(heap[0].info, event),
+			       event->size);
+		} else {
 			err = jack_midi_event_write(
 				jack_port_buffer(port),
-				earliest_event->time,
-				jack_midi_event_data(earliest_buffer, earliest_event),
-				earliest_event->size);
-			
-			earliest_info->last_write_loc++;
-
-			if (err) {
-				out_info->events_lost = num_events - i;
-				break;
-			}
+				event->time,
+				jack_midi_event_data(heap[0].info, event),
+				event->size);
+		}
+
+		if (err) {
+			out_info->events_lost = num_events - i;
+			break;
 		}
+		++i;
+
+		if (++heap[0].event == heap[0].end)
+			heap[0] = heap[--num_cursors];
+		if (num_cursors > 1)
+			jack_midi_merge_sift_down(heap, num_cursors);
 	}
 	assert(out_info->event_count == num_events - out_info->events_lost);
 
@@ -0,0 +1,300 @@
+/*
+    Benchmark and conformance check for the MIDI port mixdown.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 2.1 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* midiport_bench: merges synthetic dense MIDI streams, controller
+   changes with the odd longer message, from a range of connection
+   counts into one input port with the mixdown function of midiport.c.
+   The ports are laid out in one segment the way the engine lays them
+   out in shared memory. It times the mixdown against a merge that
+   rescans every connection for each event, as the mixdown used to,
+   and checks that both give the same buffer. The sources are filled
+   with jack_midi_event_write_batch() and the mixed buffer is read
+   back with an iterator, so those are checked along the way. Exits non-zero if they
+   do not.
+
+   It is built along with libjack but not installed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <jack/port.h>
+
+#define NFRAMES         1024
+#define SOURCE_BYTES    (64 * 1024)
+#define MAX_CONNECTIONS 256
+
+extern jack_port_functions_t jack_builtin_midi_functions;
+
+static const unsigned int connection_counts[] = { 2, 4, 8, 16, 40, 64, 128, 0 };
+static const unsigned int event_counts[] = { 16, 128, 512, 0 };
+
+static char *segment;
+static void *segment_base;
+static jack_port_shared_t shared[MAX_CONNECTIONS];
+static jack_port_t sources[MAX_CONNECTIONS];
+static jack_port_t dest;
+static void *reference;
+static size_t dest_bytes;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Fills each source with nevents events at sorted random times, with
+   some at the same time across and within sources. */
+static void
+fill_sources (unsigned int nconnections, unsigned int nevents)
+{
+	static jack_midi_event_t events[SOURCE_BYTES / 8];
+	static jack_midi_data_t data[SOURCE_BYTES / 8][8];
+	unsigned int seed = 1;
+	jack_nframes_t time;
+	unsigned int c, e;
+	void *buf;
+
+	if (nevents > SOURCE_BYTES / 8) {
+		nevents = SOURCE_BYTES / 8;
+	}
+
+	for (c = 0; c < nconnections; c++) {
+		buf = segment + shared[c].offset;
+		jack_builtin_midi_functions.buffer_init (buf, SOURCE_BYTES, NFRAMES);
+
+		time = 0;
+		for (e = 0; e < nevents; e++) {
+			seed = seed * 1664525 + 1013904223;
+			time += (seed >> 24) % (2 * NFRAMES / nevents + 1);
+			if (time >= NFRAMES) {
+				time = NFRAMES - 1;
+			}
+			events[e].time = time;
+			events[e].size = (seed >> 8) % 16 ? 3 : 6;
+			events[e].buffer = data[e];
+			data[e][0] = 0xb0 | (c & 0x0f);
+			data[e][1] = e & 0x7f;
+			data[e][2] = (seed >> 16) & 0x7f;
+			data[e][3] = data[e][4] = data[e][5] = 0x7f;
+		}
+		jack_midi_event_write_batch (buf, events, nevents);
+	}
+}
+
+static void
+connect_sources (unsigned int nconnections)
+{
+	unsigned int c;
+
+	jack_slist_free (dest.connections);
+	dest.connections = NULL;
+	for (c = 0; c < nconnections; c++) {
+		dest.connections = jack_slist_append (dest.connections, &sources[c]);
+	}
+}
+
+/* The merge as it was: rescan every connection for the next event. */
+static void
+linear_mixdown (void *out, unsigned int nconnections)
+{
+	uint32_t next[MAX_CONNECTIONS];
+	jack_midi_event_t ev, earliest = { 0, 0, NULL };
+	unsigned int c, best;
+	void *buf;
+
+	jack_midi_clear_buffer (out);
+	memset (next, 0, sizeof (next));
+
+	while (1) {
+		best = nconnections;
+		for (c = 0; c < nconnections; c++) {
+			buf = segment + shared[c].offset;
+			if (jack_midi_event_get (&ev, buf, next[c]) == 0
+			    && (best == nconnections || ev.time < earliest.time)) {
+				earliest = ev;
+				best = c;
+			}
+		}
+		if (best == nconnections) {
+			break;
+		}
+		jack_midi_event_write (out, earliest.time, earliest.buffer, earliest.size);
+		next[best]++;
+	}
+}
+
+/* Compares two buffers event by event, reading the first with an
+   iterator and the second by index. */
+static int
+same_events (void *a, void *b)
+{
+	jack_midi_iterator_t iter;
+	jack_midi_event_t ea, eb;
+	uint32_t i, n = jack_midi_get_event_count (a);
+
+	if (n != jack_midi_get_event_count (b)
+	    || jack_midi_get_lost_event_count (a) != jack_midi_get_lost_event_count (b)) {
+		return 0;
+	}
+	jack_midi_iterator_init (&iter, a);
+	for (i = 0; i < n; i++) {
+		jack_midi_iterator_next (&iter, &ea);
+		jack_midi_event_get (&eb, b, i);
+		if (ea.time != eb.time || ea.size != eb.size
+		    || memcmp (ea.buffer, eb.buffer, ea.size)) {
+			return 0;
+		}
+	}
+	return jack_midi_iterator_next (&iter, &ea) != 0;
+}
+
+static void
+usage (void)
+{
+	fprintf (stderr, "usage: midiport_bench [ -n connections ] [ -e events ] [ -i iterations ] [ -c ]\n");
+	fprintf (stderr, "    -n, --connections  merge only this many connections\n");
+	fprintf (stderr, "    -e, --events       only this many events per connection\n");
+	fprintf (stderr, "    -i, --iterations   mixdowns per measurement (default 2000)\n");
+	fprintf (stderr, "    -c, --check        only check the mixdown, no timing\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+	unsigned int only_connections = 0;
+	unsigned int only_events = 0;
+	unsigned long iterations = 2000;
+	int check_only = 0;
+	int failures = 0;
+	unsigned int c, e, ci, ei;
+	unsigned long it;
+	double start, t_linear, t_heap;
+	int opt;
+
+	const char *short_options = "n:e:i:ch";
+	struct option long_options[] = {
+		{ "connections", 1, 0, 'n' },
+		{ "events", 1, 0, 'e' },
+		{ "iterations", 1, 0, 'i' },
+		{ "check", 0, 0, 'c' },
+		{ "help", 0, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((opt = getopt_long (argc, argv, short_options, long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			only_connections = strtoul (optarg, NULL, 10);
+			if (only_connections < 2 || only_connections > MAX_CONNECTIONS) {
+				fprintf (stderr, "midiport_bench: 2 to %d connections\n",
+					 MAX_CONNECTIONS);
+				return 1;
+			}
+			break;
+		case 'e':
+			only_events = strtoul (optarg, NULL, 10);
+			break;
+		case 'i':
+			iterations = strtoul (optarg, NULL, 10);
+			break;
+		case 'c':
+			check_only = 1;
+			break;
+		default:
+			usage ();
+			return 1;
+		}
+	}
+
+	/* the output holds everything, so nothing is lost on the way */
+	dest_bytes = (size_t) MAX_CONNECTIONS * SOURCE_BYTES;
+	segment = malloc ((size_t) MAX_CONNECTIONS * SOURCE_BYTES);
+	segment_base = segment;
+
+	for (c = 0; c < MAX_CONNECTIONS; c++) {
+		shared[c].offset = (jack_shmsize_t) c * SOURCE_BYTES;
+		shared[c].flags = JackPortIsOutput;
+		sources[c].client_segment_base = &segment_base;
+		sources[c].shared = &shared[c];
+	}
+	dest.mix_buffer = malloc (dest_bytes);
+	reference = malloc (dest_bytes);
+	jack_builtin_midi_functions.buffer_init (dest.mix_buffer, dest_bytes, NFRAMES);
+	jack_builtin_midi_functions.buffer_init (reference, dest_bytes, NFRAMES);
+
+	if (!check_only) {
+		printf ("%11s %7s %14s %14s %8s\n", "connections", "events",
+			"linear ns/ev", "mixdown ns/ev", "speedup");
+	}
+
+	for (ci = 0; connection_counts[ci]; ci++) {
+		c = only_connections ? only_connections : connection_counts[ci];
+
+		for (ei = 0; event_counts[ei]; ei++) {
+			e = only_events ? only_events : event_counts[ei];
+
+			fill_sources (c, e);
+			connect_sources (c);
+
+			jack_builtin_midi_functions.mixdown (&dest, NFRAMES);
+			linear_mixdown (reference, c);
+			if (!same_events (dest.mix_buffer, reference)) {
+				printf ("MISMATCH: %u connections, %u events each\n", c, e);
+				failures++;
+			}
+
+			if (!check_only) {
+				start = now ();
+				for (it = 0; it < iterations; it++) {
+					linear_mixdown (reference, c);
+				}
+				t_linear = (now () - start) / (iterations * (double) c * e);
+
+				start = now ();
+				for (it = 0; it < iterations; it++) {
+					jack_builtin_midi_functions.mixdown (&dest, NFRAMES);
+				}
+				t_heap = (now () - start) / (iterations * (double) c * e);
+
+				printf ("%11u %7u %14.2f %14.2f %7.1fx\n", c, e,
+					t_linear * 1e9, t_heap * 1e9, t_linear / t_heap);
+			}
+
+			if (only_events) {
+				break;
+			}
+		}
+
+		if (only_connections) {
+			break;
+		}
+	}
+
+	printf ("%d mismatch%s\n", failures, failures == 1 ? "" : "es");
+
+	return failures ? 1 : 0;
+}
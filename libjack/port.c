@@ -19,6 +19,7 @@
 */
 
 #include <string.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <math.h>
 
@@ -70,81 +71,99 @@ jack_port_type_info_t jack_builtin_port_types[] = {
 	{ .type_name = "", }
 };
 
-/* these functions have been taken from libDSP X86.c  -jl */
+/* mixdown kernel for this CPU, see jack_mix_select() */
+static jack_mix_func_t opt_mix = jack_mix_generic;
 
-#ifdef USE_DYNSIMD
-
-static void (*opt_copy) (float *, const float *, int);
-static void (*opt_mix) (float *, const float *, int);
-
-static void
-gen_copyf (float *dest, const float *src, int length)
+void jack_port_set_funcs ()
 {
-	memcpy(dest, src, length * sizeof(float));
+	opt_mix = jack_mix_select ();
 }
 
-static void
-gen_mixf (float *dest, const float *src, int length)
+const char *
+jack_port_name_canonical (const char *target, char *buf, size_t size)
 {
-	int n;
+	/* this nasty, nasty kludge is here because between 0.109.0 and 0.109.1,
+	   the ALSA audio backend had the name "ALSA", whereas as before and
+	   after it, it was called "alsa_pcm". this stops breakage for
+	   any setups that have saved "alsa_pcm" or "ALSA" in their connection
+	   state.
+	*/
 
-	n = length;
-	while (n--)
-		*dest++ += *src++;
-	/*for (iSample = 0; iSample < iDataLength; iSample++)
-		fpDest[iSample] += fpSrc[iSample];*/
-}
+	if (strncmp (target, "ALSA:capture", 12) == 0 || strncmp (target, "ALSA:playback", 13) == 0) {
+		snprintf (buf, size, "alsa_pcm%s", target+4);
+		return buf;
+	}
 
-#ifdef ARCH_X86
+	return target;
+}
 
-void jack_port_set_funcs ()
+int
+jack_port_name_equals (jack_port_shared_t* port, const char* target)
 {
-	if (ARCH_X86_HAVE_SSE2(cpu_type)) {
-		opt_copy = x86_sse_copyf;
-		opt_mix = x86_sse_add2f;
-	}
-	else if (ARCH_X86_HAVE_3DNOW(cpu_type)) {
-		opt_copy = x86_3dnow_copyf;
-		opt_mix = x86_3dnow_add2f;
-	}
-	else {
-		opt_copy = gen_copyf;
-		opt_mix = gen_mixf;
-	}
-}
+	char buf[JACK_PORT_NAME_SIZE+1];
 
-#else /* ARCH_X86 */
+	target = jack_port_name_canonical (target, buf, sizeof (buf));
 
-void jack_port_set_funcs ()
-{
-	opt_copy = gen_copyf;
-	opt_mix = gen_mixf;
+	return (strcmp (port->name, target) == 0 || 
+		strcmp (port->alias1, target) == 0 || 
+		strcmp (port->alias2, target) == 0);
 }
 
-#endif /* ARCH_X86 */
+/* FNV-1a */
+uint32_t
+jack_port_name_hash (const char *name)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
 
-#endif /* USE_DYNSIMD */
+	return hash;
+}
 
+/* Look a port up in the name index, see jack_port_index_t.
+ *
+ * @return 1 and the port's id if found, 0 if there is no such port,
+ * -1 if the index could not tell and the caller has to search the
+ * port table.
+ */
 int
-jack_port_name_equals (jack_port_shared_t* port, const char* target)
+jack_port_index_find (jack_control_t *ctl, const char *name,
+		      jack_port_id_t *id)
 {
+	jack_port_index_t *index = jack_port_index (ctl);
+	volatile uint32_t *next = jack_port_index_next (index);
 	char buf[JACK_PORT_NAME_SIZE+1];
+	jack_port_shared_t *port;
+	uint32_t seq, entry, steps;
+
+	seq = index->seq;
+	__sync_synchronize ();
+
+	name = jack_port_name_canonical (name, buf, sizeof (buf));
+	entry = jack_port_index_heads (index)[jack_port_name_hash (name) &
+					      (index->nbuckets - 1)];
+
+	/* bounded, the server may relink entries meanwhile */
+	for (steps = 0; entry < index->nentries && steps < index->nentries;
+	     entry = next[entry], steps++) {
+		port = &ctl->ports[entry / 3];
+		if (port->in_use && jack_port_name_equals (port, name)) {
+			*id = entry / 3;
+			return 1;
+		}
+	}
 
-	/* this nasty, nasty kludge is here because between 0.109.0 and 0.109.1,
-	   the ALSA audio backend had the name "ALSA", whereas as before and
-	   after it, it was called "alsa_pcm". this stops breakage for
-	   any setups that have saved "alsa_pcm" or "ALSA" in their connection
-	   state.
-	*/
+	__sync_synchronize ();
 
-	if (strncmp (target, "ALSA:capture", 12) == 0 || strncmp (target, "ALSA:playback", 13) == 0) {
-		snprintf (buf, sizeof (buf), "alsa_pcm%s", target+4);
-		target = buf;
+	if ((seq & 1) || seq != index->seq ||
+	    index->names_seen != ctl->port_name_changes) {
+		return -1;
 	}
 
-	return (strcmp (port->name, target) == 0 || 
-		strcmp (port->alias1, target) == 0 || 
-		strcmp (port->alias2, target) == 0);
+	return 0;
 }
 
 jack_port_functions_t *
@@ -487,6 +506,14 @@ jack_port_by_name_int (jack_client_t *client, const char *port_name)
 {
 	unsigned long i, limit;
 	jack_port_shared_t *port;
+	jack_port_id_t id;
+
+	switch (jack_port_index_find (client->engine, port_name, &id)) {
+	case 1:
+		return jack_port_new (client, id, client->engine);
+	case 0:
+		return NULL;
+	}
 	
 	limit = client->engine->port_max;
 	port = &client->engine->ports[0];
@@ -597,10 +624,19 @@ jack_port_get_buffer (jack_port_t *port, jack_nframes_t nframes)
 					     nframes);
 	}
 
-	/* Multiple connections.  Use a local buffer and mix the
-	   incoming data into that buffer.  We have already
-	   established the existence of a mixdown function during the
-	   connection process.
+	/* Multiple connections.  If the server premixes this
+	   input, its offset points at the mix instead of at the
+	   zero buffer.
+	*/
+	if (port->shared->offset) {
+		return (void *) (*(port->client_segment_base) +
+				 port->shared->offset);
+	}
+
+	/* Otherwise use a local buffer and mix the incoming data
+	   into that buffer.  We have already established the
+	   existence of a mixdown function during the connection
+	   process.
 	*/
 	if (port->mix_buffer == NULL) {
 		jack_error( "internal jack error: mix_buffer not allocated" );
@@ -789,6 +825,22 @@ jack_port_type (const jack_port_t *port)
 	return port->type_info->type_name;
 }
 
+/* tell the server its port name index is stale, see jack_port_index_t,
+   and jack_get_ports() callers that its results are */
+static void
+jack_port_name_changed (jack_port_t *port)
+{
+	/* the shared port structures are the tail of the engine
+	   control segment */
+	jack_control_t *ctl = (jack_control_t *)
+		((char *) (port->shared - port->shared->id) -
+		 offsetof (jack_control_t, ports));
+
+	__sync_synchronize ();
+	__sync_fetch_and_add (&ctl->port_name_changes, 1);
+	__sync_fetch_and_add (&ctl->port_generation, 1);
+}
+
 int
 jack_port_set_name (jack_port_t *port, const char *new_name)
 {
@@ -799,6 +851,7 @@ jack_port_set_name (jack_port_t *port, const char *new_name)
 	len = sizeof (port->shared->name) -
 		((int) (colon - port->shared->name)) - 2;
 	snprintf (colon+1, len, "%s", new_name);
+	jack_port_name_changed (port);
 	
 	return 0;
 }
@@ -814,6 +867,7 @@ jack_port_set_alias (jack_port_t *port, const char *alias)
 		return -1;
 	}
 
+	jack_port_name_changed (port);
 	return 0;
 }
 
@@ -828,6 +882,7 @@ jack_port_unset_alias (jack_port_t *port, const char *alias)
 		return -1;
 	}
 
+	jack_port_name_changed (port);
 	return 0;
 }
 
@@ -880,11 +935,9 @@ jack_audio_port_mixdown (jack_port_t *port, jack_nframes_t nframes)
 {
 	JSList *node;
 	jack_port_t *input;
-#ifndef ARCH_X86
-	jack_nframes_t n;
-	jack_default_audio_sample_t *dst, *src;
-#endif
-	jack_default_audio_sample_t *buffer;
+	const jack_default_audio_sample_t *src[JACK_MIX_BATCH];
+	unsigned int nsrc = 0;
+	int add = 0;
 
 	/* by the time we've called this, we've already established
 	   the existence of more than one connection to this input
@@ -897,33 +950,20 @@ jack_audio_port_mixdown (jack_port_t *port, jack_nframes_t nframes)
 	   during this time.
 	*/
 
-	node = port->connections;
-	input = (jack_port_t *) node->data;
-	buffer = port->mix_buffer;
-
-#ifndef USE_DYNSIMD
-	memcpy (buffer, jack_output_port_buffer (input),
-		sizeof (jack_default_audio_sample_t) * nframes);
-#else /* USE_DYNSIMD */
-	opt_copy (buffer, jack_output_port_buffer (input), nframes);
-#endif /* USE_DYNSIMD */
-
-	for (node = jack_slist_next (node); node;
-	     node = jack_slist_next (node)) {
+	for (node = port->connections; node; node = jack_slist_next (node)) {
 
 		input = (jack_port_t *) node->data;
+		src[nsrc++] = jack_output_port_buffer (input);
 
-#ifndef USE_DYNSIMD
-		n = nframes;
-		dst = buffer;
-		src = jack_output_port_buffer (input);
-
-		while (n--) {
-			*dst++ += *src++;
+		if (nsrc == JACK_MIX_BATCH) {
+			opt_mix (port->mix_buffer, src, nsrc, add, nframes);
+			nsrc = 0;
+			add = 1;
 		}
-#else /* USE_DYNSIMD */
-		opt_mix (buffer, jack_output_port_buffer (input), nframes);
-#endif /* USE_DYNSIMD */
+	}
+
+	if (nsrc) {
+		opt_mix (port->mix_buffer, src, nsrc, add, nframes);
 	}
 }
 
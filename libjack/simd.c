@@ -427,3 +427,165 @@ sse_nonalign:
 
 #endif /* USE_DYNSIMD */
 
+
+/* Audio port mixdown kernels.
+ *
+ * All of them compute, for every frame,
+ *
+ *	dest = (add ? dest : src[0]) + src[add ? 0 : 1] + ... + src[nsrc-1]
+ *
+ * adding the sources in connection order, so that each variant gives
+ * bit-identical results to summing one connection after another.  The
+ * destination is written once however many sources there are, so
+ * busses with a large fan-in no longer stream it through the cache
+ * once per connection.
+ */
+
+void
+jack_mix_generic (float *dest, const float * const *src, unsigned int nsrc,
+		  int add, int length)
+{
+	int i = 0;
+	unsigned int j, first = add ? 0 : 1;
+
+	for (; i + 4 <= length; i += 4) {
+		const float *b = add ? dest + i : src[0] + i;
+		float a0 = b[0], a1 = b[1], a2 = b[2], a3 = b[3];
+		for (j = first; j < nsrc; j++) {
+			const float *s = src[j] + i;
+			a0 += s[0];
+			a1 += s[1];
+			a2 += s[2];
+			a3 += s[3];
+		}
+		dest[i] = a0;
+		dest[i + 1] = a1;
+		dest[i + 2] = a2;
+		dest[i + 3] = a3;
+	}
+
+	for (; i < length; i++) {
+		float a = add ? dest[i] : src[0][i];
+		for (j = first; j < nsrc; j++)
+			a += src[j][i];
+		dest[i] = a;
+	}
+}
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+
+#include <immintrin.h>
+
+/* Each kernel keeps four vectors of dest in registers while it walks
+   through the sources, so four independent additions are in flight. */
+
+#define MIX_KERNEL(name, attr, vec, width, load, store, addv)		\
+static void __attribute__((target(attr)))				\
+name (float *dest, const float * const *src, unsigned int nsrc,	\
+      int add, int length)						\
+{									\
+	int i = 0;							\
+	unsigned int j, first = add ? 0 : 1;				\
+									\
+	for (; i + 4 * (width) <= length; i += 4 * (width)) {		\
+		const float *b = add ? dest + i : src[0] + i;		\
+		vec a0 = load (b);					\
+		vec a1 = load (b + (width));				\
+		vec a2 = load (b + 2 * (width));			\
+		vec a3 = load (b + 3 * (width));			\
+		for (j = first; j < nsrc; j++) {			\
+			const float *s = src[j] + i;			\
+			a0 = addv (a0, load (s));			\
+			a1 = addv (a1, load (s + (width)));		\
+			a2 = addv (a2, load (s + 2 * (width)));		\
+			a3 = addv (a3, load (s + 3 * (width)));		\
+		}							\
+		store (dest + i, a0);					\
+		store (dest + i + (width), a1);				\
+		store (dest + i + 2 * (width), a2);			\
+		store (dest + i + 3 * (width), a3);			\
+	}								\
+									\
+	for (; i < length; i++) {					\
+		float a = add ? dest[i] : src[0][i];			\
+		for (j = first; j < nsrc; j++)				\
+			a += src[j][i];					\
+		dest[i] = a;						\
+	}								\
+}
+
+MIX_KERNEL (jack_mix_sse2, "sse2", __m128, 4,
+	    _mm_loadu_ps, _mm_storeu_ps, _mm_add_ps)
+MIX_KERNEL (jack_mix_avx, "avx", __m256, 8,
+	    _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps)
+MIX_KERNEL (jack_mix_avx512, "avx512f", __m512, 16,
+	    _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps)
+
+jack_mix_func_t
+jack_mix_select (void)
+{
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("avx512f"))
+		return jack_mix_avx512;
+	if (__builtin_cpu_supports ("avx"))
+		return jack_mix_avx;
+	if (__builtin_cpu_supports ("sse2"))
+		return jack_mix_sse2;
+	return jack_mix_generic;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+static void
+jack_mix_neon (float *dest, const float * const *src, unsigned int nsrc,
+	       int add, int length)
+{
+	int i = 0;
+	unsigned int j, first = add ? 0 : 1;
+
+	for (; i + 16 <= length; i += 16) {
+		const float *b = add ? dest + i : src[0] + i;
+		float32x4_t a0 = vld1q_f32 (b);
+		float32x4_t a1 = vld1q_f32 (b + 4);
+		float32x4_t a2 = vld1q_f32 (b + 8);
+		float32x4_t a3 = vld1q_f32 (b + 12);
+		for (j = first; j < nsrc; j++) {
+			const float *s = src[j] + i;
+			a0 = vaddq_f32 (a0, vld1q_f32 (s));
+			a1 = vaddq_f32 (a1, vld1q_f32 (s + 4));
+			a2 = vaddq_f32 (a2, vld1q_f32 (s + 8));
+			a3 = vaddq_f32 (a3, vld1q_f32 (s + 12));
+		}
+		vst1q_f32 (dest + i, a0);
+		vst1q_f32 (dest + i + 4, a1);
+		vst1q_f32 (dest + i + 8, a2);
+		vst1q_f32 (dest + i + 12, a3);
+	}
+
+	for (; i < length; i++) {
+		float a = add ? dest[i] : src[0][i];
+		for (j = first; j < nsrc; j++)
+			a += src[j][i];
+		dest[i] = a;
+	}
+}
+
+jack_mix_func_t
+jack_mix_select (void)
+{
+	/* NEON is part of the baseline wherever this is compiled in */
+	return jack_mix_neon;
+}
+
+#else
+
+jack_mix_func_t
+jack_mix_select (void)
+{
+	return jack_mix_generic;
+}
+
+#endif
@@ -33,6 +33,7 @@
 #include <jack/engine.h>
 #include <jack/messagebuffer.h>
 #include <jack/driver.h>
+#include <jack/futex.h>
 #include <sysdeps/poll.h>
 #include <sysdeps/ipc.h>
 
@@ -153,6 +154,15 @@ jack_zombify_client (jack_engine_t *engine, jack_client_internal_t *client)
 
 	client->control->dead = TRUE;
 
+#ifdef JACK_USE_FUTEX
+	/* with futex wakeups no FIFO gets closed under the client's
+	   feet, so tell it directly */
+	if (engine->futex_wakeup && !jack_client_is_internal (client)) {
+		jack_futex_post (&client->control->graph_wake,
+				 JACK_WAKE_EVENT);
+	}
+#endif /* JACK_USE_FUTEX */
+
 	jack_client_disconnect_ports (engine, client);
 	jack_client_do_deactivate (engine, client, FALSE);
 }
@@ -211,6 +221,8 @@ jack_remove_client (jack_engine_t *engine, jack_client_internal_t *client)
 		}
 	}
 
+	jack_client_order_remove (engine, client);
+
 	jack_client_delete (engine, client);
 
 	/* ignore the driver, which counts as a client. */
@@ -546,9 +558,16 @@ jack_setup_client_control (jack_engine_t *engine, int fd,
 	client->sortfeeds = 0;
 	client->execution_order = UINT_MAX;
 	client->next_client = NULL;
+	client->graph_feeds = NULL;
+	client->graph_nfeeds = 0;
+	client->graph_feeds_max = 0;
+	client->graph_fedcount = 0;
+	client->graph_pending = 0;
 	client->handle = NULL;
 	client->finish = NULL;
 	client->error = 0;
+	memset (&client->timing, 0, sizeof (client->timing));
+	client->timing_reset = 0;
 
 	if (type != ClientExternal) {
 		
@@ -577,6 +596,9 @@ jack_setup_client_control (jack_engine_t *engine, int fd,
 			jack_shm_addr (&client->control_shm);
 	}
 
+	client->control->graph_wake.word = 0;
+	client->control->graph_done = 0;
+	client->control->graph_syscalls = 0;
 	client->control->type = type;
 	client->control->active = 0;
 	client->control->dead = FALSE;
@@ -710,6 +732,18 @@ setup_client (jack_engine_t *engine, ClientType type, char *name, jack_client_id
 
 	/* add new client to the clients list */
 	jack_lock_graph (engine);
+
+	if (jack_client_order_add (engine, client)) {
+		jack_unlock_graph (engine);
+		jack_error ("cannot add client to the graph sort order");
+		if (type == ClientInternal) {
+			jack_client_unload (client);
+		}
+		jack_client_delete (engine, client);
+		*status |= (JackFailure|JackInitFailure);
+		return NULL;
+	}
+
  	engine->clients = jack_slist_prepend (engine->clients, client);
 	jack_engine_reset_rolling_usecs (engine);
 	
@@ -1049,6 +1083,10 @@ jack_client_delete (jack_engine_t *engine, jack_client_internal_t *client)
 		jack_destroy_shm (&client->control_shm);
         }
 
+	if (client->graph_feeds) {
+		free (client->graph_feeds);
+	}
+
         free (client);
 
 }
@@ -117,6 +117,18 @@ struct jackctl_server
     /* int, timeout thres... */
     union jackctl_parameter_value timothres;
     union jackctl_parameter_value default_timothres;
+
+    /* bool, run independent clients concurrently */
+    union jackctl_parameter_value parallel;
+    union jackctl_parameter_value default_parallel;
+
+    /* bool, wake clients through futexes rather than FIFOs */
+    union jackctl_parameter_value futex_wakeup;
+    union jackctl_parameter_value default_futex_wakeup;
+
+    /* bool, mix inputs shared by several ports once in the server */
+    union jackctl_parameter_value premix;
+    union jackctl_parameter_value default_premix;
 };
 
 struct jackctl_driver
@@ -1087,6 +1099,51 @@ jackctl_server_t * jackctl_server_create(
         goto fail_free_parameters;
     }
 
+    value.b = false;
+    if (jackctl_add_parameter(
+            &server_ptr->parameters,
+	    '\0',
+            "parallel",
+            "Run clients that do not depend on each other concurrently.",
+            "",
+            JackParamBool,
+            &server_ptr->parallel,
+            &server_ptr->default_parallel,
+            value, NULL) == NULL)
+    {
+        goto fail_free_parameters;
+    }
+
+    value.b = false;
+    if (jackctl_add_parameter(
+            &server_ptr->parameters,
+	    '\0',
+            "futex-wakeup",
+            "Wake clients through shared memory futexes instead of FIFOs.",
+            "",
+            JackParamBool,
+            &server_ptr->futex_wakeup,
+            &server_ptr->default_futex_wakeup,
+            value, NULL) == NULL)
+    {
+        goto fail_free_parameters;
+    }
+
+    value.b = false;
+    if (jackctl_add_parameter(
+            &server_ptr->parameters,
+	    '\0',
+            "premix",
+            "Mix inputs connected to the same outputs once, in the server.",
+            "",
+            JackParamBool,
+            &server_ptr->premix,
+            &server_ptr->default_premix,
+            value, NULL) == NULL)
+    {
+        goto fail_free_parameters;
+    }
+
     //TODO: need 
     //JackServerGlobals::on_device_acquire = on_device_acquire;
     //JackServerGlobals::on_device_release = on_device_release;
@@ -1193,7 +1250,9 @@ jackctl_server_start(
 				    server_ptr->do_mlock.b, server_ptr->do_unlock.b, server_ptr->name.str,
 				    server_ptr->temporary.b, server_ptr->verbose.b, server_ptr->client_timeout.i,
 				    server_ptr->port_max.i, getpid(), frame_time_offset, 
-				    server_ptr->nozombies.b, server_ptr->timothres.ui, drivers)) == 0) {
+				    server_ptr->nozombies.b, server_ptr->timothres.ui,
+				    server_ptr->parallel.b, server_ptr->futex_wakeup.b,
+				    server_ptr->premix.b, drivers)) == 0) {
 	    jack_error ("cannot create engine");
 	    goto fail_unregister;
     }
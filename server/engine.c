@@ -45,6 +45,8 @@
 #include <jack/driver.h>
 #include <jack/shm.h>
 #include <jack/thread.h>
+#include <jack/futex.h>
+#include <jack/intsimd.h>
 #include <sysdeps/poll.h>
 #include <sysdeps/ipc.h>
 
@@ -81,10 +83,14 @@ typedef struct _jack_driver_info {
 
 jack_timer_type_t clock_source = JACK_TIMER_SYSTEM_CLOCK;
 
+static jack_mix_func_t jack_engine_mix = jack_mix_generic;
+
 static int                    jack_port_assign_buffer (jack_engine_t *,
 						       jack_port_internal_t *);
 static jack_port_internal_t *jack_get_port_by_name (jack_engine_t *,
 						    const char *name);
+static uint32_t jack_port_index_buckets (unsigned int port_max);
+static int  jack_port_index_init (jack_engine_t *engine);
 static int  jack_rechain_graph (jack_engine_t *engine);
 static void jack_clear_fifos (jack_engine_t *engine);
 int  jack_port_do_connect (jack_engine_t *engine,
@@ -99,6 +105,8 @@ static int  jack_port_do_unregister (jack_engine_t *engine, jack_request_t *);
 static int  jack_port_do_register (jack_engine_t *engine, jack_request_t *, int);
 static int  jack_do_get_port_connections (jack_engine_t *engine,
 					  jack_request_t *req, int reply_fd);
+static int  jack_do_connect_batch (jack_engine_t *engine,
+				   jack_request_t *req, int *reply_fd);
 static int  jack_port_disconnect_internal (jack_engine_t *engine,
 					   jack_port_internal_t *src, 
 					   jack_port_internal_t *dst);
@@ -123,7 +131,8 @@ static void jack_engine_delay (jack_engine_t *engine,
 			       float delayed_usecs);
 static void jack_engine_driver_exit (jack_engine_t* engine);
 static int  jack_start_freewheeling (jack_engine_t* engine, jack_client_id_t);
-static int jack_client_feeds_transitive (jack_client_internal_t *source,
+static int jack_client_feeds_transitive (jack_engine_t *engine,
+					 jack_client_internal_t *source,
 					 jack_client_internal_t *dest);
 static int jack_client_sort (jack_client_internal_t *a,
 			     jack_client_internal_t *b);
@@ -134,6 +143,8 @@ static int jack_check_client_status (jack_engine_t* engine);
 static int jack_do_session_notify (jack_engine_t *engine, jack_request_t *req, int reply_fd );
 static void jack_do_get_client_by_uuid ( jack_engine_t *engine, jack_request_t *req);
 static void jack_do_reserve_name ( jack_engine_t *engine, jack_request_t *req);
+static void jack_do_get_client_timing (jack_engine_t *engine, jack_request_t *req);
+static void jack_do_reset_client_timing (jack_engine_t *engine, jack_request_t *req);
 static void jack_do_session_reply (jack_engine_t *engine, jack_request_t *req );
 static void jack_compute_new_latency (jack_engine_t *engine);
 static int jack_do_has_session_cb (jack_engine_t *engine, jack_request_t *req);
@@ -372,7 +383,8 @@ jack_engine_place_port_buffers (jack_engine_t* engine,
 			++bi;
 		}
 
-		/* update any existing output port offsets */
+		/* update any existing output port offsets, and
+		 * those of premixed inputs */
 		for (i = 0; i < engine->port_max; i++) {
 			jack_port_shared_t *port = &engine->control->ports[i];
 			if (port->in_use &&
@@ -382,6 +394,11 @@ jack_engine_place_port_buffers (jack_engine_t* engine,
 				if (bi) {
 					port->offset = bi->offset;
 				}
+			} else if (port->in_use &&
+				   port->ptype_id == ptid &&
+				   engine->internal_ports[i].mix) {
+				port->offset = engine->internal_ports[i].
+					mix->buffer_info->offset;
 			}
 		}
 
@@ -562,16 +579,13 @@ jack_set_buffer_size_request (jack_engine_t *engine, jack_nframes_t nframes)
 }
 
 
-static JSList * 
-jack_process_internal(jack_engine_t *engine, JSList *node,
-		      jack_nframes_t nframes)
+static void
+jack_call_internal_client (jack_engine_t *engine,
+			   jack_client_internal_t *client,
+			   jack_nframes_t nframes)
 {
-	jack_client_internal_t *client;
-	jack_client_control_t *ctl;
-	
-	client = (jack_client_internal_t *) node->data;
-	ctl = client->control;
-	
+	jack_client_control_t *ctl = client->control;
+
 	/* internal client */
 
 	DEBUG ("invoking an internal client's (%s) callbacks", ctl->name);
@@ -593,6 +607,15 @@ jack_process_internal(jack_engine_t *engine, JSList *node,
 		jack_call_timebase_master (client->private_client);
 		
 	ctl->state = Finished;
+}
+
+static JSList * 
+jack_process_internal(jack_engine_t *engine, JSList *node,
+		      jack_nframes_t nframes)
+{
+	jack_call_internal_client (engine,
+				   (jack_client_internal_t *) node->data,
+				   nframes);
 
 	if (engine->process_errors)
 		return NULL;		/* will stop the loop */
@@ -825,6 +848,424 @@ jack_process_external(jack_engine_t *engine, JSList *node)
 
 #endif /* JACK_USE_MACH_THREADS */
 
+#ifndef JACK_USE_MACH_THREADS
+
+/* Parallel execution.
+ *
+ * Every external client is its own subgraph (see
+ * jack_rechain_graph_direct()), so the engine can wake any number
+ * of them at once.  A client becomes runnable as soon as all of the
+ * distinct clients on whose sortfeeds list it appears have finished;
+ * the cycle then takes as long as the critical path through the
+ * graph rather than the sum of all clients.
+ *
+ * With futex wakeups or input premixing the same scheduler drives the
+ * serial chain too: jack_rechain_graph_direct() then makes each client
+ * feed the next one in engine->clients order.
+ */
+
+static inline int
+jack_engine_direct_graph (jack_engine_t *engine)
+{
+	return engine->parallel || engine->futex_wakeup || engine->premix;
+}
+
+static inline int
+jack_graph_client_skipped (jack_client_internal_t *client)
+{
+	return !client->control->active ||
+		(!client->control->process_cbset &&
+		 !client->control->thread_cb_cbset) ||
+		client->control->dead;
+}
+
+static inline void
+jack_graph_release (jack_engine_t *engine, jack_client_internal_t *client,
+		    unsigned int *nready)
+{
+	int i;
+
+	for (i = 0; i < client->graph_nfeeds; i++) {
+		jack_client_internal_t *dst = client->graph_feeds[i];
+		if (--dst->graph_pending == 0) {
+			engine->graph_ready[(*nready)++] = dst;
+		}
+	}
+}
+
+static int
+jack_graph_trigger (jack_engine_t *engine, jack_client_internal_t *client)
+{
+	char c = 0;
+
+	/* a race exists if we do this after the write(2) */
+	client->control->state = Triggered;
+	client->control->signalled_at = jack_get_microseconds();
+
+	engine->current_client = client;
+
+#ifdef JACK_USE_FUTEX
+	if (engine->futex_wakeup) {
+		client->control->graph_done = 0;
+		client->control->graph_syscalls = 0;
+		jack_futex_post (&client->control->graph_wake,
+				 JACK_WAKE_PROCESS);
+		engine->graph_triggered++;
+		engine->graph_syscalls++;
+		return 0;
+	}
+#endif /* JACK_USE_FUTEX */
+
+	DEBUG ("triggering %s, fd==%d", client->control->name,
+	       client->subgraph_start_fd);
+
+	if (write (client->subgraph_start_fd, &c, sizeof (c)) != sizeof (c)) {
+		jack_error ("cannot initiate graph processing (%s)",
+			    strerror (errno));
+		engine->process_errors++;
+		jack_engine_signal_problems (engine);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Returns 1 if a triggered client has signalled completion, 0 if it
+ * has not, -1 if it is gone.
+ */
+static int
+jack_graph_client_done (jack_engine_t *engine, jack_client_internal_t *client,
+			short revents)
+{
+	char c;
+
+#ifdef JACK_USE_FUTEX
+	if (engine->futex_wakeup) {
+		if (!client->control->graph_done) {
+			return 0;
+		}
+		engine->graph_syscalls += client->control->graph_syscalls;
+		return 1;
+	}
+#endif /* JACK_USE_FUTEX */
+
+	if (revents & ~POLLIN) {
+		jack_error ("subgraph starting at %s lost client",
+			    client->control->name);
+		return -1;
+	}
+
+	if (!(revents & POLLIN)) {
+		return 0;
+	}
+
+	if (read (client->subgraph_wait_fd, &c, sizeof (c)) != sizeof (c)) {
+		jack_error ("pp: cannot clean up byte from graph wait fd (%s)",
+			    strerror (errno));
+		return -1;
+	}
+
+	return 1;
+}
+
+#ifdef JACK_USE_FUTEX
+
+/* Wait until one of the running clients has set graph_done.
+ * Returns like poll(2): > 0 when something may have finished, 0 on
+ * timeout, -1 on error.
+ */
+static int
+jack_graph_futex_wait (jack_engine_t *engine, unsigned int nrunning,
+		       jack_time_t timeout_usecs)
+{
+	int32_t seq = engine->control->graph_futex.word;
+	unsigned int i;
+
+	/* clients bump graph_futex after setting graph_done */
+	__sync_synchronize ();
+
+	for (i = 0; i < nrunning; i++) {
+		if (engine->graph_running[i]->control->graph_done) {
+			return 1;
+		}
+	}
+
+	if (timeout_usecs == 0) {
+		return 0;
+	}
+
+	engine->graph_syscalls++;
+
+	if (jack_futex_wait (&engine->control->graph_futex, seq,
+			     timeout_usecs) == 0) {
+		return 1;
+	}
+
+	return errno == ETIMEDOUT ? 0 : -1;
+}
+
+#endif /* JACK_USE_FUTEX */
+
+/* Fill in the premixed inputs of a client that is about to run,
+ * unless another reader of the same mix already did this cycle.
+ */
+static void
+jack_client_premix (jack_engine_t *engine, jack_client_internal_t *client,
+		    jack_nframes_t nframes)
+{
+	char *segment = (char *) jack_shm_addr (
+		&engine->port_segment[JACK_AUDIO_PORT_TYPE]);
+	const float *src[JACK_MIX_BATCH];
+	jack_port_mix_t *mix;
+	unsigned int i, n;
+	JSList *node;
+
+	for (node = client->ports; node; node = jack_slist_next (node)) {
+		mix = ((jack_port_internal_t *) node->data)->mix;
+		if (mix == NULL || mix->mixed_cycle == engine->mix_cycle) {
+			continue;
+		}
+		for (i = 0; i < mix->nsources; i += n) {
+			for (n = 0; n < JACK_MIX_BATCH &&
+				     i + n < mix->nsources; n++) {
+				src[n] = (const float *) (segment +
+					mix->sources[i + n]->shared->offset);
+			}
+			jack_engine_mix ((float *) (segment +
+						    mix->buffer_info->offset),
+					 src, n, i > 0, nframes);
+		}
+		mix->mixed_cycle = engine->mix_cycle;
+	}
+}
+
+static int
+jack_engine_process_graph (jack_engine_t *engine, jack_nframes_t nframes)
+{
+	/* precondition: caller has graph_lock */
+	jack_client_internal_t *client;
+	JSList *node;
+	unsigned int nready = 0;
+	unsigned int nrunning = 0;
+	unsigned int i;
+	int pollret;
+	int timed_out = 0;
+	jack_time_t then, now;
+	jack_time_t poll_timeout_usecs;
+
+	engine->process_errors = 0;
+	engine->watchdog_check = 1;
+	engine->graph_triggered = 0;
+	engine->graph_syscalls = 0;
+	engine->mix_cycle++;
+
+	for (node = engine->clients, i = 0; node;
+	     node = jack_slist_next (node), i++) {
+		client = (jack_client_internal_t *) node->data;
+		if (i == engine->graph_size) {
+			/* jack_rechain_graph_direct() could not grow
+			   the scratch arrays for this many clients */
+			jack_error ("parallel graph state too small "
+				    "for %u+ clients", i + 1);
+			return 1;
+		}
+		client->control->state = NotTriggered;
+		client->control->timed_out = 0;
+		client->control->awake_at = 0;
+		client->control->finished_at = 0;
+		client->graph_pending = client->graph_fedcount;
+		if (client->graph_pending == 0) {
+			engine->graph_ready[nready++] = client;
+		}
+	}
+
+	if (engine->freewheeling) {
+		poll_timeout_usecs = 250000; /* 0.25 seconds */
+	} else {
+		poll_timeout_usecs = (engine->client_timeout_msecs > 0 ?
+				engine->client_timeout_msecs * 1000 :
+				engine->driver->period_usecs);
+	}
+
+	then = jack_get_microseconds ();
+
+	while (engine->process_errors == 0 && (nready || nrunning)) {
+
+		/* wake every external client that is ready first, so
+		 * that they run while this thread executes internal
+		 * clients.
+		 */
+
+		for (i = 0; i < nready; ) {
+			client = engine->graph_ready[i];
+			if (jack_graph_client_skipped (client) ||
+			    jack_client_is_internal (client)) {
+				i++;
+				continue;
+			}
+			if (engine->port_mixes) {
+				jack_client_premix (engine, client, nframes);
+			}
+			if (jack_graph_trigger (engine, client)) {
+				return 1;
+			}
+			engine->graph_pfd[nrunning].fd =
+				client->subgraph_wait_fd;
+			engine->graph_pfd[nrunning].events =
+				POLLERR|POLLIN|POLLHUP|POLLNVAL;
+			engine->graph_running[nrunning++] = client;
+			engine->graph_ready[i] = engine->graph_ready[--nready];
+		}
+
+		if (nready) {
+			client = engine->graph_ready[--nready];
+			if (!jack_graph_client_skipped (client)) {
+				if (engine->port_mixes) {
+					jack_client_premix (engine, client,
+							    nframes);
+				}
+				jack_call_internal_client (engine, client,
+							   nframes);
+			}
+			jack_graph_release (engine, client, &nready);
+			continue;
+		}
+
+		if (nrunning == 0) {
+			break;
+		}
+
+		now = jack_get_microseconds ();
+
+#ifdef JACK_USE_FUTEX
+		if (engine->futex_wakeup) {
+			pollret = jack_graph_futex_wait (
+				engine, nrunning,
+				timed_out || now - then >= poll_timeout_usecs ?
+				0 : poll_timeout_usecs - (now - then));
+		} else
+#endif /* JACK_USE_FUTEX */
+		if (timed_out) {
+			pollret = poll (engine->graph_pfd, nrunning, 0);
+		} else if (now - then < poll_timeout_usecs) {
+			pollret = poll (engine->graph_pfd, nrunning,
+					1 + (poll_timeout_usecs -
+					     (now - then)) / 1000);
+		} else {
+			pollret = 0;
+		}
+
+		if (pollret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			jack_error ("wait on process graph failed (%s)",
+				    strerror (errno));
+			engine->process_errors++;
+			break;
+		}
+
+		if (pollret == 0) {
+
+			if (timed_out) {
+				/* whoever is still running did not make
+				   it, even after jack_check_clients()
+				   gave them a chance to finish */
+				for (i = 0; i < nrunning; i++) {
+					engine->graph_running[i]->error++;
+				}
+				engine->process_errors++;
+				jack_engine_signal_problems (engine);
+				break;
+			}
+
+			if (engine->freewheeling) {
+				if (jack_check_client_status (engine)) {
+					engine->process_errors++;
+					break;
+				}
+				/* all clients are fine - we're just
+				   not done yet. */
+				then = jack_get_microseconds ();
+				continue;
+			}
+
+			now = jack_get_microseconds ();
+
+			if (now - then + 200 < poll_timeout_usecs) {
+				VERBOSE (engine, "FALSE WAKEUP (%" PRIu64
+					 " usecs vs. %" PRIu64 " usecs)",
+					 now - then, poll_timeout_usecs);
+				continue;
+			}
+
+			jack_error ("process graph timed out with %u "
+				    "client(s) still running (first: %s, "
+				    "state = %s)", nrunning,
+				    engine->graph_running[0]->control->name,
+				    jack_client_state_name
+				    (engine->graph_running[0]));
+
+			if (jack_check_clients (engine, 1)) {
+				engine->process_errors++;
+				break;
+			}
+
+			timed_out = 1;
+			continue;
+		}
+
+		for (i = 0; i < nrunning; ) {
+
+			client = engine->graph_running[i];
+
+			if ((pollret = jack_graph_client_done (
+				     engine, client,
+				     engine->graph_pfd[i].revents)) < 0) {
+				client->error++;
+				engine->process_errors++;
+				break;
+			}
+
+			if (pollret == 0) {
+				i++;
+				continue;
+			}
+
+			jack_graph_release (engine, client, &nready);
+
+			nrunning--;
+			engine->graph_running[i] =
+				engine->graph_running[nrunning];
+			engine->graph_pfd[i] = engine->graph_pfd[nrunning];
+		}
+
+		if (timed_out) {
+			/* the stragglers recovered; give whoever runs
+			   next a full timeout of their own */
+			timed_out = 0;
+			then = jack_get_microseconds ();
+		}
+	}
+
+	if (engine->process_errors == 0) {
+		engine->timeout_count = 0;
+	}
+
+	if (engine->futex_wakeup) {
+		unsigned int fifo_syscalls =
+			engine->graph_triggered * JACK_FIFO_WAKEUP_SYSCALLS;
+
+		engine->control->wakeup_syscalls_avoided =
+			fifo_syscalls > engine->graph_syscalls ?
+			fifo_syscalls - engine->graph_syscalls : 0;
+	}
+
+	return engine->process_errors > 0;
+}
+
+#endif /* !JACK_USE_MACH_THREADS */
+
 static int
 jack_engine_process (jack_engine_t *engine, jack_nframes_t nframes)
 {
@@ -832,6 +1273,12 @@ jack_engine_process (jack_engine_t *engine, jack_nframes_t nframes)
 	jack_client_internal_t *client;
 	JSList *node;
 
+#ifndef JACK_USE_MACH_THREADS
+	if (jack_engine_direct_graph (engine)) {
+		return jack_engine_process_graph (engine, nframes);
+	}
+#endif /* !JACK_USE_MACH_THREADS */
+
 	engine->process_errors = 0;
 	engine->watchdog_check = 1;
 
@@ -920,39 +1367,173 @@ jack_calc_cpu_load(jack_engine_t *engine)
 
 }
 
-static void
-jack_engine_post_process (jack_engine_t *engine)
-{
-	/* precondition: caller holds the graph lock. */
-
-	jack_transport_cycle_end (engine);
-	jack_calc_cpu_load (engine);
-	jack_check_clients (engine, 0);
-}
-
-#ifdef JACK_USE_MACH_THREADS
-
-static int
-jack_start_watchdog (jack_engine_t *engine)
+static inline void
+jack_timing_add (jack_timing_histogram_t *hist, float usecs, int timed_out)
 {
-	/* Stephane Letz : letz@grame.fr Watch dog thread is
-	 * not needed on MacOSX since CoreAudio drivers
-	 * already contains a similar mechanism.
-	 */
-	return 0;
+	hist->count++;
+	hist->total_usecs += (uint32_t) usecs;
+	if (usecs > hist->max_usecs) {
+		hist->max_usecs = usecs;
+	}
+	if (timed_out) {
+		hist->timeouts++;
+	}
+	hist->buckets[jack_timing_bucket ((uint32_t) usecs)]++;
 }
 
-void
-jack_stop_watchdog (jack_engine_t *engine)
+/* Append this cycle to the statistics ring, see jack_stats_ring_t,
+ * and add the clients' timing to their histograms.  Client records
+ * are reserved (client_head advanced) before they are written, so
+ * that readers can tell which ones they lost.
+ */
+static void
+jack_engine_record_cycle (jack_engine_t *engine, jack_nframes_t nframes,
+			  float delayed_usecs)
 {
-	/* Stephane Letz : letz@grame.fr Watch dog thread is
-	 * not needed on MacOSX since CoreAudio drivers
-	 * already contains a similar mechanism.
-	 */
-	return;
-}
+	jack_stats_ring_t *ring = engine->stats;
+	uint64_t cycle = ring->cycle_head + 1;
+	uint64_t first = ring->client_head;
+	jack_stats_slot_t *slot =
+		&ring->cycles[cycle & (JACK_STATS_CYCLES - 1)];
+	jack_time_t now = jack_get_microseconds ();
+	jack_time_t wakeup, woken_by;
+	jack_client_cycle_stats_t *cs;
+	jack_client_internal_t *client;
+	jack_client_control_t *ctl;
+	uint32_t nclients = 0;
+	uint32_t flags = 0;
+	JSList *node;
 
-#else
+	/* precondition: caller holds the graph lock */
+
+	/* freewheeling cycles run back to back, without a driver */
+	if (engine->freewheeling && engine->stats_cycle_end) {
+		wakeup = engine->stats_cycle_end;
+	} else {
+		wakeup = engine->control->current_time.usecs;
+	}
+	woken_by = wakeup;
+
+	/* only clients that got to run have timestamps; internal
+	   clients never do */
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t *) node->data;
+		if (client->timing_reset) {
+			memset (&client->timing, 0, sizeof (client->timing));
+			client->timing_reset = 0;
+		}
+		if (client->control->awake_at) {
+			nclients++;
+		}
+	}
+
+	slot->seq = 0;
+	ring->client_head = first + nclients;
+	__sync_synchronize ();
+
+	nclients = 0;
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t *) node->data;
+		ctl = client->control;
+		if (ctl->awake_at == 0) {
+			continue;
+		}
+
+		/* in a FIFO chain only the first client is signalled
+		   by the engine, the others by their predecessor */
+		if (ctl->signalled_at >= wakeup) {
+			woken_by = ctl->signalled_at;
+		}
+
+		cs = &ring->clients[(first + nclients++) &
+				    (JACK_STATS_CLIENTS - 1)];
+		memcpy (cs->name, (const char *) ctl->name,
+			sizeof (cs->name));
+		cs->flags = 0;
+		cs->wake_usecs = ctl->awake_at > woken_by ?
+			ctl->awake_at - woken_by : 0;
+
+		if (ctl->finished_at && !ctl->timed_out) {
+			cs->run_usecs = ctl->finished_at > ctl->awake_at ?
+				ctl->finished_at - ctl->awake_at : 0;
+			woken_by = ctl->finished_at;
+		} else {
+			cs->run_usecs = now - ctl->awake_at;
+			cs->flags |= JackClientCycleTimedOut;
+		}
+
+		jack_timing_add (&client->timing.wake, cs->wake_usecs, 0);
+		jack_timing_add (&client->timing.run, cs->run_usecs,
+				 cs->flags & JackClientCycleTimedOut);
+	}
+
+	if (engine->stats_xrun) {
+		flags |= JackCycleXRun;
+		engine->stats_xrun = 0;
+	}
+	if (engine->process_errors) {
+		flags |= JackCycleClientError;
+	}
+	if (now > engine->control->frame_timer.next_wakeup) {
+		flags |= JackCycleLate;
+	}
+
+	slot->first_client = first;
+	slot->stats.cycle = cycle;
+	slot->stats.wakeup = wakeup;
+	slot->stats.driver_wait_usecs =
+		engine->stats_cycle_end && wakeup > engine->stats_cycle_end ?
+		wakeup - engine->stats_cycle_end : 0;
+	slot->stats.delayed_usecs = delayed_usecs;
+	slot->stats.process_usecs = now - wakeup;
+	slot->stats.nframes = nframes;
+	slot->stats.flags = flags;
+	slot->stats.nclients = nclients;
+	slot->stats.buffered_frames =
+		engine->driver ? engine->driver->buffered_frames : 0;
+	slot->stats.rate_ratio =
+		engine->driver ? engine->driver->rate_ratio : 0.0f;
+
+	__sync_synchronize ();
+	slot->seq = cycle;
+	ring->cycle_head = cycle;
+
+	engine->stats_cycle_end = now;
+}
+
+static void
+jack_engine_post_process (jack_engine_t *engine)
+{
+	/* precondition: caller holds the graph lock. */
+
+	jack_transport_cycle_end (engine);
+	jack_calc_cpu_load (engine);
+	jack_check_clients (engine, 0);
+}
+
+#ifdef JACK_USE_MACH_THREADS
+
+static int
+jack_start_watchdog (jack_engine_t *engine)
+{
+	/* Stephane Letz : letz@grame.fr Watch dog thread is
+	 * not needed on MacOSX since CoreAudio drivers
+	 * already contains a similar mechanism.
+	 */
+	return 0;
+}
+
+void
+jack_stop_watchdog (jack_engine_t *engine)
+{
+	/* Stephane Letz : letz@grame.fr Watch dog thread is
+	 * not needed on MacOSX since CoreAudio drivers
+	 * already contains a similar mechanism.
+	 */
+	return;
+}
+
+#else
 
 static void *
 jack_watchdog_thread (void *arg)
@@ -1321,6 +1902,10 @@ do_request (jack_engine_t *engine, jack_request_t *req, int *reply_fd)
 			 req->x.connect.destination_port);
 		break;
 
+	case ConnectBatch:
+		req->status = jack_do_connect_batch (engine, req, reply_fd);
+		break;
+
 	case ActivateClient:
 		req->status = jack_client_activate (engine, req->x.client_id);
 		break;
@@ -1428,6 +2013,16 @@ do_request (jack_engine_t *engine, jack_request_t *req, int *reply_fd)
 		jack_do_reserve_name (engine, req);
 		jack_unlock_graph (engine);
 		break;
+	case GetClientTiming:
+		jack_rdlock_graph (engine);
+		jack_do_get_client_timing (engine, req);
+		jack_unlock_graph (engine);
+		break;
+	case ResetClientTiming:
+		jack_rdlock_graph (engine);
+		jack_do_reset_client_timing (engine, req);
+		jack_unlock_graph (engine);
+		break;
 	case SessionReply:
 		jack_rdlock_graph (engine);
 		jack_do_session_reply (engine, req);
@@ -1777,7 +2372,8 @@ jack_engine_t *
 jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 		 const char *server_name, int temporary, int verbose,
 		 int client_timeout, unsigned int port_max, pid_t wait_pid,
-		 jack_nframes_t frame_time_offset, int nozombies, int timeout_count_threshold, JSList *drivers)
+		 jack_nframes_t frame_time_offset, int nozombies, int timeout_count_threshold,
+		 int parallel, int futex_wakeup, int premix, JSList *drivers)
 {
 	jack_engine_t *engine;
 	unsigned int i;
@@ -1850,9 +2446,43 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	engine->stop_freewheeling = 0;
 	engine->fwclient = 0;
 	engine->feedbackcount = 0;
+	engine->sort_order = NULL;
+	engine->sort_scratch = NULL;
+	engine->sort_nclients = 0;
+	engine->sort_max = 0;
+	engine->sort_mark = 0;
 	engine->wait_pid = wait_pid;
 	engine->nozombies = nozombies;
 	engine->timeout_count_threshold = timeout_count_threshold;
+#ifdef JACK_USE_MACH_THREADS
+	if (parallel) {
+		jack_info ("parallel execution is not supported on this "
+			   "platform, using the serial chain");
+		parallel = 0;
+	}
+#endif /* JACK_USE_MACH_THREADS */
+	engine->parallel = parallel;
+#ifndef JACK_USE_FUTEX
+	if (futex_wakeup) {
+		jack_info ("futex wakeups are not supported on this "
+			   "platform, using FIFOs");
+		futex_wakeup = 0;
+	}
+#endif /* !JACK_USE_FUTEX */
+	engine->futex_wakeup = futex_wakeup;
+#ifdef JACK_USE_MACH_THREADS
+	if (premix) {
+		jack_info ("input premixing is not supported on this "
+			   "platform, clients mix their own inputs");
+		premix = 0;
+	}
+#endif /* JACK_USE_MACH_THREADS */
+	engine->premix = premix;
+	engine->port_mixes = NULL;
+	engine->mix_cycle = 0;
+	if (premix) {
+		jack_engine_mix = jack_mix_select ();
+	}
 	engine->removing_clients = 0;
         engine->new_clients_allowed = 1;
 
@@ -1909,7 +2539,9 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	srandom (time ((time_t *) 0));
 
 	if (jack_shmalloc (sizeof (jack_control_t)
-			   + ((sizeof (jack_port_shared_t) * engine->port_max)),
+			   + ((sizeof (jack_port_shared_t) * engine->port_max))
+			   + jack_port_index_size (engine->port_max,
+				   jack_port_index_buckets (engine->port_max)),
 			   &engine->control_shm)) {
 		jack_error ("cannot create engine control shared memory "
 			    "segment (%s)", strerror (errno));
@@ -1972,6 +2604,7 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 
 	for (i = 0; i < engine->port_max; i++) {
 		engine->internal_ports[i].connections = 0;
+		engine->internal_ports[i].mix = NULL;
 	}
 
 	if (make_sockets (engine->server_name, engine->fds) < 0) {
@@ -1980,7 +2613,34 @@ jack_engine_new (int realtime, int rtpriority, int do_mlock, int do_unlock,
 	}
 
 	engine->control->port_max = engine->port_max;
+
+	if (jack_port_index_init (engine)) {
+		jack_error ("cannot allocate port index");
+		return NULL;
+	}
 	engine->control->real_time = realtime;
+	engine->control->futex_wakeup = engine->futex_wakeup;
+	engine->control->wakeup_syscalls_avoided = 0;
+
+	if (jack_shmalloc (sizeof (jack_stats_ring_t), &engine->stats_shm)) {
+		jack_error ("cannot create statistics shared memory "
+			    "segment (%s)", strerror (errno));
+		return NULL;
+	}
+
+	if (jack_attach_shm (&engine->stats_shm)) {
+		jack_error ("cannot attach to statistics shared memory"
+			    " (%s)", strerror (errno));
+		jack_destroy_shm (&engine->stats_shm);
+		return NULL;
+	}
+
+	engine->stats = (jack_stats_ring_t *)
+		jack_shm_addr (&engine->stats_shm);
+	memset (engine->stats, 0, sizeof (jack_stats_ring_t));
+	engine->stats_cycle_end = 0;
+	engine->stats_xrun = 0;
+	engine->control->stats_shm_index = engine->stats_shm.index;
 	
 	/* leave some headroom for other client threads to run
 	   with priority higher than the regular client threads
@@ -2078,6 +2738,7 @@ jack_engine_delay (jack_engine_t *engine, float delayed_usecs)
 	jack_event_t event;
 	
 	engine->control->frame_timer.reset_pending = 1;
+	engine->stats_xrun = 1;
 
 	engine->control->xrun_delayed_usecs = delayed_usecs;
 
@@ -2453,6 +3114,7 @@ jack_run_one_cycle (jack_engine_t *engine, jack_nframes_t nframes,
 	}
 
 	jack_engine_post_process (engine);
+	jack_engine_record_cycle (engine, nframes, delayed_usecs);
 
 	if (delayed_usecs > engine->control->max_delayed_usecs)
 		engine->control->max_delayed_usecs = delayed_usecs;
@@ -2582,6 +3244,24 @@ jack_engine_delete (jack_engine_t *engine)
 		shutdown (engine->pfd[i].fd, SHUT_RDWR);
 	}
 
+#ifdef JACK_USE_FUTEX
+	if (engine->futex_wakeup) {
+		JSList *node;
+
+		/* clients wait on their futex: make them look at the
+		   event socket */
+		for (node = engine->clients; node;
+		     node = jack_slist_next (node)) {
+			jack_client_internal_t *client =
+				(jack_client_internal_t *) node->data;
+			if (!jack_client_is_internal (client)) {
+				jack_futex_post (&client->control->graph_wake,
+						 JACK_WAKE_EVENT);
+			}
+		}
+	}
+#endif /* JACK_USE_FUTEX */
+
 	if (engine->driver) {
 		jack_driver_t* driver = engine->driver;
 
@@ -2620,6 +3300,10 @@ jack_engine_delete (jack_engine_t *engine)
 	VERBOSE (engine, "max delay reported by backend: %.3f usecs",
 		engine->control->max_delayed_usecs);
 
+	engine->stats = NULL;
+	jack_release_shm (&engine->stats_shm);
+	jack_destroy_shm (&engine->stats_shm);
+
 	/* free engine control shm segment */
 	engine->control = NULL;
 	VERBOSE (engine, "freeing engine shared memory");
@@ -2628,6 +3312,11 @@ jack_engine_delete (jack_engine_t *engine)
 
 	VERBOSE (engine, "max usecs: %.3f, engine deleted", engine->max_usecs);
 
+	free (engine->graph_ready);
+	free (engine->graph_running);
+	free (engine->graph_pfd);
+	free (engine->sort_order);
+	free (engine->sort_scratch);
 	free (engine);
 
 	jack_messagebuffer_exit();
@@ -2693,6 +3382,55 @@ static void jack_do_get_client_by_uuid ( jack_engine_t *engine, jack_request_t *
 	}
 }
 
+/* The RT thread may be adding to the histograms while they are
+ * copied; a reply can be off by the cycle in progress.
+ */
+static void
+jack_do_get_client_timing (jack_engine_t *engine, jack_request_t *req)
+{
+	jack_client_internal_t *client;
+	JSList *node;
+
+	req->status = -1;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t *) node->data;
+		if (strcmp ((const char *) client->control->name,
+			    req->x.client_timing.name) == 0) {
+			if (client->timing_reset) {
+				memset (&req->x.client_timing.timing, 0,
+					sizeof (jack_client_timing_t));
+			} else {
+				memcpy (&req->x.client_timing.timing,
+					&client->timing,
+					sizeof (jack_client_timing_t));
+			}
+			req->status = 0;
+			return;
+		}
+	}
+}
+
+static void
+jack_do_reset_client_timing (jack_engine_t *engine, jack_request_t *req)
+{
+	jack_client_internal_t *client;
+	JSList *node;
+
+	req->status = req->x.client_timing.name[0] ? -1 : 0;
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t *) node->data;
+		if (req->x.client_timing.name[0] == '\0' ||
+		    strcmp ((const char *) client->control->name,
+			    req->x.client_timing.name) == 0) {
+			/* cleared by the RT thread, the only writer */
+			client->timing_reset = 1;
+			req->status = 0;
+		}
+	}
+}
+
 static void jack_do_reserve_name ( jack_engine_t *engine, jack_request_t *req)
 {
 	jack_reserved_name_t *reservation;
@@ -3021,6 +3759,15 @@ jack_deliver_event (jack_engine_t *engine, jack_client_internal_t *client,
 				jack_engine_signal_problems (engine);
 			}
 
+#ifdef JACK_USE_FUTEX
+			/* the client sleeps on its futex, not on the
+			   event socket */
+			if (engine->futex_wakeup) {
+				jack_futex_post (&client->control->graph_wake,
+						 JACK_WAKE_EVENT);
+			}
+#endif /* JACK_USE_FUTEX */
+
  			if (client->error) {
  				status = -1;
  			} else {
@@ -3123,6 +3870,196 @@ jack_deliver_event (jack_engine_t *engine, jack_client_internal_t *client,
 	return status;
 }
 
+#ifndef JACK_USE_MACH_THREADS
+
+static int
+jack_graph_add_feed (jack_client_internal_t *src, jack_client_internal_t *dst)
+{
+	int i;
+
+	/* sortfeeds holds one entry per connection, we want each
+	   downstream client just once */
+
+	for (i = 0; i < src->graph_nfeeds; i++) {
+		if (src->graph_feeds[i] == dst) {
+			return 0;
+		}
+	}
+
+	if (src->graph_nfeeds == src->graph_feeds_max) {
+		jack_client_internal_t **feeds;
+		int max = src->graph_feeds_max ? src->graph_feeds_max * 2 : 8;
+
+		feeds = (jack_client_internal_t **)
+			realloc (src->graph_feeds, max * sizeof (*feeds));
+		if (feeds == NULL) {
+			jack_error ("cannot allocate parallel graph for "
+				    "client %s", src->control->name);
+			return -1;
+		}
+		src->graph_feeds = feeds;
+		src->graph_feeds_max = max;
+	}
+
+	src->graph_feeds[src->graph_nfeeds++] = dst;
+	dst->graph_fedcount++;
+
+	return 0;
+}
+
+/* In parallel and futex modes every active external client gets a
+ * subgraph of its own, woken and waited for by the engine itself.
+ * With FIFOs the engine wakes it on FIFO n and it signals completion
+ * on FIFO n+1; with futexes no FIFO is used at all.  Clients see the
+ * same GraphReordered event as in the serial chain, with jackd as
+ * their upstream.
+ */
+static int
+jack_rechain_graph_direct (jack_engine_t *engine)
+{
+	JSList *node, *fnode;
+	unsigned long n;
+	unsigned int nclients;
+	int err = 0;
+	jack_client_internal_t *client, *prev;
+	jack_event_t event;
+
+	jack_clear_fifos (engine);
+
+	VERBOSE (engine, "++ jack_rechain_graph_direct():");
+
+	nclients = jack_slist_length (engine->clients);
+
+	if (nclients > engine->graph_size) {
+		/* each array is replaced only once it has been grown,
+		 * graph_size stays at the old value until all of them
+		 * have been, so the process path never runs over one.
+		 */
+		jack_client_internal_t **clients;
+		struct pollfd *pfd;
+
+		clients = (jack_client_internal_t **)
+			realloc (engine->graph_ready,
+				 nclients * sizeof (jack_client_internal_t *));
+		if (clients == NULL) {
+			goto nomem;
+		}
+		engine->graph_ready = clients;
+
+		clients = (jack_client_internal_t **)
+			realloc (engine->graph_running,
+				 nclients * sizeof (jack_client_internal_t *));
+		if (clients == NULL) {
+			goto nomem;
+		}
+		engine->graph_running = clients;
+
+		pfd = (struct pollfd *)
+			realloc (engine->graph_pfd,
+				 nclients * sizeof (struct pollfd));
+		if (pfd == NULL) {
+			goto nomem;
+		}
+		engine->graph_pfd = pfd;
+
+		engine->graph_size = nclients;
+	}
+
+	for (node = engine->clients; node; node = jack_slist_next (node)) {
+		client = (jack_client_internal_t *) node->data;
+		client->graph_nfeeds = 0;
+		client->graph_fedcount = 0;
+	}
+
+	for (node = engine->clients, prev = NULL; node;
+	     node = jack_slist_next (node)) {
+
+		client = (jack_client_internal_t *) node->data;
+
+		if (!engine->parallel) {
+			/* serial chain: each client feeds the next one
+			   that runs */
+			if (jack_graph_client_skipped (client)) {
+				continue;
+			}
+			if (prev && jack_graph_add_feed (prev, client)) {
+				err = -1;
+			}
+			prev = client;
+			continue;
+		}
+
+		for (fnode = client->sortfeeds; fnode;
+		     fnode = jack_slist_next (fnode)) {
+			if (jack_graph_add_feed (
+				    client,
+				    (jack_client_internal_t *) fnode->data)) {
+				err = -1;
+			}
+		}
+	}
+
+	event.type = GraphReordered;
+
+	for (n = 0, node = engine->clients; node; node = jack_slist_next (node)) {
+
+		client = (jack_client_internal_t *) node->data;
+
+		client->next_client = NULL;
+
+		if (!client->control->active ||
+		    (!client->control->process_cbset &&
+		     !client->control->thread_cb_cbset)) {
+			continue;
+		}
+
+		if (jack_client_is_internal (client)) {
+			VERBOSE (engine, "client %s: internal client, "
+				 "fed by %d client(s)",
+				 client->control->name,
+				 client->graph_fedcount);
+			jack_deliver_event (engine, client, &event);
+			continue;
+		}
+
+		client->execution_order = n;
+
+		if (engine->futex_wakeup) {
+			client->subgraph_start_fd = -1;
+			client->subgraph_wait_fd = -1;
+		} else {
+			client->subgraph_start_fd =
+				jack_get_fifo_fd (engine, n);
+			client->subgraph_wait_fd =
+				jack_get_fifo_fd (engine, n + 1);
+		}
+
+		VERBOSE (engine, "client %s: start_fd=%d, wait_fd=%d, "
+			 "execution_order=%lu, fed by %d client(s)",
+			 client->control->name,
+			 client->subgraph_start_fd,
+			 client->subgraph_wait_fd, n,
+			 client->graph_fedcount);
+
+		event.x.n = n;
+		event.y.n = 1;	/* upstream is jackd */
+		jack_deliver_event (engine, client, &event);
+
+		n += 2;
+	}
+
+	VERBOSE (engine, "-- jack_rechain_graph_direct()");
+
+	return err;
+
+  nomem:
+	jack_error ("cannot allocate parallel graph state for %u clients",
+		    nclients);
+	return -1;
+}
+
+#endif /* !JACK_USE_MACH_THREADS */
+
 int
 jack_rechain_graph (jack_engine_t *engine)
 {
@@ -3133,6 +4070,12 @@ jack_rechain_graph (jack_engine_t *engine)
 	jack_event_t event;
 	int upstream_is_jackd;
 
+#ifndef JACK_USE_MACH_THREADS
+	if (jack_engine_direct_graph (engine)) {
+		return jack_rechain_graph_direct (engine);
+	}
+#endif /* !JACK_USE_MACH_THREADS */
+
 	jack_clear_fifos (engine);
 
 	subgraph_client = 0;
@@ -3495,6 +4438,16 @@ jack_compute_new_latency (jack_engine_t *engine)
  * except that feedback connections appear normally instead of reversed.
  * This is used to detect whether the graph has become acyclic.
  *
+ * engine->sort_order holds the clients in an order that meets every
+ * sortfeeds constraint, and client->sort_index is each client's
+ * position in it.  Removing a connection cannot invalidate the order.
+ * Adding one from A to B only needs work if B currently comes before A:
+ * then the clients reachable from B that come before A are moved, in
+ * their relative order, to just after A (Marchetti-Spaccamela, Nanni
+ * and Rohnert).  The same bounded search answers whether B already
+ * feeds A, so finding feedback connections no longer walks the whole
+ * graph either, and sorting the client list is a plain sort by index.
+ *
  */ 
 
 void
@@ -3516,38 +4469,47 @@ static int
 jack_client_sort (jack_client_internal_t *a, jack_client_internal_t *b)
 {
 	/* drivers are forced to the front, ie considered as sources
-	   rather than sinks for purposes of the sort */
+	   rather than sinks for purposes of the sort.  nothing feeds
+	   a driver in the sortfeeds relation, so this agrees with
+	   the topological order */
 
-	if (jack_client_feeds_transitive (a, b) ||
-	    (a->control->type == ClientDriver &&
-	     b->control->type != ClientDriver)) {
+	if (a->control->type == ClientDriver &&
+	    b->control->type != ClientDriver) {
 		return -1;
-	} else if (jack_client_feeds_transitive (b, a) ||
-		   (b->control->type == ClientDriver &&
-		    a->control->type != ClientDriver)) {
+	} else if (b->control->type == ClientDriver &&
+		   a->control->type != ClientDriver) {
 		return 1;
+	} else if (a->sort_index < b->sort_index) {
+		return -1;
 	} else {
-		return 0;
+		return a->sort_index > b->sort_index;
 	}
 }
 
-/* transitive closure of the relation expressed by the sortfeeds lists. */
+/* depth-first search of the sortfeeds relation from client, marking
+ * every client reached that comes before dest in the sort order.
+ * returns 1 if dest itself is reached.
+ */
 static int
-jack_client_feeds_transitive (jack_client_internal_t *source,
-			      jack_client_internal_t *dest )
+jack_client_order_visit (jack_client_internal_t *client,
+			 jack_client_internal_t *dest, unsigned int mark)
 {
 	jack_client_internal_t *med;
 	JSList *node;
-	
-	if (jack_slist_find (source->sortfeeds, dest)) {
-		return 1;
-	}
 
-	for (node = source->sortfeeds; node; node = jack_slist_next (node)) {
+	client->sort_mark = mark;
+
+	for (node = client->sortfeeds; node; node = jack_slist_next (node)) {
 
 		med = (jack_client_internal_t *) node->data;
 
-		if (jack_client_feeds_transitive (med, dest)) {
+		if (med == dest) {
+			return 1;
+		}
+
+		if (med->sort_mark != mark &&
+		    med->sort_index < dest->sort_index &&
+		    jack_client_order_visit (med, dest, mark)) {
 			return 1;
 		}
 	}
@@ -3555,59 +4517,238 @@ jack_client_feeds_transitive (jack_client_internal_t *source,
 	return 0;
 }
 
-/**
- * Checks whether the graph has become acyclic and if so modifies client
- * sortfeeds lists to turn leftover feedback connections into normal ones.
- * This lowers latency, but at the expense of some data corruption.
+/* transitive closure of the relation expressed by the sortfeeds
+ * lists.  only clients between source and dest in the sort order can
+ * be on a path from one to the other.
+ */
+static int
+jack_client_feeds_transitive (jack_engine_t *engine,
+			      jack_client_internal_t *source,
+			      jack_client_internal_t *dest)
+{
+	if (source->sort_index > dest->sort_index) {
+		return 0;
+	}
+
+	return jack_client_order_visit (source, dest, ++engine->sort_mark);
+}
+
+/* restore the sort order after dest has been put on source's
+ * sortfeeds list.  the caller guarantees that this did not create a
+ * cycle.
  */
 static void
-jack_check_acyclic (jack_engine_t *engine)
+jack_client_order_edge (jack_engine_t *engine,
+			jack_client_internal_t *source,
+			jack_client_internal_t *dest)
 {
-	JSList *srcnode, *dstnode, *portnode, *connnode;
-	jack_client_internal_t *src, *dst;
-	jack_port_internal_t *port;
-	jack_connection_internal_t *conn;
-	int stuck;
-	int unsortedclients = 0;
+	jack_client_internal_t *client;
+	unsigned int lb = dest->sort_index;
+	unsigned int ub = source->sort_index;
+	unsigned int mark, i, n, nmoved;
 
-	VERBOSE (engine, "checking for graph become acyclic");
+	if (lb > ub) {
+		return;
+	}
 
-	for (srcnode = engine->clients; srcnode;
-	     srcnode = jack_slist_next (srcnode)) {
+	/* mark what has to move: dest and everything it feeds up to
+	   (and, the graph being acyclic, excluding) source */
+	mark = ++engine->sort_mark;
+	jack_client_order_visit (dest, source, mark);
+
+	for (i = lb, n = lb, nmoved = 0; i <= ub; i++) {
+		client = engine->sort_order[i];
+		if (client->sort_mark == mark) {
+			engine->sort_scratch[nmoved++] = client;
+		} else {
+			client->sort_index = n;
+			engine->sort_order[n++] = client;
+		}
+	}
+
+	for (i = 0; i < nmoved; i++) {
+		client = engine->sort_scratch[i];
+		client->sort_index = n;
+		engine->sort_order[n++] = client;
+	}
+
+	VERBOSE (engine, "sort order: moved %u clients after %s", nmoved,
+		 source->control->name);
+}
+
+/* recompute the whole sort order (Kahn's algorithm).  used when many
+ * sortfeeds entries change at once.
+ */
+static void
+jack_client_order_rebuild (jack_engine_t *engine)
+{
+	jack_client_internal_t *client, *dst;
+	jack_client_internal_t **order;
+	JSList *node;
+	unsigned int i, head, tail;
+
+	for (i = 0; i < engine->sort_nclients; i++) {
+		engine->sort_order[i]->tfedcount = 0;
+	}
+
+	for (i = 0; i < engine->sort_nclients; i++) {
+		client = engine->sort_order[i];
+		for (node = client->sortfeeds; node;
+		     node = jack_slist_next (node)) {
+			((jack_client_internal_t *) node->data)->tfedcount++;
+		}
+	}
+
+	order = engine->sort_scratch;
+	head = tail = 0;
+
+	for (i = 0; i < engine->sort_nclients; i++) {
+		client = engine->sort_order[i];
+		if (client->tfedcount == 0) {
+			order[tail++] = client;
+		}
+	}
+
+	while (head < tail) {
+		client = order[head++];
+		for (node = client->sortfeeds; node;
+		     node = jack_slist_next (node)) {
+			dst = (jack_client_internal_t *) node->data;
+			if (--dst->tfedcount == 0) {
+				order[tail++] = dst;
+			}
+		}
+	}
+
+	if (tail < engine->sort_nclients) {
+		/* cannot happen, the sortfeeds relation is acyclic */
+		jack_error ("sortfeeds relation is cyclic, %u clients left"
+			    " in place", engine->sort_nclients - tail);
+		for (i = 0; i < engine->sort_nclients; i++) {
+			client = engine->sort_order[i];
+			if (client->tfedcount > 0) {
+				order[tail++] = client;
+			}
+		}
+	}
+
+	engine->sort_scratch = engine->sort_order;
+	engine->sort_order = order;
+
+	for (i = 0; i < engine->sort_nclients; i++) {
+		engine->sort_order[i]->sort_index = i;
+	}
+}
+
+int
+jack_client_order_add (jack_engine_t *engine, jack_client_internal_t *client)
+{
+	/* caller must hold the client_lock */
+
+	if (engine->sort_nclients == engine->sort_max) {
+
+		unsigned int max = engine->sort_max ? engine->sort_max * 2 : 16;
+		jack_client_internal_t **order, **scratch;
+
+		order = (jack_client_internal_t **)
+			realloc (engine->sort_order,
+				 max * sizeof (jack_client_internal_t *));
+		if (order == NULL) {
+			return -1;
+		}
+		engine->sort_order = order;
+
+		scratch = (jack_client_internal_t **)
+			realloc (engine->sort_scratch,
+				 max * sizeof (jack_client_internal_t *));
+		if (scratch == NULL) {
+			return -1;
+		}
+		engine->sort_scratch = scratch;
+		engine->sort_max = max;
+	}
+
+	/* a new client has no connections, so it can go anywhere */
+	client->sort_index = engine->sort_nclients;
+	client->sort_mark = 0;
+	engine->sort_order[engine->sort_nclients++] = client;
+
+	return 0;
+}
+
+void
+jack_client_order_remove (jack_engine_t *engine,
+			  jack_client_internal_t *client)
+{
+	unsigned int i;
+
+	/* caller must hold the client_lock */
+
+	if (client->sort_index >= engine->sort_nclients ||
+	    engine->sort_order[client->sort_index] != client) {
+		return;
+	}
+
+	for (i = client->sort_index + 1; i < engine->sort_nclients; i++) {
+		engine->sort_order[i-1] = engine->sort_order[i];
+		engine->sort_order[i-1]->sort_index = i - 1;
+	}
+
+	engine->sort_nclients--;
+}
+
+/**
+ * Checks whether the graph has become acyclic and if so modifies client
+ * sortfeeds lists to turn leftover feedback connections into normal ones.
+ * This lowers latency, but at the expense of some data corruption.
+ */
+static void
+jack_check_acyclic (jack_engine_t *engine)
+{
+	JSList *srcnode, *dstnode, *portnode, *connnode;
+	jack_client_internal_t *src, *dst;
+	jack_port_internal_t *port;
+	jack_connection_internal_t *conn;
+	jack_client_internal_t **queue;
+	unsigned int head, tail;
+	int stuck;
+	int unsortedclients = 0;
+
+	VERBOSE (engine, "checking for graph become acyclic");
+
+	/* find out whether a normal sort would have been possible */
+	queue = engine->sort_scratch;
+	head = tail = 0;
+
+	for (srcnode = engine->clients; srcnode;
+	     srcnode = jack_slist_next (srcnode)) {
 
 		src = (jack_client_internal_t *) srcnode->data;
 		src->tfedcount = src->fedcount;
 		unsortedclients++;
+
+		if (!src->tfedcount) {
+			queue[tail++] = src;
+		}
 	}
 	
-	stuck = FALSE;
+	while (head < tail) {
 
-	/* find out whether a normal sort would have been possible */
-	while (unsortedclients && !stuck) {
-	
-		stuck = TRUE;
+		src = queue[head++];
+		unsortedclients--;
 
-		for (srcnode = engine->clients; srcnode;
-	     	     srcnode = jack_slist_next (srcnode)) {
+		for (dstnode = src->truefeeds; dstnode;
+		     dstnode = jack_slist_next (dstnode)) {
+		     
+			dst = (jack_client_internal_t *) dstnode->data;
 
-			src = (jack_client_internal_t *) srcnode->data;
-			
-			if (!src->tfedcount) {
-			
-				stuck = FALSE;
-				unsortedclients--;
-				src->tfedcount = -1;
-				
-				for (dstnode = src->truefeeds; dstnode;
-				     dstnode = jack_slist_next (dstnode)) {
-				     
-					dst = (jack_client_internal_t *)
-						dstnode->data;
-					dst->tfedcount--;
-				}
+			if (--dst->tfedcount == 0) {
+				queue[tail++] = dst;
 			}
 		}
 	}
+
+	stuck = (unsortedclients != 0);
 	
 	if (stuck) {
 
@@ -3658,6 +4799,7 @@ jack_check_acyclic (jack_engine_t *engine)
 			}
 		}
 		engine->feedbackcount = 0;
+		jack_client_order_rebuild (engine);
 	}
 }
 
@@ -3727,16 +4869,243 @@ void jack_dump_configuration(jack_engine_t *engine, int take_lock)
 	jack_info("engine.c: <-- dump ends -->");
 }
 
-int 
-jack_port_do_connect (jack_engine_t *engine,
-		       const char *source_port,
-		       const char *destination_port)
+/* Input premixing.
+ *
+ * When several input ports are connected to the same set of output
+ * ports, each of their owners would otherwise mix that set into a
+ * private buffer on every cycle.  With the premix option the engine
+ * keeps one jack_port_mix_t per distinct set instead, holding a
+ * buffer from the port segment, and fills it in once per cycle just
+ * before it wakes the first client that reads it (see
+ * jack_client_premix()).  Clients find the buffer through the offset
+ * of the input port, which is zero (the silent buffer) otherwise.
+ *
+ * Only audio inputs of non-driver clients whose connections are all
+ * forward are premixed: every source has then finished by the time
+ * any of the readers runs, so they all see the same mix.  If the
+ * segment has no spare buffer, the client mixes as before.
+ */
+
+static void
+jack_port_release_mix (jack_engine_t *engine, jack_port_internal_t *port)
 {
-	jack_connection_internal_t *connection;
-	jack_port_internal_t *srcport, *dstport;
-	jack_port_id_t src_id, dst_id;
+	jack_port_mix_t *mix = port->mix;
+	jack_port_buffer_list_t *blist;
+
+	/* precondition: caller holds the graph lock */
+
+	if (mix == NULL) {
+		return;
+	}
+
+	port->mix = NULL;
+	port->shared->offset = 0;
+
+	if (--mix->refcount) {
+		return;
+	}
+
+	blist = jack_port_buffer_list (engine, port);
+	pthread_mutex_lock (&blist->lock);
+	blist->freelist = jack_slist_prepend (blist->freelist,
+					      mix->buffer_info);
+	pthread_mutex_unlock (&blist->lock);
+
+	engine->port_mixes = jack_slist_remove (engine->port_mixes, mix);
+	free (mix->sources);
+	free (mix);
+}
+
+static int
+jack_port_mix_source_cmp (const void *a, const void *b)
+{
+	jack_port_id_t ida = (*(jack_port_internal_t **) a)->shared->id;
+	jack_port_id_t idb = (*(jack_port_internal_t **) b)->shared->id;
+
+	return ida < idb ? -1 : ida > idb;
+}
+
+static void
+jack_port_update_mix (jack_engine_t *engine, jack_port_internal_t *port)
+{
+	jack_client_internal_t *client;
+	jack_port_internal_t **sources;
+	jack_port_buffer_list_t *blist;
+	jack_port_mix_t *mix;
+	unsigned int nsources, i;
+	JSList *node;
+
+	/* precondition: caller holds the graph lock */
+
+	if (!engine->premix ||
+	    port->shared->ptype_id != JACK_AUDIO_PORT_TYPE ||
+	    !(port->shared->flags & JackPortIsInput)) {
+		return;
+	}
+
+	nsources = jack_slist_length (port->connections);
+	client = jack_client_internal_by_id (engine, port->shared->client_id);
+
+	if (nsources < 2 || client == NULL ||
+	    client->control->type == ClientDriver) {
+		jack_port_release_mix (engine, port);
+		return;
+	}
+
+	if ((sources = (jack_port_internal_t **)
+	     malloc (nsources * sizeof (jack_port_internal_t *))) == NULL) {
+		jack_port_release_mix (engine, port);
+		return;
+	}
+
+	for (i = 0, node = port->connections; node;
+	     node = jack_slist_next (node)) {
+		jack_connection_internal_t *c =
+			(jack_connection_internal_t *) node->data;
+		if (c->dir != 1) {
+			free (sources);
+			jack_port_release_mix (engine, port);
+			return;
+		}
+		sources[i++] = c->source;
+	}
+
+	qsort (sources, nsources, sizeof (jack_port_internal_t *),
+	       jack_port_mix_source_cmp);
+
+	for (node = engine->port_mixes; node; node = jack_slist_next (node)) {
+		mix = (jack_port_mix_t *) node->data;
+		if (mix->nsources == nsources &&
+		    memcmp (mix->sources, sources,
+			    nsources * sizeof (jack_port_internal_t *)) == 0) {
+			break;
+		}
+	}
+
+	if (node && mix == port->mix) {
+		free (sources);
+		return;
+	}
+
+	jack_port_release_mix (engine, port);
+
+	if (node) {
+		free (sources);
+	} else {
+		if ((mix = (jack_port_mix_t *)
+		     malloc (sizeof (jack_port_mix_t))) == NULL) {
+			free (sources);
+			return;
+		}
+
+		blist = jack_port_buffer_list (engine, port);
+		pthread_mutex_lock (&blist->lock);
+		if (blist->freelist == NULL) {
+			pthread_mutex_unlock (&blist->lock);
+			VERBOSE (engine, "no buffer to premix %s, "
+				 "client mixes it", port->shared->name);
+			free (sources);
+			free (mix);
+			return;
+		}
+		mix->buffer_info = (jack_port_buffer_info_t *)
+			blist->freelist->data;
+		blist->freelist = jack_slist_remove (blist->freelist,
+						     mix->buffer_info);
+		pthread_mutex_unlock (&blist->lock);
+
+		mix->sources = sources;
+		mix->nsources = nsources;
+		mix->refcount = 0;
+		mix->mixed_cycle = engine->mix_cycle;
+		engine->port_mixes = jack_slist_prepend (engine->port_mixes,
+							 mix);
+
+		VERBOSE (engine, "premixing %u connections of %s",
+			 nsources, port->shared->name);
+	}
+
+	mix->refcount++;
+	port->mix = mix;
+	port->shared->offset = mix->buffer_info->offset;
+}
+
+/* Whether srcport feeds dstport once the first n operations of a
+ * connection batch, those that passed validation, have been applied.
+ */
+static int
+jack_batch_connected (jack_port_internal_t *srcport,
+		      jack_port_internal_t *dstport,
+		      const jack_connection_op_t *ops,
+		      const jack_connection_internal_t *conns, uint32_t n)
+{
+	JSList *node;
+	uint32_t i;
+	int connected = 0;
+
+	for (node = srcport->connections; node; node = jack_slist_next (node)) {
+		if (((jack_connection_internal_t *) node->data)->destination
+		    == dstport) {
+			connected = 1;
+			break;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ops[i].status == 0 && conns[i].source == srcport &&
+		    conns[i].destination == dstport) {
+			connected = ops[i].connect;
+		}
+	}
+
+	return connected;
+}
+
+/* The port feeding dstport, which has no mixdown and so at most one
+ * connection, once the first n operations of a connection batch have
+ * been applied; NULL if there is none.
+ */
+static jack_port_internal_t *
+jack_batch_feeder (jack_port_internal_t *dstport,
+		   const jack_connection_op_t *ops,
+		   const jack_connection_internal_t *conns, uint32_t n)
+{
+	jack_port_internal_t *feeder = NULL;
+	uint32_t i;
+
+	if (dstport->connections) {
+		feeder = ((jack_connection_internal_t *)
+			  dstport->connections->data)->source;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ops[i].status != 0 || conns[i].destination != dstport) {
+			continue;
+		}
+		if (ops[i].connect) {
+			feeder = conns[i].source;
+		} else if (conns[i].source == feeder) {
+			feeder = NULL;
+		}
+	}
+
+	return feeder;
+}
+
+/* Look up and validate both ends of a connection.  When it is part of
+ * a batch, ops and conns hold the n operations before it, which are
+ * applied first.  The caller holds the graph lock.
+ */
+static int
+jack_port_connect_check (jack_engine_t *engine,
+			 const char *source_port,
+			 const char *destination_port,
+			 jack_connection_internal_t *connection,
+			 const jack_connection_op_t *ops,
+			 const jack_connection_internal_t *conns, uint32_t n)
+{
+	jack_port_internal_t *srcport, *dstport, *feeder;
 	jack_client_internal_t *srcclient, *dstclient;
-	JSList *it;
 
 	if ((srcport = jack_get_port_by_name (engine, source_port)) == NULL) {
 		jack_error ("unknown source port in attempted connection [%s]",
@@ -3771,6 +5140,16 @@ jack_port_do_connect (jack_engine_t *engine,
 		return -1;
 	}
 
+	if (!dstport->shared->has_mixdown &&
+	    (feeder = jack_batch_feeder (dstport, ops, conns, n)) != NULL &&
+	    feeder != srcport) {
+		jack_port_type_info_t *port_type =
+			jack_port_type_info (engine, dstport);
+		jack_error ("cannot make multiple connections to a port of"
+			    " type [%s]", port_type->type_name);
+		return -1;
+	}
+
 	if ((srcclient = jack_client_internal_by_id (engine,
 						  srcport->shared->client_id))
 	    == 0) {
@@ -3799,149 +5178,186 @@ jack_port_do_connect (jack_engine_t *engine,
 		return -1;
 	}
 
+	connection->source = srcport;
+	connection->destination = dstport;
+	connection->srcclient = srcclient;
+	connection->dstclient = dstclient;
+
+	return 0;
+}
+
+/* Make a connection validated by jack_port_connect_check().  The
+ * connection is allocated by the caller, so this cannot fail: it is
+ * either linked in or, with EEXIST, freed.  The caller holds the graph
+ * lock and sorts the graph afterwards.
+ */
+static int
+jack_port_connect_internal (jack_engine_t *engine,
+			    jack_connection_internal_t *connection)
+{
+	jack_port_internal_t *srcport = connection->source;
+	jack_port_internal_t *dstport = connection->destination;
+	jack_client_internal_t *srcclient = connection->srcclient;
+	jack_client_internal_t *dstclient = connection->dstclient;
+	jack_port_id_t src_id, dst_id;
+	JSList *it;
+
 	for (it = srcport->connections; it; it = it->next) {
 		if (((jack_connection_internal_t *)it->data)->destination
 		    == dstport) {
+			free (connection);
 			return EEXIST;
 		}
 	}
 
-	connection = (jack_connection_internal_t *)
-		malloc (sizeof (jack_connection_internal_t));
-
-	connection->source = srcport;
-	connection->destination = dstport;
-	connection->srcclient = srcclient;
-	connection->dstclient = dstclient;
-
 	src_id = srcport->shared->id;
 	dst_id = dstport->shared->id;
 
-	jack_lock_graph (engine);
+	if (dstclient->control->type == ClientDriver)
+	{
+		/* Ignore output connections to drivers for purposes
+		   of sorting. Drivers are executed first in the sort
+		   order anyway, and we don't want to treat graphs
+		   such as driver -> client -> driver as containing
+		   feedback */
+		
+		VERBOSE (engine,
+			 "connect %s and %s (output)",
+			 srcport->shared->name,
+			 dstport->shared->name);
 
-	if (dstport->connections && !dstport->shared->has_mixdown) {
-		jack_port_type_info_t *port_type =
-			jack_port_type_info (engine, dstport);
-		jack_error ("cannot make multiple connections to a port of"
-			    " type [%s]", port_type->type_name);
-		free (connection);
-		jack_unlock_graph (engine);
-		return -1;
-	} else {
+		connection->dir = 1;
 
-		if (dstclient->control->type == ClientDriver)
-		{
-			/* Ignore output connections to drivers for purposes
-			   of sorting. Drivers are executed first in the sort
-			   order anyway, and we don't want to treat graphs
-			   such as driver -> client -> driver as containing
-			   feedback */
+	}
+	else if (srcclient != dstclient) {
+	
+		srcclient->truefeeds = jack_slist_prepend
+			(srcclient->truefeeds, dstclient);
+
+		dstclient->fedcount++;				
+
+		if (jack_client_feeds_transitive (engine, dstclient,
+						  srcclient ) ||
+		    (dstclient->control->type == ClientDriver &&
+		     srcclient->control->type != ClientDriver)) {
+	    
+			/* dest is running before source so
+			   this is a feedback connection */
 			
 			VERBOSE (engine,
-				 "connect %s and %s (output)",
+				 "connect %s and %s (feedback)",
 				 srcport->shared->name,
 				 dstport->shared->name);
+			 
+			dstclient->sortfeeds = jack_slist_prepend
+				(dstclient->sortfeeds, srcclient);
+			jack_client_order_edge (engine, dstclient,
+						srcclient);
+
+			connection->dir = -1;
+			engine->feedbackcount++;
+			VERBOSE (engine,
+				 "feedback count up to %d",
+				 engine->feedbackcount);
 
-			connection->dir = 1;
+		} else {
+	
+			/* this is not a feedback connection */
+
+			VERBOSE (engine,
+				 "connect %s and %s (forward)",
+				 srcport->shared->name,
+				 dstport->shared->name);
+
+			srcclient->sortfeeds = jack_slist_prepend
+				(srcclient->sortfeeds, dstclient);
+			jack_client_order_edge (engine, srcclient,
+						dstclient);
 
+			connection->dir = 1;
 		}
-		else if (srcclient != dstclient) {
-		
-			srcclient->truefeeds = jack_slist_prepend
-				(srcclient->truefeeds, dstclient);
-
-			dstclient->fedcount++;				
-
-			if (jack_client_feeds_transitive (dstclient,
-							  srcclient ) ||
-			    (dstclient->control->type == ClientDriver &&
-			     srcclient->control->type != ClientDriver)) {
-		    
-				/* dest is running before source so
-				   this is a feedback connection */
-				
-				VERBOSE (engine,
-					 "connect %s and %s (feedback)",
-					 srcport->shared->name,
-					 dstport->shared->name);
-				 
-				dstclient->sortfeeds = jack_slist_prepend
-					(dstclient->sortfeeds, srcclient);
-
-				connection->dir = -1;
-				engine->feedbackcount++;
-				VERBOSE (engine,
-					 "feedback count up to %d",
-					 engine->feedbackcount);
+	}
+	else
+	{
+		/* this is a connection to self */
 
-			} else {
+		VERBOSE (engine,
+			 "connect %s and %s (self)",
+			 srcport->shared->name,
+			 dstport->shared->name);
 		
-				/* this is not a feedback connection */
+		connection->dir = 0;
+	}
 
-				VERBOSE (engine,
-					 "connect %s and %s (forward)",
-					 srcport->shared->name,
-					 dstport->shared->name);
+	dstport->connections =
+		jack_slist_prepend (dstport->connections, connection);
+	srcport->connections =
+		jack_slist_prepend (srcport->connections, connection);
 
-				srcclient->sortfeeds = jack_slist_prepend
-					(srcclient->sortfeeds, dstclient);
+	jack_port_update_mix (engine, dstport);
+	
+	DEBUG ("actually sorted the graph...");
 
-				connection->dir = 1;
-			}
-		}
-		else
-		{
-			/* this is a connection to self */
+	jack_send_connection_notification (engine,
+					   srcport->shared->client_id,
+					   src_id, dst_id, TRUE);
+	
 
-			VERBOSE (engine,
-				 "connect %s and %s (self)",
-				 srcport->shared->name,
-				 dstport->shared->name);
-			
-			connection->dir = 0;
-		}
+	jack_send_connection_notification (engine,
+					   dstport->shared->client_id,
+					   dst_id, src_id, TRUE);
+					   
+	/* send a port connection notification just once to everyone who cares excluding clients involved in the connection */
 
-		dstport->connections =
-			jack_slist_prepend (dstport->connections, connection);
-		srcport->connections =
-			jack_slist_prepend (srcport->connections, connection);
-		
-		DEBUG ("actually sorted the graph...");
+	jack_notify_all_port_interested_clients (engine, srcport->shared->client_id, dstport->shared->client_id, src_id, dst_id, 1);
 
-		jack_send_connection_notification (engine,
-						   srcport->shared->client_id,
-						   src_id, dst_id, TRUE);
-		
+	return 0;
+}
 
-		jack_send_connection_notification (engine,
-						   dstport->shared->client_id,
-						   dst_id, src_id, TRUE);
-						   
-		/* send a port connection notification just once to everyone who cares excluding clients involved in the connection */
+int 
+jack_port_do_connect (jack_engine_t *engine,
+		       const char *source_port,
+		       const char *destination_port)
+{
+	jack_connection_internal_t *connection;
+	int ret;
 
-		jack_notify_all_port_interested_clients (engine, srcport->shared->client_id, dstport->shared->client_id, src_id, dst_id, 1);
+	if ((connection = (jack_connection_internal_t *)
+	     malloc (sizeof (jack_connection_internal_t))) == NULL) {
+		jack_error ("cannot allocate connection of %s and %s",
+			    source_port, destination_port);
+		return -1;
+	}
+
+	jack_lock_graph (engine);
 
+	if ((ret = jack_port_connect_check (engine, source_port,
+					    destination_port, connection,
+					    NULL, NULL, 0)) != 0) {
+		free (connection);
+	} else if ((ret = jack_port_connect_internal (engine,
+						      connection)) == 0) {
 		jack_sort_graph (engine);
 	}
 
 	jack_unlock_graph (engine);
 
-	return 0;
+	return ret;
 }
 
-int
-jack_port_disconnect_internal (jack_engine_t *engine, 
-			       jack_port_internal_t *srcport, 
-			       jack_port_internal_t *dstport )
-
+/* Remove one connection without re-sorting the graph.  The caller
+ * holds the graph lock.
+ */
+static int
+jack_port_unlink_ports (jack_engine_t *engine, 
+			jack_port_internal_t *srcport, 
+			jack_port_internal_t *dstport)
 {
 	JSList *node;
 	jack_connection_internal_t *connect;
 	int ret = -1;
 	jack_port_id_t src_id, dst_id;
-	int check_acyclic = engine->feedbackcount;
 
-	/* call tree **** MUST HOLD **** engine->client_lock. */
 	for (node = srcport->connections; node;
 	     node = jack_slist_next (node)) {
 
@@ -3961,6 +5377,8 @@ jack_port_disconnect_internal (jack_engine_t *engine,
 				jack_slist_remove (dstport->connections,
 						   connect);
 
+			jack_port_update_mix (engine, dstport);
+
 			src_id = srcport->shared->id;
 			dst_id = dstport->shared->id;
 
@@ -4027,6 +5445,21 @@ jack_port_disconnect_internal (jack_engine_t *engine,
 		}
 	}
 
+	return ret;
+}
+
+int
+jack_port_disconnect_internal (jack_engine_t *engine, 
+			       jack_port_internal_t *srcport, 
+			       jack_port_internal_t *dstport )
+
+{
+	int ret;
+	int check_acyclic = engine->feedbackcount;
+
+	/* call tree **** MUST HOLD **** engine->client_lock. */
+	ret = jack_port_unlink_ports (engine, srcport, dstport);
+
 	if (check_acyclic) {
 		jack_check_acyclic (engine);
 	}
@@ -4036,6 +5469,43 @@ jack_port_disconnect_internal (jack_engine_t *engine,
 	return ret;
 }
 
+/* Look up both ends of a disconnection. */
+static int
+jack_port_disconnect_check (jack_engine_t *engine,
+			    const char *source_port,
+			    const char *destination_port,
+			    jack_connection_internal_t *connection,
+			    const jack_connection_op_t *ops,
+			    const jack_connection_internal_t *conns,
+			    uint32_t n)
+{
+	if ((connection->source =
+	     jack_get_port_by_name (engine, source_port)) == NULL) {
+		jack_error ("unknown source port in attempted disconnection"
+			    " [%s]", source_port);
+		return -1;
+	}
+
+	if ((connection->destination =
+	     jack_get_port_by_name (engine, destination_port)) == NULL) {
+		jack_error ("unknown destination port in attempted"
+			    " disconnection [%s]", destination_port);
+		return -1;
+	}
+
+	/* a lone disconnect reports this itself; in a batch it has to
+	   be known before anything is applied */
+	if (ops && !jack_batch_connected (connection->source,
+					  connection->destination,
+					  ops, conns, n)) {
+		jack_error ("%s and %s are not connected",
+			    source_port, destination_port);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int
 jack_port_do_disconnect_all (jack_engine_t *engine,
 			     jack_port_id_t port_id)
@@ -4062,29 +5532,256 @@ jack_port_do_disconnect (jack_engine_t *engine,
 			 const char *source_port,
 			 const char *destination_port)
 {
-	jack_port_internal_t *srcport, *dstport;
-	int ret = -1;
+	jack_connection_internal_t connection;
+	int ret;
 
-	if ((srcport = jack_get_port_by_name (engine, source_port)) == NULL) {
-		jack_error ("unknown source port in attempted disconnection"
-			    " [%s]", source_port);
-		return -1;
+	if ((ret = jack_port_disconnect_check (engine, source_port,
+					       destination_port,
+					       &connection, NULL, NULL,
+					       0)) != 0) {
+		return ret;
 	}
 
-	if ((dstport = jack_get_port_by_name (engine, destination_port))
-	    == NULL) {
-		jack_error ("unknown destination port in attempted"
-			    " disconnection [%s]", destination_port);
+	jack_lock_graph (engine);
+
+	ret = jack_port_disconnect_internal (engine, connection.source,
+					     connection.destination);
+
+	jack_unlock_graph (engine);
+
+	return ret;
+}
+
+/* Apply a batch of connects and disconnects under a single graph lock
+ * and sort.  Every operation is validated, in the light of the ones
+ * before it, and every connection allocated before any of them is
+ * applied, so applying them cannot fail; if one of them is invalid the
+ * batch is rejected as a whole and the others are marked ECANCELED.
+ * Per-operation results are left in ops[].status: 0, EEXIST for
+ * connections that already exist, or -1.  Returns the number of failed
+ * operations.
+ */
+static int
+jack_port_do_connect_batch (jack_engine_t *engine,
+			    jack_connection_op_t *ops, uint32_t nops)
+{
+	jack_connection_internal_t *conns;
+	jack_connection_internal_t **links;
+	uint32_t i;
+	int failed = 0;
+	int changed = 0;
+	int check_acyclic = 0;
+
+	if (nops == 0) {
+		return 0;
+	}
+
+	conns = (jack_connection_internal_t *)
+		malloc (nops * sizeof (jack_connection_internal_t));
+	links = (jack_connection_internal_t **)
+		calloc (nops, sizeof (jack_connection_internal_t *));
+	if (conns == NULL || links == NULL) {
+		jack_error ("cannot allocate connection batch of %" PRIu32
+			    " operations", nops);
+		free (conns);
+		free (links);
 		return -1;
 	}
 
 	jack_lock_graph (engine);
 
-	ret = jack_port_disconnect_internal (engine, srcport, dstport);
+	for (i = 0; i < nops; i++) {
+		ops[i].source_port[JACK_PORT_NAME_SIZE-1] = '\0';
+		ops[i].destination_port[JACK_PORT_NAME_SIZE-1] = '\0';
+		if (ops[i].connect) {
+			ops[i].status = jack_port_connect_check (
+				engine, ops[i].source_port,
+				ops[i].destination_port, &conns[i],
+				ops, conns, i);
+			if (ops[i].status == 0 &&
+			    (links[i] = (jack_connection_internal_t *)
+			     malloc (sizeof (jack_connection_internal_t)))
+			    == NULL) {
+				jack_error ("cannot allocate connection of"
+					    " %s and %s", ops[i].source_port,
+					    ops[i].destination_port);
+				ops[i].status = -1;
+			}
+		} else {
+			ops[i].status = jack_port_disconnect_check (
+				engine, ops[i].source_port,
+				ops[i].destination_port, &conns[i],
+				ops, conns, i);
+		}
+		if (ops[i].status) {
+			failed++;
+		}
+	}
+
+	if (failed) {
+		for (i = 0; i < nops; i++) {
+			if (ops[i].status == 0) {
+				ops[i].status = ECANCELED;
+			}
+		}
+		goto out;
+	}
+
+	for (i = 0; i < nops; i++) {
+		if (ops[i].connect) {
+			*links[i] = conns[i];
+			ops[i].status =
+				jack_port_connect_internal (engine, links[i]);
+			links[i] = NULL;
+		} else {
+			if (engine->feedbackcount) {
+				check_acyclic = 1;
+			}
+			ops[i].status = jack_port_unlink_ports (
+				engine, conns[i].source, conns[i].destination);
+		}
+		if (ops[i].status == 0) {
+			changed++;
+		} else if (ops[i].status != EEXIST) {
+			failed++;
+		}
+	}
+
+	if (check_acyclic) {
+		jack_check_acyclic (engine);
+	}
+
+	if (changed) {
+		jack_sort_graph (engine);
+	}
 
+  out:
 	jack_unlock_graph (engine);
 
-	return ret;
+	VERBOSE (engine, "connection batch: %" PRIu32 " operations,"
+		 " %d changed, %d failed", nops, changed, failed);
+
+	/* only those of a rejected batch are left */
+	for (i = 0; i < nops; i++) {
+		free (links[i]);
+	}
+	free (links);
+	free (conns);
+
+	return failed;
+}
+
+/* read() from a stream socket until len bytes have arrived */
+static int
+jack_read_fully (int fd, void *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		if ((n = read (fd, buf, len)) <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf = (char *) buf + n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* skip the nops operations of a ConnectBatch request that is not
+   going to be applied, so the next request is read from its start */
+static void
+jack_discard_connect_batch (int fd, uint32_t nops)
+{
+	jack_connection_op_t discard;
+	uint32_t i;
+
+	for (i = 0; i < nops; i++) {
+		if (jack_read_fully (fd, &discard, sizeof (discard))) {
+			break;
+		}
+	}
+}
+
+/* Failures return a negative status and leave the reply to do_request()'s
+ * caller: only a status >= 0 is followed by the nops statuses, see
+ * jack_connection_op_t.
+ */
+static int
+jack_do_connect_batch (jack_engine_t *engine, jack_request_t *req,
+		       int *reply_fd)
+{
+	jack_connection_op_t *ops;
+	uint32_t nops = req->x.connect_batch.nops;
+	int32_t *status;
+	uint32_t i;
+	size_t size;
+
+	if (reply_fd == NULL) {
+		/* internal client: the operations are in our address
+		 * space already */
+		return jack_port_do_connect_batch (
+			engine, req->x.connect_batch.ops, nops);
+	}
+
+	if (nops == 0) {
+		return 0;
+	}
+
+	if (nops > JACK_CONNECTION_BATCH_MAX) {
+		jack_error ("connection batch of %" PRIu32 " operations is"
+			    " too large", nops);
+		jack_discard_connect_batch (*reply_fd, nops);
+		return -1;
+	}
+
+	size = nops * sizeof (jack_connection_op_t);
+
+	if ((ops = (jack_connection_op_t *) malloc (size + sizeof (int32_t)
+						    * nops)) == NULL) {
+		jack_error ("cannot allocate connection batch of %" PRIu32
+			    " operations", nops);
+		jack_discard_connect_batch (*reply_fd, nops);
+		return -1;
+	}
+
+	if (jack_read_fully (*reply_fd, ops, size)) {
+		/* the client hung up or the socket broke, no later
+		   request can be read from it either */
+		jack_error ("cannot read connection batch from client (%s)",
+			    strerror (errno));
+		free (ops);
+		return -1;
+	}
+
+	req->status = jack_port_do_connect_batch (engine, ops, nops);
+
+	if (req->status < 0) {
+		free (ops);
+		return req->status;
+	}
+
+	status = (int32_t *) (ops + nops);
+	for (i = 0; i < nops; i++) {
+		status[i] = ops[i].status;
+	}
+
+	if (write (*reply_fd, req, sizeof (*req)) != sizeof (*req) ||
+	    write (*reply_fd, status, sizeof (int32_t) * nops)
+	    != (ssize_t) (sizeof (int32_t) * nops)) {
+		jack_error ("cannot write ConnectBatch result to client"
+			    " via fd = %d (%s)", *reply_fd, strerror (errno));
+	}
+
+	/* we have already replied, don't do it again */
+	*reply_fd = -1;
+
+	free (ops);
+
+	return req->status;
 }
 
 int 
@@ -4211,26 +5908,250 @@ jack_add_slave_driver (jack_engine_t *engine, jack_driver_t *driver)
 /* PORT RELATED FUNCTIONS */
 
 
-static jack_port_id_t
-jack_get_free_port (jack_engine_t *engine)
+/* Port name index, see jack_port_index_t.  Callers of everything
+ * below hold engine->port_lock, except for jack_port_index_init().
+ */
 
+static uint32_t
+jack_port_index_buckets (unsigned int port_max)
 {
-	jack_port_id_t i;
+	uint32_t nbuckets = 16;
 
-	pthread_mutex_lock (&engine->port_lock);
+	while (nbuckets < 2 * port_max) {
+		nbuckets <<= 1;
+	}
+
+	return nbuckets;
+}
+
+static int
+jack_port_index_init (jack_engine_t *engine)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	unsigned int i;
+
+	engine->port_free = (jack_port_id_t *)
+		malloc (sizeof (jack_port_id_t) * engine->port_max);
+	engine->port_index_bucket = (uint32_t *)
+		malloc (sizeof (uint32_t) * 3 * engine->port_max);
+	if (engine->port_free == NULL || engine->port_index_bucket == NULL) {
+		return -1;
+	}
 
+	/* an ascending array is a valid min-heap */
 	for (i = 0; i < engine->port_max; i++) {
-		if (engine->control->ports[i].in_use == 0) {
-			engine->control->ports[i].in_use = 1;
+		engine->port_free[i] = i;
+	}
+	engine->port_nfree = engine->port_max;
+
+	for (i = 0; i < 3 * engine->port_max; i++) {
+		engine->port_index_bucket[i] = JACK_PORT_INDEX_NONE;
+	}
+
+	index->seq = 0;
+	index->names_seen = 0;
+	index->nbuckets = jack_port_index_buckets (engine->port_max);
+	index->nentries = 3 * engine->port_max;
+	for (i = 0; i < index->nbuckets; i++) {
+		jack_port_index_heads (index)[i] = JACK_PORT_INDEX_NONE;
+	}
+	engine->control->port_name_changes = 0;
+	engine->control->port_generation = 0;
+
+	return 0;
+}
+
+static inline void
+jack_port_index_begin (jack_port_index_t *index)
+{
+	index->seq++;
+	__sync_synchronize ();
+}
+
+static inline void
+jack_port_index_end (jack_port_index_t *index)
+{
+	__sync_synchronize ();
+	index->seq++;
+}
+
+static void
+jack_port_index_link (jack_engine_t *engine, uint32_t entry,
+		      const char *name)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	volatile uint32_t *heads = jack_port_index_heads (index);
+	uint32_t bucket;
+
+	if (name[0] == '\0') {
+		return;
+	}
+
+	bucket = jack_port_name_hash (name) & (index->nbuckets - 1);
+	jack_port_index_next (index)[entry] = heads[bucket];
+	__sync_synchronize ();
+	heads[bucket] = entry;
+	engine->port_index_bucket[entry] = bucket;
+}
+
+static void
+jack_port_index_unlink (jack_engine_t *engine, uint32_t entry)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	volatile uint32_t *next = jack_port_index_next (index);
+	volatile uint32_t *link;
+	uint32_t bucket = engine->port_index_bucket[entry];
+
+	if (bucket == JACK_PORT_INDEX_NONE) {
+		return;
+	}
+
+	for (link = &jack_port_index_heads (index)[bucket];
+	     *link != entry; link = &next[*link])
+		;
+
+	*link = next[entry];
+	engine->port_index_bucket[entry] = JACK_PORT_INDEX_NONE;
+}
+
+static void
+jack_port_index_add (jack_engine_t *engine, jack_port_id_t id)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	jack_port_shared_t *shared = &engine->control->ports[id];
+
+	jack_port_index_begin (index);
+	jack_port_index_link (engine, 3 * id, shared->name);
+	jack_port_index_link (engine, 3 * id + 1, shared->alias1);
+	jack_port_index_link (engine, 3 * id + 2, shared->alias2);
+	jack_port_index_end (index);
+}
+
+static void
+jack_port_index_remove (jack_engine_t *engine, jack_port_id_t id)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+
+	jack_port_index_begin (index);
+	jack_port_index_unlink (engine, 3 * id);
+	jack_port_index_unlink (engine, 3 * id + 1);
+	jack_port_index_unlink (engine, 3 * id + 2);
+	jack_port_index_end (index);
+}
+
+/* Clients renamed ports or changed aliases behind our back: index
+ * all names again.
+ */
+static void
+jack_port_index_rebuild (jack_engine_t *engine)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	uint32_t changes = engine->control->port_name_changes;
+	jack_port_shared_t *shared;
+	jack_port_id_t id;
+	uint32_t i;
+
+	__sync_synchronize ();
+
+	jack_port_index_begin (index);
+
+	for (i = 0; i < index->nbuckets; i++) {
+		jack_port_index_heads (index)[i] = JACK_PORT_INDEX_NONE;
+	}
+	for (i = 0; i < index->nentries; i++) {
+		engine->port_index_bucket[i] = JACK_PORT_INDEX_NONE;
+	}
+
+	for (id = 0; id < engine->port_max; id++) {
+		shared = &engine->control->ports[id];
+		if (shared->in_use) {
+			jack_port_index_link (engine, 3 * id, shared->name);
+			jack_port_index_link (engine, 3 * id + 1,
+					      shared->alias1);
+			jack_port_index_link (engine, 3 * id + 2,
+					      shared->alias2);
+		}
+	}
+
+	index->names_seen = changes;
+	jack_port_index_end (index);
+}
+
+static jack_port_internal_t *
+jack_port_index_lookup (jack_engine_t *engine, const char *name)
+{
+	jack_port_index_t *index = jack_port_index (engine->control);
+	jack_port_id_t id;
+	int ret;
+
+	if (index->names_seen != engine->control->port_name_changes) {
+		jack_port_index_rebuild (engine);
+	}
+
+	if ((ret = jack_port_index_find (engine->control, name, &id)) < 0) {
+		/* renamed while we looked */
+		jack_port_index_rebuild (engine);
+		ret = jack_port_index_find (engine->control, name, &id);
+	}
+
+	return ret > 0 ? &engine->internal_ports[id] : NULL;
+}
+
+/* Free port ids are kept in a binary min-heap, so that the lowest
+ * unused id is handed out first, as the old scan of in_use did.
+ * Caller holds port_lock.
+ */
+static void
+jack_port_free_push (jack_engine_t *engine, jack_port_id_t id)
+{
+	jack_port_id_t *heap = engine->port_free;
+	unsigned int n = engine->port_nfree++;
+
+	while (n > 0 && heap[(n - 1) / 2] > id) {
+		heap[n] = heap[(n - 1) / 2];
+		n = (n - 1) / 2;
+	}
+	heap[n] = id;
+}
+
+static jack_port_id_t
+jack_port_free_pop (jack_engine_t *engine)
+{
+	jack_port_id_t *heap = engine->port_free;
+	jack_port_id_t lowest = heap[0];
+	jack_port_id_t last = heap[--engine->port_nfree];
+	unsigned int n = 0, child;
+
+	while ((child = 2 * n + 1) < engine->port_nfree) {
+		if (child + 1 < engine->port_nfree &&
+		    heap[child + 1] < heap[child]) {
+			child++;
+		}
+		if (last <= heap[child]) {
 			break;
 		}
+		heap[n] = heap[child];
+		n = child;
+	}
+	heap[n] = last;
+
+	return lowest;
+}
+
+static jack_port_id_t
+jack_get_free_port (jack_engine_t *engine)
+
+{
+	jack_port_id_t i = (jack_port_id_t) -1;
+
+	pthread_mutex_lock (&engine->port_lock);
+
+	if (engine->port_nfree) {
+		i = jack_port_free_pop (engine);
+		engine->control->ports[i].in_use = 1;
 	}
 	
 	pthread_mutex_unlock (&engine->port_lock);
-	
-	if (i == engine->port_max) {
-		return (jack_port_id_t) -1;
-	}
 
 	return i;
 }
@@ -4239,9 +6160,12 @@ void
 jack_port_release (jack_engine_t *engine, jack_port_internal_t *port)
 {
 	pthread_mutex_lock (&engine->port_lock);
+	jack_port_index_remove (engine, port->shared->id);
 	port->shared->in_use = 0;
 	port->shared->alias1[0] = '\0';
 	port->shared->alias2[0] = '\0';
+	__sync_fetch_and_add (&engine->control->port_generation, 1);
+	jack_port_free_push (engine, port->shared->id);
 
 	if (port->buffer_info) {
 		jack_port_buffer_list_t *blist =
@@ -4259,23 +6183,13 @@ jack_port_release (jack_engine_t *engine, jack_port_internal_t *port)
 jack_port_internal_t *
 jack_get_port_internal_by_name (jack_engine_t *engine, const char *name)
 {
-	jack_port_id_t id;
+	jack_port_internal_t *port;
 
 	pthread_mutex_lock (&engine->port_lock);
-
-	for (id = 0; id < engine->port_max; id++) {
-		if (jack_port_name_equals (&engine->control->ports[id], name)) {
-			break;
-		}
-	}
-
+	port = jack_port_index_lookup (engine, name);
 	pthread_mutex_unlock (&engine->port_lock);
-	
-	if (id != engine->port_max) {
-		return &engine->internal_ports[id];
-	} else {
-		return NULL;
-	}
+
+	return port;
 }
 
 int
@@ -4386,11 +6300,17 @@ next:
 	shared->playback_latency.min = shared->playback_latency.max = 0;
 	shared->monitor_requests = 0;
 
+	pthread_mutex_lock (&engine->port_lock);
+	jack_port_index_add (engine, port_id);
+	__sync_fetch_and_add (&engine->control->port_generation, 1);
+	pthread_mutex_unlock (&engine->port_lock);
+
 	port = &engine->internal_ports[port_id];
 
 	port->shared = shared;
 	port->connections = 0;
 	port->buffer_info = NULL;
+	port->mix = NULL;
 	
 	if (jack_port_assign_buffer (engine, port)) {
 		jack_error ("cannot assign buffer for port");
@@ -4630,7 +6550,10 @@ jack_port_assign_buffer (jack_engine_t *engine, jack_port_internal_t *port)
 {
 	jack_port_buffer_list_t *blist =
 		jack_port_buffer_list (engine, port);
+	jack_port_type_info_t *port_type =
+		jack_port_type_info (engine, port);
 	jack_port_buffer_info_t *bi;
+	char *shm_segment;
 
 	if (port->shared->flags & JackPortIsInput) {
 		port->shared->offset = 0;
@@ -4640,8 +6563,6 @@ jack_port_assign_buffer (jack_engine_t *engine, jack_port_internal_t *port)
 	pthread_mutex_lock (&blist->lock);
 
 	if (blist->freelist == NULL) {
-		jack_port_type_info_t *port_type =
-			jack_port_type_info (engine, port);
 		jack_error ("all %s port buffers in use!",
 			    port_type->type_name);
 		pthread_mutex_unlock (&blist->lock);
@@ -4654,6 +6575,16 @@ jack_port_assign_buffer (jack_engine_t *engine, jack_port_internal_t *port)
 	port->shared->offset = bi->offset;
 	port->buffer_info = bi;
 
+	/* a recycled buffer still holds what its last port left in it,
+	   e.g. the events and buffer mode of a MIDI port */
+	shm_segment = (char *) jack_shm_addr (
+		&engine->port_segment[port->shared->ptype_id]);
+	jack_get_port_functions (port->shared->ptype_id)->buffer_init (
+		shm_segment + bi->offset,
+		jack_port_type_buffer_size (port_type,
+					    engine->control->buffer_size),
+		engine->control->buffer_size);
+
 	pthread_mutex_unlock (&blist->lock);
 	return 0;
 }
@@ -4661,20 +6592,7 @@ jack_port_assign_buffer (jack_engine_t *engine, jack_port_internal_t *port)
 static jack_port_internal_t *
 jack_get_port_by_name (jack_engine_t *engine, const char *name)
 {
-	jack_port_id_t id;
-
-	/* Note the potential race on "in_use". Other design
-	   elements prevent this from being a problem.
-	*/
-
-	for (id = 0; id < engine->port_max; id++) {
-		if (engine->control->ports[id].in_use &&
-		    jack_port_name_equals (&engine->control->ports[id], name)) {
-			return &engine->internal_ports[id];
-		}
-	}
-
-	return NULL;
+	return jack_get_port_internal_by_name (engine, name);
 }
 
 static int
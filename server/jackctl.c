@@ -102,6 +102,18 @@ struct jackctl_server
 	union jackctl_parameter_value timothres;
 	union jackctl_parameter_value default_timothres;
 
+	/* bool, whether to run clients that do not depend on each other concurrently */
+	union jackctl_parameter_value parallel;
+	union jackctl_parameter_value default_parallel;
+
+	/* bool, whether to wake clients through futexes rather than FIFOs */
+	union jackctl_parameter_value futex_wakeup;
+	union jackctl_parameter_value default_futex_wakeup;
+
+	/* bool, whether to mix inputs shared by several ports in the server */
+	union jackctl_parameter_value premix;
+	union jackctl_parameter_value default_premix;
+
 	uint64_t next_client_id;
 	uint64_t next_port_id;
 	uint64_t next_connection_id;
@@ -850,6 +862,48 @@ jackctl_server jackctl_server_create(const char * name)
 		goto fail_free_name;
 	}
 
+	value.b = false;
+	if (jackctl_add_parameter(
+		    &server_ptr->parameters,
+		    "parallel",
+		    "Run independent clients concurrently.",
+		    "Instead of running all clients one after another, wake every client as soon as all the clients feeding it have finished, so that clients that do not depend on each other run concurrently on different CPUs. The cycle then takes as long as the longest chain of dependent clients. Clients that are fed by the same clients can run in any order.",
+		    JackParamBool,
+		    &server_ptr->parallel,
+		    &server_ptr->default_parallel,
+		    value) == NULL)
+	{
+		goto fail_free_name;
+	}
+
+	value.b = false;
+	if (jackctl_add_parameter(
+		    &server_ptr->parameters,
+		    "futex-wakeup",
+		    "Wake clients through shared memory futexes.",
+		    "Instead of writing to and polling a FIFO for every client in every cycle, wake clients and collect their completion through futex words in shared memory. This saves several system calls per client per cycle. Only available on Linux; FIFOs are used elsewhere.",
+		    JackParamBool,
+		    &server_ptr->futex_wakeup,
+		    &server_ptr->default_futex_wakeup,
+		    value) == NULL)
+	{
+		goto fail_free_name;
+	}
+
+	value.b = false;
+	if (jackctl_add_parameter(
+		    &server_ptr->parameters,
+		    "premix",
+		    "Mix shared audio inputs once, in the server.",
+		    "When several audio input ports are connected to the same set of output ports, mix that set once per cycle into a buffer in the port segment that all of them read, instead of letting every client mix it again. Also selects the same cycle scheduler as parallel execution.",
+		    JackParamBool,
+		    &server_ptr->premix,
+		    &server_ptr->default_premix,
+		    value) == NULL)
+	{
+		goto fail_free_name;
+	}
+
 	if (!jack_drivers_load(server_ptr))
 	{
 		goto fail_free_parameters;
@@ -1757,6 +1811,9 @@ jackctl_server_start(
 		server_ptr->frame_time_offset.i,
 		server_ptr->nozombies.b,
 		server_ptr->timothres.ui,
+		server_ptr->parallel.b,
+		server_ptr->futex_wakeup.b,
+		server_ptr->premix.b,
 		NULL);
 	if (server_ptr->engine == NULL)
 	{